@@ -0,0 +1,70 @@
+#include <cmath>
+
+#include "ai.h"
+
+/* Coarse step of the frame scan, refined once a feasible window is found */
+#define AIM_STEP 8
+
+/* Launch velocity for an intercept after n steps, 0 if it breaks a limit */
+static int interceptAt (float x0, float y0, float x, float t, int n, const AimLimits &limits, AimShot &shot)
+{
+	float tn = t+TARGET_DT*(n-1);
+	float y = -4+5*tn-tn*tn;
+	/* the arc is unimodal, both ends above the floor keep it off the ground */
+	if(y<=SHOT_FLOOR || y0<=SHOT_FLOOR)
+		return 0;
+	float s1 = SHOT_DT*n*(n-1)/2;
+	float s2 = SHOT_DT*SHOT_DT*(n-1)*n*(2*n-1)/6;
+	float vx = (x-x0)/s1;
+	float vy = (y-y0+SHOT_GRAVITY*s2)/s1;
+	float speed = sqrtf(vx*vx+vy*vy);
+	if(speed>limits.maxspeed)
+		return 0;
+	float angle = atan2f(vy,vx)*180/(float)M_PI;
+	if(angle<0)
+		angle+=360;
+	if(angle<limits.minangle || angle>limits.maxangle)
+		return 0;
+	shot.angle=angle;
+	shot.speed=speed;
+	shot.frames=n;
+	return 1;
+}
+
+int solveAim (float x0, float y0, float x, float t, const AimLimits &limits, AimShot &shot)
+{
+	/* frames left before the target drops out */
+	int last = (int)((TARGET_TMAX-t)/TARGET_DT);
+	if(last>limits.maxframes)
+		last=limits.maxframes;
+	for(int n=2;n<=last;n+=AIM_STEP){
+		if(!interceptAt(x0,y0,x,t,n,limits,shot))
+			continue;
+		/* walk back to the first feasible frame of this window */
+		for(int m=n-1;m>n-AIM_STEP && m>=2;m--){
+			AimShot earlier;
+			if(!interceptAt(x0,y0,x,t,m,limits,earlier))
+				break;
+			shot=earlier;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+int aimBatch (float x0, float y0, const float *x, const float *t, int n, const AimLimits &limits, AimShot &shot)
+{
+	int best = -1;
+	AimShot candidate;
+	for(int k=0;k<n;k++){
+		if(!solveAim(x0,y0,x[k],t[k],limits,candidate))
+			continue;
+		if(best<0 || candidate.frames<shot.frames){
+			shot=candidate;
+			best=k;
+		}
+	}
+	if(best>=0)
+		shot.target=best;
+	return best;
+}
@@ -0,0 +1,45 @@
+#ifndef AI_H
+#define AI_H
+
+/* Analytic aiming for a cannon.
+   enemyshoot() moves the bullet by (vx*t, vy*t-5t^2) every frame and then
+   grows t by SHOT_DT, t being 0 on the first, so after the n-th step the
+   bullet has travelled
+       x = vx*S1(n)            S1(n) = SHOT_DT*n(n-1)/2
+       y = vy*S1(n) - 5*S2(n)  S2(n) = SHOT_DT^2*(n-1)n(2n-1)/6
+   and the first step that moves it is the second.
+   The shot is solved after the targets moved, and every later tick tests
+   for hits before it moves them, so the bullet after its n-th step meets
+   a target at -4+5t-t^2 with t = t0+TARGET_DT*(n-1). For a given n the
+   launch velocity follows directly. */
+
+#define SHOT_DT .01f
+#define SHOT_GRAVITY 5.0f
+#define TARGET_DT .05f
+/* time at which a target falls below y=-6 and respawns */
+#define TARGET_TMAX 5.37f
+/* bullets bounce below this height */
+#define SHOT_FLOOR -3.5f
+
+struct AimLimits{
+	float minangle;		/* degrees, like the barrel rotation */
+	float maxangle;
+	float maxspeed;
+	int maxframes;
+};
+
+struct AimShot{
+	float angle;
+	float speed;
+	int frames;
+	int target;
+};
+
+/* Earliest intercept of one target at x with trajectory time t, 0 if none */
+int solveAim (float x0, float y0, float x, float t, const AimLimits &limits, AimShot &shot);
+
+/* Batch over n live targets given as packed arrays, keeps the earliest
+   intercept. Returns the target index or -1 */
+int aimBatch (float x0, float y0, const float *x, const float *t, int n, const AimLimits &limits, AimShot &shot);
+
+#endif
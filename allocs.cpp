@@ -0,0 +1,57 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "allocs.h"
+
+static std::atomic<uint64_t> allocations(0);
+
+uint64_t heapAllocations ()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new (size_t size)
+{
+	allocations.fetch_add(1,std::memory_order_relaxed);
+	void *p = malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[] (size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new (size_t size, const std::nothrow_t &) noexcept
+{
+	allocations.fetch_add(1,std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void *operator new[] (size_t size, const std::nothrow_t &tag) noexcept
+{
+	return operator new(size,tag);
+}
+
+void operator delete (void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[] (void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete (void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[] (void *p, size_t) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,15 @@
+#ifndef ALLOCS_H
+#define ALLOCS_H
+
+#include <stdint.h>
+
+/* Heap allocation counter.
+   allocs.cpp replaces the global operator new, so a program that links it
+   counts every allocation made through new, the containers and the arenas
+   (arena.h) on any thread. The game and the bench read it around frames
+   and ticks to check the steady state makes none. malloc is not counted,
+   nothing on the frame path calls it directly. */
+
+uint64_t heapAllocations ();
+
+#endif
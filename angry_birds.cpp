@@ -2,6 +2,9 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,7 +14,6 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <time.h>       /* time */
 
 using namespace std;
 
@@ -22,6 +24,7 @@ struct VAO {
 
     GLenum PrimitiveMode;
     GLenum FillMode;
+    int FirstVertex;
     int NumVertices;
 };
 typedef struct VAO VAO;
@@ -35,60 +38,61 @@ struct GLMatrices {
 
 GLuint programID;
 
-struct Rectangles{
-	float length;
-	float breadth;
-	float x;
-	float y;
-	float rotation;
-	int flag;
-	VAO *vao;
-	int numflag;
-};
-typedef struct Rectangles Rectangles;
-
-vector <Rectangles> rectangles;
-vector <Rectangles> numbers;
-vector <Rectangles> numberstens;
-vector <Rectangles> enemynumbers;
-vector <Rectangles> enemynumberstens;
-vector <Rectangles> countdown;
-vector <Rectangles> countdowntens;
-vector <Rectangles> obstacles;
-int boolean[10];
-
-struct Circles{
-	float radius;
-	float x;
-	float y;
-	float rotation;
-	int flag;
-	VAO *vao;
-	int dir;
-	float c1,c2,c3;
-	float vel ;	
-	float time;
-};
-typedef struct Circles Circles;
-
-vector <Circles> circles;
-
-struct Triangles{
-	float x;
-	float y;
-	float rotation;
-	int flag;
-	VAO *vao;
-	int numflag;
-	float radius;
-	int time;
-};
-typedef struct Triangles Triangles;
-
-std::vector<Triangles> triangles;
+#include "ecs.h"
+#include "jobs.h"
+#include "sim.h"
+#include "planner.h"
+#include "net.h"
+#include "spectate.h"
+#include "remote.h"
+#include "scores.h"
+#include "telemetry.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "mesh.h"
+#include "latency.h"
+#include "hud.h"
+#include "stress.h"
+#include "stream.h"
+#include "arena.h"
+#include "allocs.h"
+
+/* The match, every game object lives in game.world, see sim.h */
+Game game;
+GameAssets assets;
+Level level;
+InputQueue input;
+Planner planners[2];
+LatencyProbe probe;
+NetSession net;
+Spectators spectators;
+SpectatorClient watcher;
+RemoteClient remote;
+const char *scorespath = NULL;
+const char *names[2] = {NULL, NULL};
+const char *autosavepath = NULL;
+Telemetry telemetry;
+const char *telemetrypath = NULL;
+ReplayRecorder recorder;
+Replay replay;
+std::vector<uint8_t> autosave;
+Profiler profiler;
+const char *profilepath = NULL;
+const char *tracepath = NULL;
+std::chrono::steady_clock::time_point started;
+int firstframe = 1;
+/* meshes and asset tables, for as long as the level is loaded */
+Arena levelarena;
+/* assets.bin stays mapped while the later stages stream from it */
+MeshBlob blob;
+AssetStream assetstream;
+/* frames after the first second, and those of them that touched the heap */
+long steadyframes = 0, allocframes = 0;
+uint64_t frameallocs = 0;
 
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+	TraceScope trace("LoadShaders");
 
 	// Create the shaders
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
@@ -171,66 +175,41 @@ static void error_callback(int error, const char* description)
 
 void quit(GLFWwindow *window)
 {
+    stopLatencyProbe(probe);
+    reportLatency(probe);
+    reportNet(net);
+    closeNet(net);
+    reportSpectators(spectators);
+    closeSpectators(spectators);
+    reportSpectator(watcher);
+    closeSpectator(watcher);
+    reportRemote(remote);
+    closeRemote(remote);
+    stopTelemetry(telemetry);
+    reportTelemetry(telemetry);
+    stopReplay(recorder,game);
+    reportReplayRecorder(recorder);
+    reportReplay(replay);
+    stopAssetStream(assetstream);
+    reportAssetStream(assetstream);
+    unloadMeshBlob(blob);
+    // a finished match is not resumed
+    if(autosavepath && game.over)
+        remove(autosavepath);
+    stopTrace();
+    cout << "heap : " << allocframes << " of " << steadyframes << " frames after the first second allocated, " << frameallocs << " allocations" << endl;
+    if(profilepath){
+        printProfile(profiler);
+        if(!writeProfileCsv(profiler,profilepath))
+            cout << "cannot write " << profilepath << endl;
+    }
     glfwDestroyWindow(window);
+    shutdownJobs();
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
 
 
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
-{
-    struct VAO* vao = new struct VAO;
-    vao->PrimitiveMode = primitive_mode;
-    vao->NumVertices = numVertices;
-    vao->FillMode = fill_mode;
-
-    // Create Vertex Array Object
-    // Should be done after CreateWindow and before any other GL calls
-    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
-    glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
-    glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
-
-    glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
-    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
-    glVertexAttribPointer(
-                          0,                  // attribute 0. Vertices
-                          3,                  // size (x,y,z)
-                          GL_FLOAT,           // type
-                          GL_FALSE,           // normalized?
-                          0,                  // stride
-                          (void*)0            // array buffer offset
-                          );
-
-    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
-    glVertexAttribPointer(
-                          1,                  // attribute 1. Color
-                          3,                  // size (r,g,b)
-                          GL_FLOAT,           // type
-                          GL_FALSE,           // normalized?
-                          0,                  // stride
-                          (void*)0            // array buffer offset
-                          );
-
-    return vao;
-}
-
-/* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
-{
-	//GL_line for triangle
-    GLfloat* color_buffer_data = new GLfloat [3*numVertices];
-    for (int i=0; i<numVertices; i++) {
-        color_buffer_data [3*i] = red;
-        color_buffer_data [3*i + 1] = green;
-        color_buffer_data [3*i + 2] = blue;
-    }
-
-    return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
-}
-
 /* Render the VBOs handled by VAO */
 void draw3DObject (struct VAO* vao)
 {
@@ -251,15 +230,13 @@ void draw3DObject (struct VAO* vao)
     glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
 
     // Draw the geometry !
-    glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
+    glDrawArrays(vao->PrimitiveMode, vao->FirstVertex, vao->NumVertices); // meshes of a packed buffer start at FirstVertex
 }
 
 /**************************
  * Customizable functions *
  **************************/
 
- int COUNTDOWN = 30;
- int SITECHANGE = 0;
  float zoom=1;
  double xpos, ypos;
 
@@ -268,51 +245,7 @@ float rectangle_rot_dir = 1;
 bool triangle_rot_status = true;
 bool rectangle_rot_status = true;
 float camera_rotation_angle = 90;
-float rectangle_rotation = 10;
 float triangle_rotation = 0;
-float sx = 0;
-float sy = 0;
-float vx = 0;
-float vy = 0;
-int shootflag=0;
-float velocity = .5;
-float theta;
-float bulletx=-9;
-float bullety=-2;
-float canonbasex=-9;
-float canonbasey=-2;
-float canonrectx=-9;
-float canonrecty=-2;
-int score=0;
-float i=0;
-int speedflag=0;
-int upflag=0;
-int downflag=0;
-int dirupflag=0;
-int dirdownflag=0;
-
-float enemybulletx=9;
-float enemybullety=-2;
-float enemycanonbasex=9;
-float enemycanonbasey=-2;
-float enemycanonrectx=9;
-float enemycanonrecty=-2;
-float enemyrectangle_rotation = 100;
-int enemyrotdir = 0;
-float enemyvx = 1;
-float enemyvy = 1;
-int enemyshootflag=0;
-float enemysx = 0;
-float enemysy = 0;
-float enemyvelocity = 2.5;
-int enemytranslationdir=0;
-int enemyscore=0;
-float enemyi=0;
-int enemyspeedflag=0;
-int enemyupflag=0;
-int enemydownflag=0;
-int enemydirupflag=0;
-int enemydirdownflag=0;
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
 //to be modified for the assignment
@@ -321,156 +254,85 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
      // Function is called first on GLFW_PRESS.
 	//No diff btw samll and caps
 	// to diff btw them then test the mods var
-    if (action == GLFW_RELEASE) {
-        switch (key) {
-
-            case GLFW_KEY_SPACE:
-            	shootflag=1;
-            	theta = rectangle_rotation*M_PI/180.0f;
-
-            	vx =velocity*cos(theta);
-  				vy =velocity*sin(theta);  	
-  				speedflag=0;
-
-               // do something ..
-                break;
-
-            case GLFW_KEY_W:
-	        	upflag=0;
-	        	break;
-
-	       	case GLFW_KEY_S:
-	        	downflag=0;
-	        	break;
-
-	       	case GLFW_KEY_A:
-	        	dirupflag=0;
-	        	break;
-	        case GLFW_KEY_D:
-	        	dirdownflag=0;
-	        	break;
-
-	        case GLFW_KEY_P:
-            	enemyshootflag=1;
-            	theta = enemyrectangle_rotation*M_PI/180.0f;
-
-            	enemyvx =enemyvelocity*cos(theta);
-  				enemyvy =enemyvelocity*sin(theta);  	
-  				enemyspeedflag=0;
-
-               // do something ..
-                break;
-
-            case GLFW_KEY_UP:
-	        	enemyupflag=0;
-	        	break;
-
-	       	case GLFW_KEY_DOWN:
-	        	enemydownflag=0;
-	        	break;
-
-	       	case GLFW_KEY_LEFT:
-	        	enemydirupflag=0;
-	        	break;
-	        case GLFW_KEY_RIGHT:
-	        	enemydirdownflag=0;
-	        	break;
-
-            
-
-            default:
-                break;
-        }
-    }
-    else if (action == GLFW_PRESS) {
-        switch (key) {
-            case GLFW_KEY_ESCAPE:
+    // game keys are only queued here, the tick applies them
+    if (action == GLFW_REPEAT)
+        return;
+    int pressed = action == GLFW_PRESS;
+    switch (key) {
+        case GLFW_KEY_ESCAPE:
+            if (pressed)
                 quit(window);
-                break;
-            case GLFW_KEY_A:
-	        	dirupflag=1;
-	        	break;
-	        case GLFW_KEY_D:
-	        	dirdownflag=1;
-	        	break;
-
-	        case GLFW_KEY_SPACE:
-	        	if(vx!=0){
-  					bulletx=canonbasex;
-  					bullety=canonbasey;
-  					vx=0;shootflag=0;velocity=0;
-  					vy=0;
-  					i=0;
-  				}
-  				speedflag=1;
-
-            	
-            	break;	
-
-            case GLFW_KEY_W:
-
-            	upflag=1;
-            	
-                // do something ..
-                break;
-
-            case GLFW_KEY_S:
-
-            	downflag=1;
-                // do something ..
-                break;
-
-            case GLFW_KEY_LEFT:
-	        	enemydirupflag=1;
-	        	break;
-	        case GLFW_KEY_RIGHT:
-	        	enemydirdownflag=1;
-	        	break;
-
-	        case GLFW_KEY_P:
-	        	if(enemyvx!=0){
-  					enemybulletx=enemycanonbasex;
-  					enemybullety=enemycanonbasey;
-  					enemyvx=0;enemyshootflag=0;enemyvelocity=0;
-  					enemyvy=0;
-  					enemyi=0;
-  				}
-  				enemyspeedflag=1;
-
-            	
-            	break;	
-
-            case GLFW_KEY_UP:
-
-            	enemyupflag=1;
-            	
-                // do something ..
-                break;
-
-            case GLFW_KEY_Z:
-
-              zoom=zoom*.8;
-              
-                // do something ..
-                break;
+            break;
 
-            case GLFW_KEY_X:
+        case GLFW_KEY_SPACE:
+            pushInput(input, PLAYER, INPUT_CHARGE, pressed);
+            break;
+        case GLFW_KEY_W:
+            pushInput(input, PLAYER, INPUT_UP, pressed);
+            break;
+        case GLFW_KEY_S:
+            pushInput(input, PLAYER, INPUT_DOWN, pressed);
+            break;
+        case GLFW_KEY_A:
+            pushInput(input, PLAYER, INPUT_DIRUP, pressed);
+            break;
+        case GLFW_KEY_D:
+            pushInput(input, PLAYER, INPUT_DIRDOWN, pressed);
+            break;
 
-              zoom=zoom*1.2;
-              
-                // do something ..
-                break;
+        case GLFW_KEY_P:
+            pushInput(input, ENEMY, INPUT_CHARGE, pressed);
+            break;
+        case GLFW_KEY_UP:
+            pushInput(input, ENEMY, INPUT_UP, pressed);
+            break;
+        case GLFW_KEY_DOWN:
+            pushInput(input, ENEMY, INPUT_DOWN, pressed);
+            break;
+        case GLFW_KEY_LEFT:
+            pushInput(input, ENEMY, INPUT_DIRUP, pressed);
+            break;
+        case GLFW_KEY_RIGHT:
+            pushInput(input, ENEMY, INPUT_DIRDOWN, pressed);
+            break;
+        case GLFW_KEY_I:
+            if (pressed)
+                pushInput(input, ENEMY, INPUT_AUTOAIM, 1);
+            break;
 
-            case GLFW_KEY_DOWN:
+        case GLFW_KEY_Z:
+            if (pressed)
+                zoom=zoom*.8;
+            break;
+        case GLFW_KEY_X:
+            if (pressed)
+                zoom=zoom*1.2;
+            break;
 
-            	enemydownflag=1;
-                // do something ..
-                break;
-    
+        // replay viewer: fast forward, rewind, play and pause, jump 5 s
+        case GLFW_KEY_F:
+            if (pressed && replay.active)
+                replay.speed = replay.speed>0 ? std::min(replay.speed*2,REPLAY_MAX_SPEED) : 2;
+            break;
+        case GLFW_KEY_R:
+            if (pressed && replay.active)
+                replay.speed = replay.speed<0 ? std::max(replay.speed*2,-REPLAY_MAX_SPEED) : -2;
+            break;
+        case GLFW_KEY_G:
+            if (pressed && replay.active)
+                replay.speed = replay.speed==1 ? 0 : 1;
+            break;
+        case GLFW_KEY_PAGE_UP:
+            if (pressed && replay.active)
+                seekReplay(replay,game,game.ticks+5*TICKS_PER_SECOND);
+            break;
+        case GLFW_KEY_PAGE_DOWN:
+            if (pressed && replay.active)
+                seekReplay(replay,game,game.ticks-5*TICKS_PER_SECOND);
+            break;
 
-            default:
-                break;
-        }
+        default:
+            break;
     }
 }
 
@@ -494,24 +356,12 @@ void mouseButton (GLFWwindow* window, int button, int action, int mods)
     switch (button) {
         case GLFW_MOUSE_BUTTON_LEFT:
             if (action == GLFW_RELEASE  ){
-                  enemyshootflag=1;
-              theta = enemyrectangle_rotation*M_PI/180.0f;
-
-              enemyvx =enemyvelocity*cos(theta);
-          enemyvy =enemyvelocity*sin(theta);    
-          enemyspeedflag=0;
+                  pushInput(input, ENEMY, INPUT_CHARGE, 0);
             }
 
 
             if (action == GLFW_PRESS){
-                  if(enemyvx!=0){
-                enemybulletx=enemycanonbasex;
-                enemybullety=enemycanonbasey;
-                enemyvx=0;enemyshootflag=0;enemyvelocity=0;
-                enemyvy=0;
-                enemyi=0;
-              }
-              enemyspeedflag=1;
+                  pushInput(input, ENEMY, INPUT_CHARGE, 1);
             }
                 
             break;
@@ -552,397 +402,245 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
     Matrices.projection = glm::ortho(-10.0f*zoom/*(left)*/, 10.0f*zoom, -4.0f*zoom, 4.0f*zoom, 0.1f/*depth*/, 500.0f);
 }
 
-VAO *triangle, *rectangle,*canonbase, *circle,objects[100],*obstructions[100],*enemyrectangle,*enemycanonbase,*enemycircle;
-
+VAO *meshes;
+int nmeshes;
 
-// Creates the triangle object used in this sample code
-void createTriangle ()
+/* One vertex array over an interleaved position/colour buffer */
+static GLuint vertexArrayFor (GLuint buffer)
 {
-  /* ONLY vertices between the bounds specified in glm::ortho will be visible on screen */
-
-  /* Define vertex array as used in glBegin (GL_TRIANGLES) */
-  static const GLfloat vertex_buffer_data [] = {
-    0, 1,0, // vertex 0
-    -1,-1,0, // vertex 1
-    1,-1,0, // vertex 2
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    1,0,0, // color 0
-    0,1,0, // color 1
-    0,0,1, // color 2
-  };
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  triangle = create3DObject(GL_TRIANGLES, 3, vertex_buffer_data, color_buffer_data, GL_LINE);
+    GLuint vertexarray;
+    glGenVertexArrays(1, &vertexarray);
+    glBindVertexArray (vertexarray);
+    glBindBuffer (GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)0); // position
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)(3*sizeof(GLfloat))); // colour
+    return vertexarray;
 }
 
-void createCircle(float radius)
+/* Point the meshes of a stage at a buffer that holds their vertices back
+   to back in mesh order; stage -1 is every mesh at its own first vertex */
+static void pointMeshes (GLuint vertexarray, GLuint buffer, const MeshRange *ranges, int stage)
 {
-  int i=0,j=0;
-  GLfloat vertex_buffer_data [360];
-  for(i=0;i<36;i++){
-    float theta = (2.0f*3.14f*float(i))/float(36);
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    
-    vertex_buffer_data[j]=radius * cosf(theta);j++;
-    vertex_buffer_data[j]=radius* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;
-    theta = (2.0f*3.14f*float(i+1))/float(36);
-    
-    vertex_buffer_data[j]=radius* cosf(theta);j++;
-    vertex_buffer_data[j]=radius* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;
-  }
-
-  GLfloat color_buffer_data [324];
-  for(int i=0;i<324;i++){
-    color_buffer_data[i]=1;
-  }
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  circle = create3DObject(GL_TRIANGLES, 108, vertex_buffer_data, color_buffer_data, GL_FILL);
+    int first = 0;
+    for(int k=0;k<nmeshes;k++){
+        if(stage>=0 && meshStage(level,k)!=stage)
+            continue;
+        VAO &vao = meshes[k];
+        vao.VertexArrayID = vertexarray;
+        vao.VertexBuffer = buffer;
+        vao.ColorBuffer = buffer;
+        vao.FirstVertex = stage<0 ? ranges[k].first : first;
+        vao.NumVertices = ranges[k].count;
+        first += ranges[k].count;
+    }
 }
 
-void createEnemyCircle(float radius)
+/* The mesh table, empty until a buffer is uploaded for them */
+static void createMeshes (int count)
 {
-  int i=0,j=0;
-  GLfloat vertex_buffer_data [360];
-  for(i=0;i<36;i++){
-    float theta = (2.0f*3.14f*float(i))/float(36);
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    
-    vertex_buffer_data[j]=radius * cosf(theta);j++;
-    vertex_buffer_data[j]=radius* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;
-    theta = (2.0f*3.14f*float(i+1))/float(36);
-    
-    vertex_buffer_data[j]=radius* cosf(theta);j++;
-    vertex_buffer_data[j]=radius* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;
-  }
-
-  GLfloat color_buffer_data [324];
-  for(int i=0;i<324;i++){
-    color_buffer_data[i]=1;
-  }
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  enemycircle = create3DObject(GL_TRIANGLES, 108, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-
-void createobstructions(float length, float breadth,int index,float c1, float c2, float c3){
-	static const GLfloat vertex_buffer_data [] = {
-    -(length/2),-(breadth/2),0, // vertex 1
-    (length/2),-(breadth/2),0, // vertex 2
-    (length/2), (breadth/2),0, // vertex 3
-
-    (length/2),(breadth/2),0, // vertex 3
-    -(length/2),(breadth/2),0, // vertex 4
-    -(length/2),-(breadth/2),0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-
-    c1,c2,c3, // color 3
-    c1,c2,c3, // color 4
-    c1,c2,c3 // color 1
-  };
-  obstructions[index] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-  
-}
-
-VAO* createRectangles(float x,float y, float length, float breadth, float c1, float c2, float c3 ){
-	GLfloat vertex_buffer_data [] = {
-    x-(length/2),y-(breadth/2),0,
-    x+(length/2), y-(breadth/2),0,
-    x+(length/2),y+(breadth/2),0,
-
-    x+(length/2),y+(breadth/2),0,
-    x-(length/2),y+(breadth/2),0,
-    x-(length/2),y-(breadth/2),0
-  };
-  //cout << x-(length/2) << endl;
-
-  GLfloat color_buffer_data [] = {
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-
-    c1,c2,c3, // color 3
-    c1,c2,c3, // color 4
-    c1,c2,c3 // color 1
-  };
-  return create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+    meshes = arenaArray<VAO>(levelarena,count);
+    nmeshes = count;
+    memset(meshes,0,count*sizeof(VAO));
+    for(int k=0;k<count;k++){
+        meshes[k].PrimitiveMode = GL_TRIANGLES;
+        meshes[k].FillMode = GL_FILL;
+    }
 }
 
-
-VAO* createTriangles(float x,float y, float radius,float c1, float c2, float c3 ){
-	GLfloat vertex_buffer_data [] = {
-    x,y+radius,0,
-    x-(1.732*radius/2), y-(radius/2),0,
-    x+(1.732*radius/2), y-(radius/2),0,
-    x,y-radius,0,
-    x-(1.732*radius/2), y+(radius/2),0,
-    x+(1.732*radius/2), y+(radius/2),0
-
-  };
-
-
-  GLfloat color_buffer_data [] = {
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-
-  };
-  return create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Upload every mesh of the match as one interleaved buffer. The VAOs
+   share it and differ only in their first vertex */
+void uploadMeshes (const MeshRange *ranges, int count, const MeshVertex *vertices, int nvertices)
+{
+    TraceScope trace("uploadMeshes");
+    GLuint buffer;
+    glGenBuffers (1, &buffer);
+    glBindBuffer (GL_ARRAY_BUFFER, buffer);
+    glBufferData (GL_ARRAY_BUFFER, nvertices*sizeof(MeshVertex), vertices, GL_STATIC_DRAW);
+    createMeshes(count);
+    pointMeshes(vertexArrayFor(buffer), buffer, ranges, -1);
 }
 
-VAO* createRhombus(float x,float y, float radius,float c1, float c2, float c3 ){
-	GLfloat vertex_buffer_data [] = {
-    x,y+radius+radius/4,0,
-    x-(1.732*radius/2), 0,0,
-    x+(1.732*radius/2), 0,0,
-    x,y-radius-radius/4,0,
-    x-(1.732*radius/2), 0,0,
-    x+(1.732*radius/2), 0,0
-
-  };
-
-
-  GLfloat color_buffer_data [] = {
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-
-  };
-  return create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Upload what stage 0 draws from the baked blob, the other stages'
+   props are left to the loader */
+void uploadFirstStage ()
+{
+    TraceScope trace("uploadFirstStage");
+    startAssetStream(assetstream,level,blob);
+    ArenaScope scratch(frameArena());
+    MeshVertex *staged = arenaArray<MeshVertex>(scratch.arena,assetstream.stages[0].nvertices);
+    uint32_t at = 0;
+    for(uint32_t k=0;k<blob.header->nmeshes;k++){
+        if(meshStage(level,k)!=0)
+            continue;
+        const MeshRange &r = blob.meshes[k];
+        memcpy(staged+at, blob.vertices+r.first, r.count*sizeof(MeshVertex));
+        at += r.count;
+    }
+    GLuint buffer;
+    glGenBuffers (1, &buffer);
+    glBindBuffer (GL_ARRAY_BUFFER, buffer);
+    glBufferData (GL_ARRAY_BUFFER, at*sizeof(MeshVertex), staged, GL_STATIC_DRAW);
+    createMeshes(blob.header->nmeshes);
+    pointMeshes(vertexArrayFor(buffer), buffer, blob.meshes, 0);
 }
 
-VAO* createSquare(float x,float y, float radius,float c1, float c2, float c3 ){
-	GLfloat vertex_buffer_data [] = {
-    x+(radius/1.414),y+(radius/1.414),0,
-    x-(radius/1.414),y+(radius/1.414),0,
-    x+(radius/1.414),y-(radius/1.414),0,
-    x+(radius/1.414),y-(radius/1.414),0,
-    x-(radius/1.414),y-(radius/1.414),0,
-    x-(radius/1.414),y+(radius/1.414),0
-
-  };
-
-
-  GLfloat color_buffer_data [] = {
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-    c1,c2,c3, // color 1
-    c1,c2,c3, // color 2
-    c1,c2,c3, // color 3
-
-  };
-  return create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* A buffer for the stage, mapped for the loader to write */
+static void mapStage (int stage)
+{
+    StreamStage &st = assetstream.stages[stage];
+    if(!st.nvertices){
+        st.state.store(STREAM_RESIDENT);
+        return;
+    }
+    GLsizeiptr size = st.nvertices*sizeof(MeshVertex);
+    glGenBuffers (1, &st.buffer);
+    glBindBuffer (GL_ARRAY_BUFFER, st.buffer);
+    glBufferData (GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+    MeshVertex *dest = (MeshVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
+    if(!dest){
+        // no mapping, copy it here instead
+        ArenaScope scratch(frameArena());
+        MeshVertex *staged = arenaArray<MeshVertex>(scratch.arena,st.nvertices);
+        copyStage(assetstream,stage,staged);
+        glBufferData (GL_ARRAY_BUFFER, size, staged, GL_STATIC_DRAW);
+        st.vertexarray = vertexArrayFor(st.buffer);
+        pointMeshes(st.vertexarray, st.buffer, blob.meshes, stage);
+        st.state.store(STREAM_RESIDENT);
+        return;
+    }
+    queueStage(assetstream,stage,dest);
 }
 
-VAO* createCircles(float x,float y,float radius, float c1, float c2, float c3 ){
-	int i=0,j=0;
-  GLfloat vertex_buffer_data [360];
-  for(i=0;i<36;i++){
-    float theta = (2.0f*3.14f*float(i))/float(36);
-    vertex_buffer_data[j]=x;j++;
-    vertex_buffer_data[j]=y;j++;
-    vertex_buffer_data[j]=0;j++;
-    
-    vertex_buffer_data[j]=x+(radius * cosf(theta));j++;
-    vertex_buffer_data[j]=y+(radius* sinf(theta));j++;
-    vertex_buffer_data[j]=0;j++;
-    theta = (2.0f*3.14f*float(i+1))/float(36);
-    
-    vertex_buffer_data[j]=(x+radius* cosf(theta));j++;
-    vertex_buffer_data[j]=(y+radius* sinf(theta));j++;
-    vertex_buffer_data[j]=0;j++;
-  }
-  i=0;
-  GLfloat color_buffer_data [324];
-  while(i<324){
-    color_buffer_data[i]=c1;i++;
-    color_buffer_data[i]=c2;i++;
-    color_buffer_data[i]=c3;i++;
-    color_buffer_data[i]=c1-.3;i++;
-    color_buffer_data[i]=c2;i++;
-    color_buffer_data[i]=c3;i++;
-    color_buffer_data[i]=c1-.3;i++;
-    color_buffer_data[i]=c2;i++;
-    color_buffer_data[i]=c3;i++;
-    
-  }
-  return create3DObject(GL_TRIANGLES, 108, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Unmaps what the loader wrote and points the stage's meshes at it */
+static void finishStage (int stage)
+{
+    TraceScope trace("finishStage");
+    StreamStage &st = assetstream.stages[stage];
+    glBindBuffer (GL_ARRAY_BUFFER, st.buffer);
+    if(glUnmapBuffer(GL_ARRAY_BUFFER)!=GL_TRUE){
+        // the driver lost the mapped contents, upload them again
+        ArenaScope scratch(frameArena());
+        MeshVertex *staged = arenaArray<MeshVertex>(scratch.arena,st.nvertices);
+        copyStage(assetstream,stage,staged);
+        glBufferData (GL_ARRAY_BUFFER, st.nvertices*sizeof(MeshVertex), staged, GL_STATIC_DRAW);
+    }
+    st.vertexarray = vertexArrayFor(st.buffer);
+    pointMeshes(st.vertexarray, st.buffer, blob.meshes, stage);
+    st.state.store(STREAM_RESIDENT);
 }
 
-
-VAO* createSemiCircles(float x,float y,float radius, float c1, float c2, float c3 ){
-	int i=0,j=0;
-  GLfloat vertex_buffer_data [360];
-  for(i=18;i<36;i++){
-    float theta = (2.0f*3.14f*float(i))/float(36);
-    vertex_buffer_data[j]=x;j++;
-    vertex_buffer_data[j]=y;j++;
-    vertex_buffer_data[j]=0;j++;
-    
-    vertex_buffer_data[j]=x+(radius * cosf(theta));j++;
-    vertex_buffer_data[j]=y+(radius* sinf(theta));j++;
-    vertex_buffer_data[j]=0;j++;
-    theta = (2.0f*3.14f*float(i+1))/float(36);
-    
-    vertex_buffer_data[j]=(x+radius* cosf(theta));j++;
-    vertex_buffer_data[j]=(y+radius* sinf(theta));j++;
-    vertex_buffer_data[j]=0;j++;
-  }
-  i=0;
-  GLfloat color_buffer_data [324];
-  while(i<108){
-    color_buffer_data[i]=c1;i++;
-    color_buffer_data[i]=c2;i++;
-    color_buffer_data[i]=c3;i++;
-    color_buffer_data[i]=c1-.3;i++;
-    color_buffer_data[i]=c2;i++;
-    color_buffer_data[i]=c3;i++;
-    color_buffer_data[i]=c1-.3;i++;
-    color_buffer_data[i]=c2;i++;
-    color_buffer_data[i]=c3;i++;
-    
-  }
-  return create3DObject(GL_TRIANGLES, 54, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Every stage on screen has to be drawable, both while scrolling; the
+   one after the current stage loads while it plays */
+void streamStages ()
+{
+    if(!assetstream.active)
+        return;
+    int nstages = level.header->nstages;
+    int stage = game.stage<nstages ? game.stage : nstages-1;
+    for(int s=1;s<nstages;s++){
+        if(assetstream.stages[s].state.load()==STREAM_LOADED)
+            finishStage(s);
+    }
+    for(int s=game.sitechange && stage>0 ? stage-1 : stage;s<=stage;s++){
+        StreamStage &st = assetstream.stages[s];
+        if(st.state.load()==STREAM_RESIDENT)
+            continue;
+        if(st.state.load()==STREAM_WAITING)
+            mapStage(s);
+        if(st.state.load()!=STREAM_RESIDENT){
+            stageLoaded(assetstream,s,1);
+            finishStage(s);
+        }
+    }
+    if(stage+1<nstages && assetstream.stages[stage+1].state.load()==STREAM_WAITING)
+        mapStage(stage+1);
 }
 
+struct RenderItem{
+	int layer;
+	VAO *vao;
+	float x;
+	float y;
+	float rotation;
+	int screen;	/* TAG_SCREEN, drawn without the camera scroll */
+};
 
+/* in the frame arena, rebuilt by every draw */
+RenderItem *renderlist;
+size_t nrender;
 
-void createCanonBase()
-{
-  int i=0,j=0;
-  GLfloat vertex_buffer_data [360];
-  for(i=0;i<36;i++){
-    float theta = (2.0f*3.14f*float(i))/float(36);
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    
-    vertex_buffer_data[j]=.5 * cosf(theta);j++;
-    vertex_buffer_data[j]=.5* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;
-    theta = (2.0f*3.14f*float(i+1))/float(36);
-    
-    vertex_buffer_data[j]=.5 * cosf(theta);j++;
-    vertex_buffer_data[j]=.5* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;	
-  }
+#define RENDER_GRAIN 512
 
-  GLfloat color_buffer_data [324];
-  for(int i=0;i<324;i++){
-    color_buffer_data[i]=0;
-  }
+/* One drawable archetype, written to renderlist from offset on */
+struct RenderBatch{
+	Archetype *arch;
+	size_t offset;
+};
 
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  canonbase = create3DObject(GL_TRIANGLES, 108, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Invisible rows leave a layer -1 hole that is compacted afterwards */
+static void renderListJob(void *data, int begin, int end){
+	RenderBatch *batch = (RenderBatch*)data;
+	Archetype &arch = *batch->arch;
+	int screen = (arch.mask & TAG_SCREEN)!=0;
+	for(int r=begin;r<end;r++){
+		RenderItem &item = renderlist[batch->offset+r];
+		item.layer = arch.meshes[r].visible ? arch.meshes[r].layer : -1;
+		if(item.layer>LAYER_HUD)	// one bucket per layer in the sort
+			item.layer = LAYER_HUD;
+		item.vao=arch.meshes[r].vao;
+		item.x=arch.transforms[r].x;
+		item.y=arch.transforms[r].y;
+		item.rotation=arch.transforms[r].rotation;
+		item.screen=screen;
+	}
 }
 
-void createEnemyCanonBase()
+/* Collect every visible mesh of the world, sorted into draw order. The
+   layers are few, so the sort is a stable counting sort by layer into a
+   second array */
+void buildRenderList ()
 {
-  int i=0,j=0;
-  GLfloat vertex_buffer_data [360];
-  for(i=0;i<36;i++){
-    float theta = (2.0f*3.14f*float(i))/float(36);
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    vertex_buffer_data[j]=0;j++;
-    
-    vertex_buffer_data[j]=.5 * cosf(theta);j++;
-    vertex_buffer_data[j]=.5* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;
-    theta = (2.0f*3.14f*float(i+1))/float(36);
-    
-    vertex_buffer_data[j]=.5 * cosf(theta);j++;
-    vertex_buffer_data[j]=.5* sinf(theta);j++;
-    vertex_buffer_data[j]=0;j++;	
+  Arena &frame = frameArena();
+  World &world = game.world;
+  RenderBatch *batches = arenaArray<RenderBatch>(frame,world.archetypes.size());
+  int nbatches=0;
+  size_t total=0;
+  for(size_t a=0;a<world.archetypes.size();a++){
+    Archetype &arch = world.archetypes[a];
+    if(!archetypeMatches(arch,COMP_TRANSFORM|COMP_MESH))
+      continue;
+    // targets and obstacles are only in play while active
+    if((arch.mask & (TAG_TARGET|TAG_OBSTACLE)) && !(arch.mask & TAG_ACTIVE))
+      continue;
+    RenderBatch &batch = batches[nbatches++];
+    batch.arch=&arch;
+    batch.offset=total;
+    total+=arch.entities.size();
   }
-
-  GLfloat color_buffer_data [324];
-  for(int i=0;i<324;i++){
-    color_buffer_data[i]=0;
+  RenderItem *items = arenaArray<RenderItem>(frame,total);
+  renderlist=items;
+
+  JobCounter built;
+  for(int k=0;k<nbatches;k++)
+    parallelFor(&built,NULL,(int)batches[k].arch->entities.size(),RENDER_GRAIN,renderListJob,&batches[k]);
+  waitJobs(&built);
+
+  size_t first[LAYER_HUD+2];
+  memset(first,0,sizeof first);
+  for(size_t k=0;k<total;k++){
+    if(items[k].layer>=0)
+      first[items[k].layer+1]++;
+  }
+  for(int l=0;l<=LAYER_HUD;l++)
+    first[l+1]+=first[l];
+  nrender=first[LAYER_HUD+1];
+  renderlist=arenaArray<RenderItem>(frame,nrender);
+  for(size_t k=0;k<total;k++){
+    if(items[k].layer>=0)
+      renderlist[first[items[k].layer]++]=items[k];
   }
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  enemycanonbase = create3DObject(GL_TRIANGLES, 108, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-
-// Creates the rectangle object used in this sample code
-void createRectangle ()
-{
-  // GL3 accepts only Triangles. Quads are not supported
-  static const GLfloat vertex_buffer_data [] = {
-    -1.2,-.3,0, // vertex 1
-    1.2,-.3,0, // vertex 2
-    1.2, .3,0, // vertex 3
-
-    1.2, .3,0, // vertex 3
-    -1.2, .3,0, // vertex 4
-    -1.2,-.3,0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    1,0,0, // color 1
-    0,0,1, // color 2
-    0,1,0, // color 3
-
-    0,1,0, // color 3
-    0.3,0.3,0.3, // color 4
-    1,0,0  // color 1
-  };
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  rectangle = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-
-void createEnemyRectangle ()
-{
-  // GL3 accepts only Triangles. Quads are not supported
-  static const GLfloat vertex_buffer_data [] = {
-    -1.2,-.3,0, // vertex 1
-    1.2,-.3,0, // vertex 2
-    1.2, .3,0, // vertex 3
-
-    1.2, .3,0, // vertex 3
-    -1.2, .3,0, // vertex 4
-    -1.2,-.3,0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    1,0,0, // color 1
-    0,0,1, // color 2
-    0,1,0, // color 3
-
-    0,1,0, // color 3
-    0.3,0.3,0.3, // color 4
-    1,0,0  // color 1
-  };
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  enemyrectangle = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
-
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
 void draw ()
@@ -969,6 +667,8 @@ void draw ()
   // Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
   //  Don't change unless you are sure!!
   glm::mat4 VP = Matrices.projection * Matrices.view;
+  // the world is seen through a camera at game.camerax, which the level scroll moves
+  glm::mat4 worldVP = Matrices.projection * glm::lookAt(glm::vec3(game.camerax,0,3), glm::vec3(game.camerax,0,0), glm::vec3(0,1,0));
 
   // Send our transformation to the currently bound shader, in the "MVP" uniform
   // For each model you render, since the MVP will be different (at least the M part)
@@ -976,227 +676,17 @@ void draw ()
   glm::mat4 MVP;	// MVP = Projection * View * Model
 
   // draw3DObject draws the VAO given to it using current MVP matrix
-  Matrices.model = glm::mat4(1.0f);
-  glm::mat4 translateland = glm::translate (glm::vec3(rectangles[0].x,rectangles[0].y-3, 0));	
-  //cout << rectangles[2].y << endl;
-  Matrices.model *= (translateland);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  draw3DObject(rectangles[0].vao);
-
-
-  Matrices.model = glm::mat4(1.0f);
-  glm::mat4 translatesky = glm::translate (glm::vec3(rectangles[1].x,rectangles[1].y+1, 0));	
-  //cout << rectangles[2].y << endl;
-  Matrices.model *= (translatesky);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  draw3DObject(rectangles[1].vao);
-
-
-  Matrices.model = glm::mat4(1.0f);
-  glm::mat4 translatesea = glm::translate (glm::vec3(rectangles[3].x+20,rectangles[3].y, 0));	
- // cout << rectangles[2].y << endl;
-  Matrices.model *= (translatesea);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  draw3DObject(rectangles[3].vao);
-
-
-Matrices.model = glm::mat4(1.0f);
-  glm::mat4 translatetreebase = glm::translate (glm::vec3(rectangles[2].x+3,rectangles[2].y-1, 0));	
- // cout << rectangles[2].y << endl;
-  Matrices.model *= (translatetreebase);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  draw3DObject(rectangles[2].vao);
-
-  Matrices.model = glm::mat4(1.0f);
-  glm::mat4 translatetree = glm::translate (glm::vec3(circles[0].x+3,circles[0].y, 0));	
-  //cout << rectangles[2].y << endl;
-  Matrices.model *= (translatetree);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  draw3DObject(circles[0].vao);
-
-  // Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
-  // glPopMatrix ();
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateiniRectangle = glm::translate (glm::vec3(0,0, 0));	
-  glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  glm::mat4 translateRectangle = glm::translate (glm::vec3(canonrectx, canonrecty, 0));        // glTranslatef
-  
-  Matrices.model *= (translateRectangle*rotateRectangle*translateiniRectangle);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(rectangle);
-
-  Matrices.model = glm::mat4(1.0f);
-
-  translateiniRectangle = glm::translate (glm::vec3(0,0, 0));	
-  rotateRectangle = glm::rotate((float)(enemyrectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  translateRectangle = glm::translate (glm::vec3(enemycanonrectx, enemycanonrecty, 0));        // glTranslatef
-  
-  Matrices.model *= (translateRectangle*rotateRectangle*translateiniRectangle);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(enemyrectangle);
-
-  //for the canonbase
-
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateCanonBase = glm::translate (glm::vec3(canonbasex, canonbasey, 0));        // glTranslatef
-  //glm::mat4 rotateCanonBase = glm::rotate((float)(canonbase_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateCanonBase);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  draw3DObject(canonbase);
-
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateEnemyCanonBase = glm::translate (glm::vec3(enemycanonbasex, enemycanonbasey, 0));        // glTranslatef
-  //glm::mat4 rotateCanonBase = glm::rotate((float)(canonbase_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateEnemyCanonBase);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  draw3DObject(enemycanonbase);
-
-  //for circle
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateCircle = glm::translate (glm::vec3(bulletx,bullety, 0));	
-  //glm::mat4 rotateCircle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  //glm::mat4 translatebackCircle = glm::translate (glm::vec3(-1.5,-3, 0));
-  Matrices.model *= (translateCircle);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(circle);
-
-
-
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateEnemyCircle = glm::translate (glm::vec3(enemybulletx,enemybullety, 0));	
-  //glm::mat4 rotateCircle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  //glm::mat4 translatebackCircle = glm::translate (glm::vec3(-1.5,-3, 0));
-  Matrices.model *= (translateEnemyCircle);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(enemycircle);
-
-
-  for(int k=1;k<51;k++){
-    if(circles[(k)%51].flag==1 ){
-    Matrices.model = glm::mat4(1.0f); 
-    glm::mat4 translateTargetcir = glm::translate (glm::vec3(circles[k%51].x,circles[k%51].y, 0));
-    Matrices.model *= (translateTargetcir);
-    MVP = VP * Matrices.model;
+  buildRenderList();
+  for(size_t k=0;k<nrender;k++){
+    RenderItem &item = renderlist[k];
+    Matrices.model = glm::translate (glm::vec3(item.x, item.y, 0));
+    if(item.rotation!=0)
+      Matrices.model *= glm::rotate((float)(item.rotation*M_PI/180.0f), glm::vec3(0,0,1));
+    MVP = (item.screen ? VP : worldVP) * Matrices.model;
     glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    draw3DObject(circles[k].vao);
-  }
+    draw3DObject(item.vao);
   }
 
-  for(int k=0;k<1;k++){
-  	if(SITECHANGE==2){
-  		Matrices.model = glm::mat4(1.0f); 
-	    glm::mat4 translateTargetcir = glm::translate (glm::vec3(obstacles[k].x-3,circles[k].y-2, 0));
-	    Matrices.model *= (translateTargetcir);
-	    MVP = VP * Matrices.model;
-	    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	    draw3DObject(obstacles[k].vao);
-  	}
-  }
-  for(int k=1;k<2;k++){
-  	if(SITECHANGE==2){
-  		Matrices.model = glm::mat4(1.0f); 
-	    glm::mat4 translateTargetcir = glm::translate (glm::vec3(obstacles[k].x+3,obstacles[k].y-2, 0));
-	    Matrices.model *= (translateTargetcir);
-	    MVP = VP * Matrices.model;
-	    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	    draw3DObject(obstacles[k].vao);
-  	}
-  }
-
-
-for(int j=0;j<7;j++){
-	if(numbers[j].numflag==1){
-	  Matrices.model = glm::mat4(1.0f);
-	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	  draw3DObject(numbers[j].vao);
-	}
-
-
-}
-
-for(int j=0;j<7;j++){
-	if(numberstens[j].numflag==1){
-	  Matrices.model = glm::mat4(1.0f);
-	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	  draw3DObject(numberstens[j].vao);
-	}
-}
-
-for(int j=0;j<7;j++){
-	if(enemynumbers[j].numflag==1){
-	  Matrices.model = glm::mat4(1.0f);
-	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	  draw3DObject(enemynumbers[j].vao);
-	}
-
-	
-}
-
-for(int j=0;j<7;j++){
-	if(enemynumberstens[j].numflag==1){
-	  Matrices.model = glm::mat4(1.0f);
-	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	  draw3DObject(enemynumberstens[j].vao);
-	}
-}
-
-for(int j=0;j<7;j++){
-	if(countdown[j].numflag==1){
-	  Matrices.model = glm::mat4(1.0f);
-	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	  draw3DObject(countdown[j].vao);
-	}
-
-	
-}
-
-for(int j=0;j<7;j++){
-	if(countdowntens[j].numflag==1){
-	  Matrices.model = glm::mat4(1.0f);
-	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	  draw3DObject(countdowntens[j].vao);
-	}
-}
-
-
-  
-
-  //for land
-  Matrices.model = glm::mat4(1.0f);
-
-  
   // Increment angles
   float increments = 1;
 
@@ -1205,187 +695,10 @@ for(int j=0;j<7;j++){
   //rectangle_rotation = rectangle_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
 }
 
-void shoot()
-{
-  sx = vx*i;
-  sy = vy*i + (-5)*i*i;
-  //cout << "sy"<< sy << endl;
-  bulletx = bulletx+sx;
-  bullety = bullety+sy;
- // cout << "bullety" << bullety<< endl;
-  if(bulletx>=10 || bullety<=-4 || bulletx<=-10){
-  	i=0;velocity=0;
-  	shootflag=0;
-  	bulletx=canonbasex;
-  	bullety=canonbasey;
-
-  }
-  if(bullety<=-3.5){
-  	bullety=-3.5;
-  	velocity=velocity*.9;
-  	i=0.01;
-  	//bulletx=3.4;
-  	if(theta<0){
-  		vy=vy*-1;
-  //	cout << vy << endl;
-  	}
-  }
-
-}
-
-void enemyshoot()
-{
-  enemysx = enemyvx*enemyi;
-  enemysy = enemyvy*enemyi + (-5)*enemyi*enemyi;
-  //cout << "sy"<< sy << endl;
-  enemybulletx = enemybulletx+enemysx;
-  enemybullety = enemybullety+enemysy;
-  //cout << "bullety" << bullety<< endl;
-  if(enemybulletx>=10 || enemybullety<=-4 || enemybulletx<=-10){
-  	enemyi=0;enemyvelocity=1.2;
-  	enemyshootflag=0;
-  	enemybulletx=enemycanonbasex;
-  	enemybullety=enemycanonbasey;
-
-  }
-  if(enemybullety<=-3.5){
-  	enemybullety=-3.5;
-  	enemyvelocity=enemyvelocity*.9;
-  	enemyi=0.01;
-  	//bulletx=3.4;
-  	if(theta>180){
-  		enemyvy=enemyvy*-1;
- // 		cout << vy << endl;
-  	}
-  }
-
-}
-
-void createnumber(int num){
-	for(int k=0;k<7;k++){
-		boolean[k]=0;
-	}
-	if(num==1){
-		boolean[0]=1;
-		boolean[1]=1;
-	}
-	if(num==2){
-		boolean[5]=1;
-		boolean[0]=1;
-		boolean[6]=1;
-		boolean[3]=1;
-		boolean[2]=1;
-
-	}
-	if(num==3){
-		boolean[5]=1;
-		boolean[0]=1;
-		boolean[6]=1;
-		boolean[1]=1;
-		boolean[2]=1;
-
-	}
-	if(num==4){
-		boolean[4]=1;
-		boolean[6]=1;
-		boolean[0]=1;
-		boolean[1]=1;
-	}
-	if(num==5){
-		boolean[5]=1;
-		boolean[4]=1;
-		boolean[6]=1;
-		boolean[1]=1;
-		boolean[2]=1;
-
-	}
-	if(num==6){
-		boolean[5]=1;
-		boolean[4]=1;
-		boolean[6]=1;
-		boolean[1]=1;
-		boolean[2]=1;
-		boolean[3]=1;
-	}
-	if(num==7){
-		boolean[5]=1;
-		boolean[0]=1;
-		boolean[1]=1;
-
-	}
-	if(num==8){
-		boolean[0]=1;
-		boolean[1]=1;
-		boolean[2]=1;
-		boolean[3]=1;
-		boolean[4]=1;
-		boolean[5]=1;
-		boolean[6]=1;
-
-	}
-	if(num==9){
-		boolean[4]=1;
-		boolean[5]=1;
-		boolean[6]=1;
-		boolean[0]=1;
-		boolean[1]=1;
-	}
-	if(num==0){
-		boolean[0]=1;
-		boolean[1]=1;
-		boolean[2]=1;
-		boolean[3]=1;
-		boolean[4]=1;
-		boolean[5]=1;
-	}
-}
-
-void drawscore(int score){
-	int digit = score%10;
-	createnumber(digit);
-	for(int k=0;k<7;k++){
-		numbers[k].numflag=boolean[k];
-	}
-	score=score/10;
-	digit = score%10;
-	createnumber(digit);
-	for(int k=0;k<7;k++){
-		numberstens[k].numflag=boolean[k];
-	}
-}
-
-void drawenemyscore(int score){
-	int digit = score%10;
-	createnumber(digit);
-	for(int k=0;k<7;k++){
-		enemynumbers[k].numflag=boolean[k];
-	}
-	score=score/10;
-	digit = score%10;
-	createnumber(digit);
-	for(int k=0;k<7;k++){
-		enemynumberstens[k].numflag=boolean[k];
-	}
-}
-
-void drawenemycountdown(int count){
-	int digit = count%10;
-	createnumber(digit);
-	for(int k=0;k<7;k++){
-		countdown[k].numflag=boolean[k];
-	}
-	count=count/10;
-	digit = count%10;
-	createnumber(digit);
-	for(int k=0;k<7;k++){
-		countdowntens[k].numflag=boolean[k];
-	}
-}
-
 
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
-GLFWwindow* initGLFW (int width, int height)
+GLFWwindow* initGLFW (int width, int height, bool visible=true)
 {
     GLFWwindow* window; // window desciptor/handle
 
@@ -1398,6 +711,7 @@ GLFWwindow* initGLFW (int width, int height)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     window = glfwCreateWindow(width, height, "Sample OpenGL 3.3 Application", NULL, NULL);
 
@@ -1436,201 +750,38 @@ GLFWwindow* initGLFW (int width, int height)
 /* Add all the models to be created here *///object creation
 void initGL (GLFWwindow* window, int width, int height)
 {
+  TraceScope trace("initGL");
     /* Objects should be created before any other gl function and shaders */
-	// Create the models
-	//createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
-	srand (time(NULL));
-	createRectangle ();
-  createCanonBase();
-
-  createEnemyRectangle ();
-  createEnemyCanonBase();
-  createEnemyCircle(.2);
-
-  createCircle(.2);
-  Rectangles q;
-  q.x=0;
-  q.y=0;
-  q.length=20*zoom;
-  q.breadth=2*zoom;
-  q.vao = createRectangles(q.x,q.y,q.length,q.breadth,1,.5,0); 
-  rectangles.push_back(q);
-  q.x=0;
-  q.y=0;
-  q.length=20*zoom;
-  q.breadth=6*zoom;
-  q.vao = createRectangles(q.x,q.y,q.length,q.breadth,0.5,1,.5); 
-  rectangles.push_back(q);
-  q.x=0;
-  q.y=0;
-  q.length=.5*zoom;
-  q.breadth=2*zoom;
-  q.rotation=0	;
-   q.flag=0;
-  q.vao = createRectangles(q.x,q.y,q.length,q.breadth,0.647059 ,0.164706, 0.164706); 
-  rectangles.push_back(q);
-
-  q.x=0;
-  q.y=0;
-  q.length=20*zoom;
-  q.breadth=8*zoom;
-  q.vao = createRectangles(q.x,q.y,q.length,q.breadth,0.74902,0.847059,0.847059); 
-  rectangles.push_back(q);
-
-
-
-  Circles c;
-  c.x=0;c.y=0;c.radius=1*zoom;
-  c.vao = createCircles(c.x,c.y,c.radius,0.137255,0.556863,0.137255);
-  circles.push_back(c);
-  srand (time(NULL));
-  float j=.2;
-  for(int k=0;k<50;k++){
-    Circles c;
-    if(SITECHANGE==0)
-    	c.x=0;
-    else if(SITECHANGE==2){
-    	c.x=0 ;
-    }    
-    c.y =0;
-    c.vel=15;
-    c.radius=.5*zoom;
-    c.time=0;
-    c.dir=1;c.flag=0;
-    if(k%5==0){
-    	c.c1=0;c.c2=0;c.c3=1;
-      	c.vao = createRhombus(c.x,c.y,c.radius,c.c1,c.c2,c.c3);
-    }
-    else if((k-1)%5==0){
-      c.c1=1;c.c2=0;c.c3=0;
-      c.vao = createTriangles(c.x,c.y,c.radius,c.c1,c.c2,c.c3);
-    }
-    else if ((k-2)%5==0){
-      c.c1=1;c.c2=2;c.c3=0;
-      c.vao = createCircles(c.x,c.y,c.radius,c.c1,c.c2,c.c3);
-    }
-    else if((k-3)%5==0){
-    	c.c1=0;c.c2=1;c.c3=1;
-      c.vao = createSquare(c.x,c.y,c.radius,c.c1,c.c2,c.c3);
-    }
-    else{
-    	c.c1=0;c.c2=1;c.c3=0;
-      	c.vao = createSemiCircles(c.x,c.y,c.radius,c.c1,c.c2,c.c3);
-    }
-    circles.push_back(c);
+	// Create the models, baked by make into assets.bin
+  // only stage 0's, streamStages brings in the rest as the match goes
+  if(loadMeshBlob(blob,"assets.bin",levelHash(level)))
+    uploadFirstStage();
+  else{
+    cout << "assets.bin is missing or was baked for another level, building the meshes" << endl;
+    MeshSet set;
+    buildGameMeshes(set,level);
+    uploadMeshes(&set.meshes[0],set.meshes.size(),&set.vertices[0],set.vertices.size());
   }
 
-  Triangles t;
-
-  for(int k=0;k<1;k++){
-  	t.x=0;t.y=0;t.radius=(1.732/4)*zoom;t.flag=0;
-  	t.vao = createTriangles(t.x,t.y,t.radius,0,0,1);
-  	triangles.push_back(t);
+  for(int c=0;c<2;c++){
+    assets.canonrect[c]=&meshes[MESH_CANONRECT+c];
+    assets.canonbase[c]=&meshes[MESH_CANONBASE+c];
+    assets.bullet[c]=&meshes[MESH_BULLET+c];
   }
-
-  	q.length=.05;q.breadth=.2;q.x=-7;q.y=3;q.numflag=1;;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=numbers[0].x;q.y=numbers[0].y-.2;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=numbers[1].x-.1;q.y=numbers[1].y-.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=numbers[2].x-.1;q.y=numbers[1].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=numbers[3].x;q.y=numbers[0].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=numbers[2].x;q.y=numbers[1].y+.3;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=numbers[2].x;q.y=numbers[1].y+.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numbers.push_back(q);
-
- 	q.length=.05;q.breadth=.2;q.x=-8;q.y=3;q.numflag=1;;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=numberstens[0].x;q.y=numberstens[0].y-.2;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=numberstens[1].x-.1;q.y=numberstens[1].y-.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=numberstens[2].x-.1;q.y=numberstens[1].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=numberstens[3].x;q.y=numberstens[0].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=numberstens[2].x;q.y=numberstens[1].y+.3;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=numberstens[2].x;q.y=numberstens[1].y+.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	numberstens.push_back(q);
-
- 	q.length=.05;q.breadth=.2;q.x=8;q.y=3;q.numflag=1;;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=enemynumbers[0].x;q.y=enemynumbers[0].y-.2;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=enemynumbers[1].x-.1;q.y=enemynumbers[1].y-.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=enemynumbers[2].x-.1;q.y=enemynumbers[1].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=enemynumbers[3].x;q.y=enemynumbers[0].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=enemynumbers[2].x;q.y=enemynumbers[1].y+.3;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=enemynumbers[2].x;q.y=enemynumbers[1].y+.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumbers.push_back(q);
-
- 	q.length=.05;q.breadth=.2;q.x=7;q.y=3;q.numflag=1;;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=enemynumberstens[0].x;q.y=enemynumberstens[0].y-.2;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=enemynumberstens[1].x-.1;q.y=enemynumberstens[1].y-.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=enemynumberstens[2].x-.1;q.y=enemynumberstens[1].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=enemynumberstens[3].x;q.y=enemynumberstens[0].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=enemynumberstens[2].x;q.y=enemynumberstens[1].y+.3;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=enemynumberstens[2].x;q.y=enemynumberstens[1].y+.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	enemynumberstens.push_back(q);
-
- 	q.length=.05;q.breadth=.2;q.x=0;q.y=3;q.numflag=1;;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=countdown[0].x;q.y=countdown[0].y-.2;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=countdown[1].x-.1;q.y=countdown[1].y-.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=countdown[2].x-.1;q.y=countdown[1].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=countdown[3].x;q.y=countdown[0].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=countdown[2].x;q.y=countdown[1].y+.3;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=countdown[2].x;q.y=countdown[1].y+.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdown.push_back(q);
-
- 	q.length=.05;q.breadth=.2;q.x=-1;q.y=3;q.numflag=1;;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=countdowntens[0].x;q.y=countdowntens[0].y-.2;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=countdowntens[1].x-.1;q.y=countdowntens[1].y-.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=countdowntens[2].x-.1;q.y=countdowntens[1].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
- 	q.length=.05;q.breadth=.2;q.x=countdowntens[3].x;q.y=countdowntens[0].y;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=countdowntens[2].x;q.y=countdowntens[1].y+.3;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
- 	q.length=.2;q.breadth=.02;q.x=countdowntens[2].x;q.y=countdowntens[1].y+.1;q.numflag=1;q.vao=createRectangles(q.x,q.y,q.length,q.breadth,1,1,1); 
- 	countdowntens.push_back(q);
-
-
-
- 	for(int k=0;k<6;k++){
- 	  q.x=0;
-	  q.y=0;
-	  q.length=.4;
-	  q.breadth=8;
-	  q.rotation=0	;
-	  q.flag=0;
-	  q.vao = createRectangles(q.x,q.y,q.length,q.breadth,0.647059 ,0.164706, 0.164706); 
-	  obstacles.push_back(q);
-	}
-
+  assets.segmentvertical=&meshes[MESH_SEGMENTVERTICAL];
+  assets.segmenthorizontal=&meshes[MESH_SEGMENTHORIZONTAL];
+  // the level's props, then its target palette
+  const LevelHeader *h = level.header;
+  assets.nprops=h->nprops;
+  assets.ntargets=h->ntargets;
+  assets.props=arenaArray<VAO*>(levelarena,h->nprops);
+  assets.targets=arenaArray<VAO*>(levelarena,h->ntargets);
+  for(uint32_t k=0;k<h->nprops;k++)
+    assets.props[k]=&meshes[MESH_PROPS+k];
+  for(uint32_t k=0;k<h->ntargets;k++)
+    assets.targets[k]=&meshes[MESH_PROPS+h->nprops+k];
+
+  initGame(game,assets,&level,game.seed);
 
   
 	// Create and compile our GLSL program from the shaders
@@ -1654,303 +805,453 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
-int main (int argc, char** argv)
+/* Adds the cannons this process played to the high scores and shows where
+   they landed */
+void recordScores ()
 {
+    ScoreStore store;
+    if(!openScores(store,scorespath))
+        return;
+    static const char *defaults[3] = {"player", "autoaim", "planner"};
+    for(int c=0;c<2;c++){
+        // a networked process has only its own cannon to speak for, and a
+        // match the server stopped talking about has no final score
+        if((net.active && c!=net.side) || (remote.active && (c!=remote.side || !remote.over)) || watcher.active)
+            continue;
+        char name[SCORES_NAME+1];
+        if(names[c])
+            snprintf(name, sizeof name, "%s", names[c]);
+        else if(game.cannons[c].control==CONTROL_HUMAN)
+            snprintf(name, sizeof name, "player %d", c+1);
+        else
+            snprintf(name, sizeof name, "%s", defaults[game.cannons[c].control]);
+        ScoreRecord r;
+        fillScoreRecord(r, name, game.cannons[c].score, game.cannons[!c].score);
+        r.levelhash = game.levelhash;
+        r.seed = game.seed;
+        r.ticks = game.ticks;
+        r.side = c;
+        r.control = game.cannons[c].control;
+        if(appendScore(store,r))
+            cout << name << " : number " << scoreRank(store,r.score) << " of " << scoreCount(store) << endl;
+    }
+    std::vector<ScoreRecord> top;
+    topScores(store, 5, top);
+    for(size_t k=0;k<top.size();k++)
+        cout << k+1 << ". " << std::string(top[k].name, strnlen(top[k].name, SCORES_NAME)) << " " << top[k].score << endl;
+    closeScores(store);
+}
 
-	srand (time(NULL));
-	int width = 1100;
-	int height = 700;
-
-    GLFWwindow* window = initGLFW(width, height);
-
-	initGL (window, width, height);
-
-    double last_update_time = glfwGetTime(), current_time;
-    circles[0].flag=1;
-    circles[2].flag=1;
-    circles[1].flag=1;
-
-    circles[0].vel=2;
-    circles[2].vel=2;
-    circles[1].vel=2;
-
-    /* Draw in loop */
-    while (!glfwWindowShouldClose(window)) {
-
-    	if(SITECHANGE==1){
-			for(int k=1;k<51;k++){
-				if(circles[k].flag==1){
-					circles[k].x-=.5;            				}
-			}
-
-			rectangles[0].x-=.5;
-			rectangles[1].x-=.5;
-			rectangles[2].x-=.5;
-			rectangles[3].x-=.5;
-			circles[0].x-=.5;
-			if(rectangles[3].x==-20){
-				SITECHANGE=2;
-			}
-		}
-
-
-    	for(int k=1;k<51;k++){
-        if(circles[k].flag==1){
-
-        if(abs(sqrt(pow((bulletx-circles[k].x),2)+(pow((bullety-circles[k].y),2))) )<= circles[k].radius+.2){
-            circles[k].y=-5;
-            vx=vx*-1;
-            score++;
-            circles[k%51].flag=0;
-            circles[(k+2)%51].flag=1;
-          }
-
-          if(abs(sqrt(pow((enemybulletx-circles[k].x),2)+(pow((enemybullety-circles[k].y),2)) ))<= circles[k].radius+.2){
-            circles[k].y=-5;
-            enemyvx=enemyvx*-1;
-            enemyscore++;
-            circles[k%51].flag=0;
-            circles[k+2%51].flag=1;
-
-          }
+/* One pass of the main loop: input, tick, draw and swap */
+void frame (GLFWwindow* window, int width, int height)
+{
+    ProfileScope whole(game.profiler,PHASE_FRAME);
+    // last frame's render list and scratch go at once
+    resetArena(frameArena());
+    uint64_t allocated = heapAllocations();
+
+    // Poll for Keyboard and mouse events, they take effect in this tick
+    {
+        ProfileScope scope(game.profiler,PHASE_POLL);
+        glfwPollEvents();
+    }
+    replayTick(recorder,game);
+    InputEvent event;
+    while(popInput(input,event)){
+        if(net.active)
+            netLocalInput(net,event);
+        else if(remote.active)
+            holdInput(remote.held,event);
+        else if(!watcher.active && !replay.active){
+            recordReplayEvent(recorder,game,event);
+            applyInput(game,event);
         }
-
+    }
+    // a spectator only shows what the game sends
+    if(watcher.active){
+        if(pollSpectator(watcher)<0)
+            game.over = 1;
+        else if(watcher.levelhash && watcher.levelhash!=levelHash(level)){
+            cout << "the game plays another level" << endl;
+            game.over = 1;
         }
+        mirrorSpectator(watcher,game);
+    }
+    // the server plays the match, we show its state
+    else if(remote.active){
+        if(pollRemote(remote)<0){
+            game.over = 1;
+            if(remote.over)
+                for(int c=0;c<2;c++)
+                    game.cannons[c].score = remote.scores[c];
+        }
+        mirrorSpectator(remote.view,game);
+    }
+    // a replay plays its recorded ticks, as many as the speed asks
+    else if(replay.active)
+        viewReplay(replay,game);
+    // a networked tick is started and ended by advanceNet
+    else if(!net.active && !remote.active){
+        applyProbeInput(probe,game);
+        beginTick(game);
+    }
 
-        glfwGetCursorPos(window, &xpos, &ypos);
-        ypos *=-1;
-        ypos += 700;
-        xpos -=1100;
-        xpos *=-1;
-      //  cout << xpos << ypos << endl;
-
-        enemyrectangle_rotation =180- (atan (ypos/xpos) * 180 / M_PI) ;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    ypos *=-1;
+    ypos += 700;
+    xpos -=1100;
+    xpos *=-1;
+  //  cout << xpos << ypos << endl;
+
+    if(net.active){
+      // the mouse aims player 2 on its own side only, the peer gets it as input
+      if(net.side==ENEMY)
+        netLocalAim(net,180- (atan (ypos/xpos) * 180 / M_PI));
+      advanceNet(net,game);
+    }
+    else if(remote.active){
+      if(remote.side==ENEMY)
+        holdAim(remote.held,180- (atan (ypos/xpos) * 180 / M_PI));
+      sendRemoteInput(remote);
+    }
+    else if(!watcher.active && !replay.active && game.cannons[ENEMY].control==CONTROL_HUMAN){
+      // hundredths of a degree, as netplay sends it, which also packs small
+      float aim = lrintf((180- (atan (ypos/xpos) * 180 / M_PI))*100)/100.0f;
+      recordReplayAim(recorder,game,ENEMY,aim);
+      getTransform(game.world,game.cannons[ENEMY].rect)->rotation = aim;
+    }
 
 
+    {
+        ProfileScope scope(game.profiler,PHASE_RESHAPE);
         reshapeWindow (window, width, height);
-        // OpenGL Draw commands
+    }
+    streamStages();
+    // OpenGL Draw commands
+    {
+        ProfileScope scope(game.profiler,PHASE_DRAW);
         draw();
-        drawscore(score);
-        drawenemyscore(enemyscore);
+    }
+    {
+        ProfileScope scope(game.profiler,PHASE_DRAWSCORE);
+        drawscore(game.world,game.cannons[PLAYER].score);
+        drawenemyscore(game.world,game.cannons[ENEMY].score);
+        drawenemycountdown(game.world,game.countdown);
+    }
+    if(probe.wanted){
+        int fbwidth, fbheight;
+        glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+        probeAfterDraw(probe,game,fbwidth,fbheight);
+    }
 
-        // Swap Frame Buffer in double buffering
+    // Swap Frame Buffer in double buffering
+    {
+        ProfileScope scope(game.profiler,PHASE_SWAP);
         glfwSwapBuffers(window);//shows the frame you rendered 
+    }
+    probeAfterSwap(probe);
+    if(firstframe){
+        firstframe = 0;
+        cout << "first frame : " << std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-started).count() << " ms" << endl;
+    }
 
-        // Poll for Keyboard and mouse events
-        glfwPollEvents();
-
-        /*if(enemytranslationdir==0){
-	        enemycanonbasey +=.05;
-	        enemycanonrecty +=.05;
-	    }
-	    else{
-	    	enemycanonbasey -=.05;
-	    	enemycanonrecty -=.05;
-	    }
-        if(enemycanonbasey >=4){
-        	enemytranslationdir=1;
-        	enemycanonbasey =3.8;
-        	enemycanonrecty =3.8;
-        }
-        if(enemycanonbasey <=-4){
-        	enemytranslationdir=0;
-        	enemycanonbasey =-3.8;
-        	enemycanonrecty =-3.8;
-        }
-        if(enemyshootflag==0){
-        	enemybullety=enemycanonbasey;
-        }
-
-        if(enemyrotdir==0){
-	        enemyrectangle_rotation+=1;
-	    }
-	    else{
-	    	enemyrectangle_rotation-=1;
-	    }
-        if(enemyrectangle_rotation>=170){
-        	enemyrotdir=1;
-        	enemyrectangle_rotation=169;
-        }
-        if(enemyrectangle_rotation<=100){
-        	enemyrotdir=0;
-        	enemyrectangle_rotation=101;
-        }
-*/
-
-        if(rectangles[2].flag==1){
-        	rectangles[2].rotation-=.5;
-
-        }
-
-        if((bulletx>=-3.2 && bulletx<=-2.8  && bullety<=2 && SITECHANGE==2) || (bulletx<=3.2 && bulletx>=2.8 && bullety<=2 && SITECHANGE==2)){
-        	vx=vx*-.8;
-        }
-
-        if((enemybulletx<=3.2 && enemybulletx>=2.8 && enemybullety<=2 && SITECHANGE==2 || enemybulletx<=-2.8) &&  (enemybulletx>=-3.2 && enemybullety<=2 && SITECHANGE==2)){
-        	enemyvx=enemyvx*-.8;
-        }
-
-        for(int k=1;k<51;k++){
-        	if(k%6==0){
-        		triangles[0].flag=1;
-        	}
-
-        	if(circles[k].flag==1){
-
-        	if(abs(sqrt(pow((bulletx-circles[k].x),2)+(pow((bullety-circles[k].y),2))) )<= circles[k].radius+.2){
-	        	circles[k].y=-5;
-            vx=vx*-.8;
-            score++;
-            circles[k%51].flag=0;
-            circles[(k+2)%51].flag=1;
-
-	        }
-
-	        else if(abs(sqrt(pow((enemybulletx-circles[k].x),2)+(pow((enemybullety-circles[k].y),2)) ))<= circles[k].radius+.2){
-	        	 circles[k].y=-5;
-            enemyvx=enemyvx*-.8;
-            enemyscore++;
-            circles[k%51].flag=0;
-            circles[(k+2)%51].flag=1;
-	        }
-
-        	circles[k].time+=.05;
-        	circles[k].y=-4+5*circles[k].time + (-1)*circles[k].time*circles[k].time;
-        	
-        	if(circles[k].y<=-6){
-        		circles[k].time=0;
-        		circles[k].flag=0;
-        		int r = ((k+7)%51)+1;
-        		if(circles[r].flag==1){
-        			circles[(r+1)%51].flag=1;
-        			r=r+1;
-        			//circles[(r+1)%51].time==.05;
-        		}
-
-        		circles[r].flag=1;
-        		if(SITECHANGE==0){
-        			circles[r].x=rand()%7-3;
-        		}        		else if(SITECHANGE==2){
-        		circles[r].x=rand()%4-2;
-        	}
-
-        		circles[r].vel=2;
-        		circles[r].y=-4;
-
-
-        	}
-	      }  
-
+    if(!net.active && !watcher.active && !remote.active && !replay.active){
+        for(int c=0;c<2;c++){
+            if(updatePlanner(planners[c],game))
+                recordReplayPlan(recorder,game,c);
         }
 
-        if(speedflag==1){
-        	if(bulletx>=-9.9){
-        	velocity = velocity + .2;
-        	theta = rectangle_rotation*M_PI/180.0f;
-        	//cout << theta << endl;	
-        	bulletx = bulletx+-.05*cos(theta);
-        	bullety = bullety+-.05*sin(theta);
-        	}	
-        }
-        if(upflag==1){
-        	bullety+=.1;
-        	canonbasey+=.1;
-        	canonrecty+=.1;
+        endTick(game,1.0f/TICKS_PER_SECOND);
+        if(autosavepath && game.ticks%TICKS_PER_SECOND==0){
+            saveSnapshot(autosave,game);
+            if(!writeSnapshotFile(autosavepath,autosave))
+                cout << "cannot write " << autosavepath << endl;
         }
+    }
+    broadcastSpectators(spectators,game);
+    if(game.ticks>TICKS_PER_SECOND){
+        allocated = heapAllocations()-allocated;
+        steadyframes++;
+        allocframes += allocated>0;
+        frameallocs += allocated;
+    }
+}
 
-        if(downflag==1){
-        	bullety-=.1;
-        	canonbasey-=.1;
-        	canonrecty-=.1;
-        }
-        if(dirupflag==1){
-        	rectangle_rotation+=2;
-        	if(rectangle_rotation>=80){
-        		rectangle_rotation=80;
-        	}
-        }
-        if(dirdownflag==1){
-        	rectangle_rotation-=2;
-        	if(rectangle_rotation<=10){
-        		rectangle_rotation=10;
-        	}
+/* Sweeps the stress scenario from 10 to maxcount objects of each kind,
+   a row of CSV per step */
+void runStress (GLFWwindow* window, int width, int height, int maxcount, int kinds)
+{
+    printStressHeader();
+    for(long count=10;count<=maxcount && !glfwWindowShouldClose(window);count*=10){
+        uint64_t seed = game.seed;
+        game = Game();
+        initGame(game,assets,&level,seed);
+        for(int c=0;c<2;c++)
+            game.cannons[c].control = CONTROL_AUTOAIM;
+        populateStress(game,assets,count,kinds,seed);
+        clearProfiler(profiler);
+        game.profiler = &profiler;
+
+        std::chrono::steady_clock::time_point stepstart = std::chrono::steady_clock::now();
+        long drawcalls = 0;
+        int frames = 0;
+        while(frames<STRESS_FRAMES && !game.over && !glfwWindowShouldClose(window)){
+            frame(window, width, height);
+            drawcalls += nrender;
+            frames++;
+            if(frames>=STRESS_MIN_FRAMES && std::chrono::steady_clock::now()-stepstart>std::chrono::seconds(STRESS_SECONDS))
+                break;
         }
+        StressStep step;
+        step.count = count;
+        measureStress(step,game,profiler,frames,drawcalls);
+        printStressStep(step);
+    }
+}
 
-        if(shootflag==1){
-            	shoot();
-            	i=i+0.01;	
-            }
+int main (int argc, char** argv)
+{
+	started = std::chrono::steady_clock::now();
+
+	game.seed = clockSeed();
+	int control[2] = {CONTROL_HUMAN, CONTROL_HUMAN};
+	float budget = .01;
+	const char *levelpath = "levels.bin";
+	int latency = 0;
+	int headless = 0;
+	int stress = 0;
+	int stresskinds = STRESS_TARGETS|STRESS_PROJECTILES|STRESS_OBSTACLES;
+	int netside = -1;
+	int netport = 0;
+	const char *netpeer = NULL;
+	float netdelay = 0, netjitter = 0, netloss = 0;
+	const char *spectatorpath = NULL;
+	const char *spectatepath = NULL;
+	const char *resumepath = NULL;
+	const char *joinpath = NULL;
+	const char *recordpath = NULL;
+	const char *replaypath = NULL;
+	for(int k=1;k+1<argc;k++){
+		if(strcmp(argv[k],"--level")==0)
+			levelpath = argv[k+1];
+		if(strcmp(argv[k],"--seed")==0)
+			game.seed = strtoull(argv[k+1],NULL,10);
+		if(strcmp(argv[k],"--plan")==0)
+			control[atoi(argv[k+1])==2 ? ENEMY : PLAYER] = CONTROL_PLAN;
+		if(strcmp(argv[k],"--plan-budget")==0)
+			budget = atof(argv[k+1])/1000;
+		if(strcmp(argv[k],"--latency")==0)
+			latency = atoi(argv[k+1]);
+		if(strcmp(argv[k],"--profile")==0)
+			profilepath = argv[k+1];
+		if(strcmp(argv[k],"--trace")==0)
+			tracepath = argv[k+1];
+		if(strcmp(argv[k],"--stress")==0)
+			stress = atoi(argv[k+1]);
+		if(strcmp(argv[k],"--stress-kinds")==0)
+			stresskinds = stressKinds(argv[k+1]);
+		if(strcmp(argv[k],"--net")==0)
+			netside = atoi(argv[k+1])==2 ? ENEMY : PLAYER;
+		if(strcmp(argv[k],"--net-port")==0)
+			netport = atoi(argv[k+1]);
+		if(strcmp(argv[k],"--net-peer")==0)
+			netpeer = argv[k+1];
+		if(strcmp(argv[k],"--net-delay")==0)
+			netdelay = atof(argv[k+1]);
+		if(strcmp(argv[k],"--net-jitter")==0)
+			netjitter = atof(argv[k+1]);
+		if(strcmp(argv[k],"--net-loss")==0)
+			netloss = atof(argv[k+1]);
+		if(strcmp(argv[k],"--spectators")==0)
+			spectatorpath = argv[k+1];
+		if(strcmp(argv[k],"--spectate")==0)
+			spectatepath = argv[k+1];
+		if(strcmp(argv[k],"--autosave")==0)
+			autosavepath = argv[k+1];
+		if(strcmp(argv[k],"--resume")==0)
+			resumepath = argv[k+1];
+		if(strcmp(argv[k],"--join")==0)
+			joinpath = argv[k+1];
+		if(strcmp(argv[k],"--scores")==0)
+			scorespath = argv[k+1];
+		if(strcmp(argv[k],"--name1")==0)
+			names[PLAYER] = argv[k+1];
+		if(strcmp(argv[k],"--name2")==0)
+			names[ENEMY] = argv[k+1];
+		if(strcmp(argv[k],"--telemetry")==0)
+			telemetrypath = argv[k+1];
+		if(strcmp(argv[k],"--record")==0)
+			recordpath = argv[k+1];
+		if(strcmp(argv[k],"--replay")==0)
+			replaypath = argv[k+1];
+	}
+	for(int k=1;k<argc;k++){
+		if(strcmp(argv[k],"--ai")==0)
+			control[ENEMY] = CONTROL_AUTOAIM;
+		if(strcmp(argv[k],"--headless")==0)
+			headless = 1;
+	}
+	// the latency probe plays player 1 itself
+	if(latency>0)
+		control[PLAYER] = CONTROL_HUMAN;
+	// a spectator plays nothing itself
+	if(spectatepath){
+		latency = 0;
+		stress = 0;
+		netside = -1;
+	}
+	// a replay plays the recorded match and nothing else
+	if(replaypath){
+		latency = 0;
+		stress = 0;
+		netside = -1;
+		spectatepath = NULL;
+		joinpath = NULL;
+		resumepath = NULL;
+		recordpath = NULL;
+		telemetrypath = NULL;
+		scorespath = NULL;
+	}
+	// the server decides the match, we only send buttons
+	if(joinpath){
+		latency = 0;
+		stress = 0;
+		netside = -1;
+		spectatepath = NULL;
+		control[PLAYER] = control[ENEMY] = CONTROL_HUMAN;
+	}
+	// both cannons are played by people, one on each side of the wire
+	if(netside>=0){
+		if(!netpeer || !netport){
+			cout << "--net needs --net-port and --net-peer" << endl;
+			exit(EXIT_FAILURE);
+		}
+		control[PLAYER] = control[ENEMY] = CONTROL_HUMAN;
+		latency = 0;
+		stress = 0;
+	}
+	// logged so the match can be reproduced with --seed
+	cout << "seed : " << game.seed << endl;
+	if(!loadLevel(level,levelpath))
+		exit(EXIT_FAILURE);
+	traceThreadName("main");
+	if(tracepath && !startTrace(tracepath))
+		cout << "cannot write " << tracepath << endl;
+	initJobs();
+	int width = 1100;
+	int height = 700;
 
+    GLFWwindow* window = initGLFW(width, height, !headless);
 
+	initGL (window, width, height);
+	for(int c=0;c<2;c++){
+		game.cannons[c].control = control[c];
+		initPlanner(planners[c],c,game.seed,budget);
+	}
+	if(latency>0)
+		startLatencyProbe(probe,latency,headless);
+	// the trace shows the same phases as the profiler
+	if(profilepath || tracepath){
+		clearProfiler(profiler);
+		game.profiler = &profiler;
+	}
+	if(stress>0){
+		runStress(window, width, height, stress, stresskinds);
+		quit(window);
+	}
+	if(netside>=0){
+		if(!openNet(net,netside,netport,netpeer,game.seed))
+			quit(window);
+		setNetShim(net,netdelay,netjitter,netloss);
+		cout << "waiting for player " << (netside==PLAYER ? 2 : 1) << " at " << netpeer << endl;
+		if(!waitPeer(net,NET_WAIT_SECONDS)){
+			cout << "no answer from " << netpeer << endl;
+			quit(window);
+		}
+		// player 2 plays on player 1's seed
+		Profiler *profiling = game.profiler;
+		uint64_t seed = net.seed;
+		game = Game();
+		initGame(game,assets,&level,seed);
+		game.profiler = profiling;
+		cout << "seed : " << seed << endl;
+	}
+	if(joinpath){
+		if(!openRemote(remote,joinpath))
+			quit(window);
+		cout << "waiting for an opponent at " << joinpath << endl;
+		if(!waitWelcome(remote,REMOTE_WAIT_SECONDS)){
+			cout << "no match from " << joinpath << endl;
+			quit(window);
+		}
+		// the same level and seed, so the mirrored targets find their meshes
+		Profiler *profiling = game.profiler;
+		game = Game();
+		initGame(game,assets,&level,remote.seed);
+		game.profiler = profiling;
+		if(remote.levelhash!=levelHash(level)){
+			cout << "the server plays another level" << endl;
+			quit(window);
+		}
+		cout << "player " << remote.side+1 << ", seed : " << remote.seed << endl;
+	}
+	// picks the match up where the snapshot left it, controls included
+	if(resumepath && netside<0 && !spectatepath && !joinpath){
+		std::vector<uint8_t> bytes;
+		if(!readSnapshotFile(resumepath,bytes) || !restoreSnapshot(game,&bytes[0],bytes.size())){
+			cout << "cannot resume from " << resumepath << endl;
+			quit(window);
+		}
+		cout << "resumed at tick " << game.ticks << ", seed " << game.seed << endl;
+	}
+	if(replaypath){
+		if(!loadReplay(replay,replaypath,game) || !seekReplay(replay,game,replay.first))
+			quit(window);
+		cout << "replay of seed " << replay.header.seed << ", " << (replay.end-replay.first)/TICKS_PER_SECOND << " s" << endl;
+	}
+	// only local matches are recorded, a networked one takes its inputs from the wire
+	if(recordpath && netside<0 && !spectatepath && !joinpath && latency==0
+		&& !startReplay(recorder,recordpath,game,REPLAY_INTERVAL,REPLAY_ENTROPY))
+		quit(window);
+	// only a process that runs the rules sees the shots
+	if(telemetrypath && !spectatepath && !joinpath){
+		if(!startTelemetry(telemetry,telemetrypath,levelHash(level),game.seed))
+			quit(window);
+		game.telemetry = &telemetry;
+		// a networked match records a tick once no rollback can change it
+		if(net.active)
+			setNetTelemetry(net,game,&telemetry);
+	}
+	if(spectatorpath && !openSpectators(spectators,spectatorpath,levelHash(level)))
+		quit(window);
+	if(spectatepath && !connectSpectator(watcher,spectatepath))
+		quit(window);
 
-        if(enemyspeedflag==1){
-        	if(enemybulletx<=9.9){
-        	enemyvelocity = enemyvelocity + .2;
-        	theta = enemyrectangle_rotation*M_PI/180.0f;
-        	//cout << theta << endl;	
-        	enemybulletx = enemybulletx+-.05*cos(theta);
-        	enemybullety = enemybullety+-.05*sin(theta);
-        	}	
-        }
-        if(enemyupflag==1){
-        	enemybullety+=.1;
-        	enemycanonbasey+=.1;
-        	enemycanonrecty+=.1;
-        }
+    /* Draw in loop */
+    while (!glfwWindowShouldClose(window)) {
+        frame(window, width, height);
 
-        if(enemydownflag==1){
-        	enemybullety-=.1;
-        	enemycanonbasey-=.1;
-        	enemycanonrecty-=.1;
-        }
-        if(enemydirupflag==1){
-        	enemyrectangle_rotation+=2;
-        	if(enemyrectangle_rotation>=170){
-        		enemyrectangle_rotation=169;
-        	}
+        // keep sending until the peer has every input, or gave up on them
+        if(game.over && net.active){
+            std::chrono::steady_clock::time_point over = std::chrono::steady_clock::now();
+            while(!netSettled(net) && std::chrono::steady_clock::now()-over<std::chrono::duration<double>(NET_LINGER_SECONDS))
+                frame(window, width, height);
         }
-        if(enemydirdownflag==1){
-        	enemyrectangle_rotation-=2;
-        	if(enemyrectangle_rotation<=100){
-        		enemyrectangle_rotation=101;
-        	}
-        }
-
-	        if(enemyshootflag==1){
-	    	enemyshoot();
-	    	enemyi=enemyi+0.01;	
-	    }
-
-        // Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-        current_time = glfwGetTime(); // Time in seconds,can be used to make animations smooth
-        if ((current_time - last_update_time) >= 1) { // atleast 0.5s elapsed since last frame
-            // do something every 0.5 seconds ..
-            last_update_time = current_time;
-            COUNTDOWN --;
-            drawenemycountdown(COUNTDOWN);
-            if(SITECHANGE==2 && COUNTDOWN == 0){
-              cout << "player 1 score : " << score << endl;
-              cout << "player 2 score : " << enemyscore << endl;
-              quit(window);
+        // the viewer stays on the last tick until it is closed
+        if((game.over && !replay.active) || probeDone(probe)){
+            cout << "player 1 score : " << game.cannons[PLAYER].score << endl;
+            cout << "player 2 score : " << game.cannons[ENEMY].score << endl;
+            for(int c=0;c<2;c++){
+                if(planners[c].rollouts>0)
+                    cout << "player " << c+1 << " planner : " << plannerRolloutRate(planners[c]) << " rollouts/s" << endl;
             }
-            if(COUNTDOWN==0){
-
-            	SITECHANGE = 1;
-              COUNTDOWN = 30;
-            }
-            /*enemyi=0;enemyvelocity=1.2;
-            enemybulletx=enemycanonrectx;
-            enemybullety=enemycanonrecty;
-            enemyshootflag=1;
-            theta = enemyrectangle_rotation*M_PI/180.0f;
-
-            	enemyvx =enemyvelocity*cos(theta);
-  				enemyvy =enemyvelocity*sin(theta);*/
-            
-            
+            if(scorespath && game.over)
+                recordScores();
+            quit(window);
         }
     }
 
+    shutdownJobs();
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
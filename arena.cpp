@@ -0,0 +1,128 @@
+#include <new>
+
+#include "arena.h"
+
+/* keeps the first allocation of a block 16 byte aligned */
+#define ARENA_HEADER ((sizeof(ArenaBlock)+15)&~(size_t)15)
+
+static ArenaBlock *newBlock (Arena &arena, size_t size)
+{
+	ArenaBlock *block = (ArenaBlock*)::operator new(ARENA_HEADER+size);
+	block->next=NULL;
+	block->size=size;
+	block->used=0;
+	arena.grown++;
+	return block;
+}
+
+static void freeBlocks (ArenaBlock *block)
+{
+	while(block){
+		ArenaBlock *next = block->next;
+		::operator delete(block);
+		block=next;
+	}
+}
+
+void initArena (Arena &arena, size_t size)
+{
+	arena.first=arena.current=NULL;
+	arena.held=arena.peak=0;
+	arena.grown=0;
+	if(size)
+		arena.first=arena.current=newBlock(arena,size);
+}
+
+void freeArena (Arena &arena)
+{
+	freeBlocks(arena.first);
+	arena.first=arena.current=NULL;
+	arena.held=0;
+}
+
+static inline size_t padding (const ArenaBlock *block, size_t align)
+{
+	uintptr_t at = (uintptr_t)block+ARENA_HEADER+block->used;
+	return (size_t)(-at&(align-1));
+}
+
+void *arenaAlloc (Arena &arena, size_t size, size_t align)
+{
+	ArenaBlock *block = arena.current;
+	if(block && block->used+padding(block,align)+size>block->size){
+		/* the tail of this block is lost until the reset */
+		arena.held+=block->size-block->used;
+		block->used=block->size;
+		ArenaBlock *next = block->next;
+		if(next && size+align<=next->size){
+			next->used=0;
+			block=next;
+		}
+		else{
+			size_t want = 2*block->size;
+			if(want<size+align)
+				want=size+align;
+			ArenaBlock *fresh = newBlock(arena,want);
+			fresh->next=next;
+			block->next=fresh;
+			block=fresh;
+		}
+		arena.current=block;
+	}
+	else if(!block){
+		size_t want = size+align>ARENA_MIN_BLOCK ? size+align : ARENA_MIN_BLOCK;
+		block=arena.first=arena.current=newBlock(arena,want);
+	}
+	size_t pad = padding(block,align);
+	void *p = (uint8_t*)block+ARENA_HEADER+block->used+pad;
+	block->used+=pad+size;
+	arena.held+=pad+size;
+	if(arena.held>arena.peak)
+		arena.peak=arena.held;
+	return p;
+}
+
+void resetArena (Arena &arena)
+{
+	if(arena.first && arena.first->next){
+		freeBlocks(arena.first);
+		arena.first=arena.current=newBlock(arena,arena.peak);
+	}
+	arena.current=arena.first;
+	if(arena.first)
+		arena.first->used=0;
+	arena.held=0;
+}
+
+ArenaMark arenaMark (const Arena &arena)
+{
+	ArenaMark mark;
+	mark.block=arena.current;
+	mark.used=arena.current ? arena.current->used : 0;
+	mark.held=arena.held;
+	return mark;
+}
+
+/* Rewinding to where the arena was empty is a reset */
+void rewindArena (Arena &arena, const ArenaMark &mark)
+{
+	if(mark.held==0){
+		resetArena(arena);
+		return;
+	}
+	arena.current=mark.block;
+	arena.current->used=mark.used;
+	arena.held=mark.held;
+}
+
+struct FrameArena{
+	Arena arena;
+	FrameArena () { initArena(arena,0); }
+	~FrameArena () { freeArena(arena); }
+};
+
+Arena &frameArena ()
+{
+	static thread_local FrameArena frame;
+	return frame.arena;
+}
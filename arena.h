@@ -0,0 +1,65 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Linear allocators.
+   An arena hands out memory by bumping an offset and frees only all at
+   once. When its block is full it chains another from the heap; a reset
+   folds the chain into one block as large as the most it ever held, so an
+   arena reset every frame stops touching the heap once it has seen its
+   largest frame. Nothing is constructed or destructed, arenas are for
+   plain structs and arrays of them.
+
+   The level arena holds what lives as long as the level: the meshes, the
+   asset tables. Each thread also has a frame arena for scratch that lives
+   within a tick or a frame; code takes it under an ArenaScope, which
+   rewinds it on the way out, and the game loop resets it every frame. */
+
+#define ARENA_MIN_BLOCK (64*1024)
+
+struct ArenaBlock{
+	ArenaBlock *next;
+	size_t size;	/* bytes after the header */
+	size_t used;
+};
+
+struct Arena{
+	ArenaBlock *first, *current;	/* blocks after current are kept for reuse */
+	size_t held;	/* bytes taken since the reset, counting the unused tails of full blocks */
+	size_t peak;
+	long grown;	/* blocks taken from the heap */
+};
+
+struct ArenaMark{
+	ArenaBlock *block;
+	size_t used, held;
+};
+
+/* size 0 leaves the first block to the first allocation */
+void initArena (Arena &arena, size_t size);
+void freeArena (Arena &arena);
+void *arenaAlloc (Arena &arena, size_t size, size_t align);
+/* Forgets everything, keeping one block of the peak size */
+void resetArena (Arena &arena);
+
+ArenaMark arenaMark (const Arena &arena);
+void rewindArena (Arena &arena, const ArenaMark &mark);
+
+/* The calling thread's, freed when the thread exits */
+Arena &frameArena ();
+
+template<class T> T *arenaArray (Arena &arena, size_t count)
+{
+	return (T*)arenaAlloc(arena,count*sizeof(T),alignof(T));
+}
+
+struct ArenaScope{
+	Arena &arena;
+	ArenaMark mark;
+	explicit ArenaScope (Arena &a) : arena(a), mark(arenaMark(a)) {}
+	~ArenaScope () { rewindArena(arena,mark); }
+};
+
+#endif
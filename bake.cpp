@@ -0,0 +1,28 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "mesh.h"
+
+/* Asset baker: bake levels.bin assets.bin
+   Builds every mesh a match on the level draws and packs them into one
+   versioned blob, so the game skips mesh generation at startup */
+
+int main (int argc, char **argv)
+{
+	if(argc!=3){
+		fprintf(stderr,"usage: bake levels.bin assets.bin\n");
+		return EXIT_FAILURE;
+	}
+	Level level;
+	if(!loadLevel(level,argv[1]))
+		return EXIT_FAILURE;
+	MeshSet set;
+	buildGameMeshes(set,level);
+	if(!writeMeshBlob(set,levelHash(level),argv[2])){
+		fprintf(stderr,"bake : cannot write %s\n",argv[2]);
+		return EXIT_FAILURE;
+	}
+	printf("%s : %d meshes, %d vertices\n",argv[2],(int)set.meshes.size(),(int)set.vertices.size());
+	unloadLevel(level);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,569 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "sim.h"
+#include "mesh.h"
+#include "hud.h"
+#include "jobs.h"
+#include "profile.h"
+#include "snapshot.h"
+#include "scores.h"
+#include "replay.h"
+#include "pack.h"
+#include "allocs.h"
+#include "rng.h"
+
+/* Microbenchmarks of the hot paths that do not need a GL context.
+   Each benchmark runs its function in batches for BENCH_SECONDS and
+   reports the mean and the p50/p99 of the per batch ns per call. The tick
+   phases come from a whole match played by the closed form aimers with
+   the frame profiler attached, so collision and projectile integration
+   are timed where they run, and its ticks are checked for heap
+   allocations. Output is CSV on stdout; --compare adds the
+   change of each p50 against a baseline written by --write, the p50 is
+   far steadier from run to run than the mean.
+
+   bench [--level levels.bin] [--assets assets.bin]
+         [--compare bench.baseline] [--write bench.baseline] */
+
+#define BENCH_SECONDS .2
+#define BENCH_SEED 1
+#define BENCH_SCORES 1000000	/* records in the high score log queried */
+#define BENCH_NAMES 1000
+
+typedef void (*BenchFunction)(void *data);
+
+struct BenchResult{
+	std::string name;
+	uint64_t calls;
+	double ns;		/* mean per call */
+	uint64_t p50, p99;
+};
+
+static std::vector<BenchResult> results;
+
+static void addResult (const char *name, const Histogram &h, uint64_t calls, uint64_t total)
+{
+	BenchResult r;
+	r.name=name;
+	r.calls=calls;
+	r.ns=calls ? (double)total/calls : 0;
+	r.p50=histogramQuantile(h,.5);
+	r.p99=histogramQuantile(h,.99);
+	results.push_back(r);
+}
+
+static void bench (const char *name, int batch, BenchFunction fn, void *data)
+{
+	static Histogram h;
+	memset(&h,0,sizeof h);
+	for(int k=0;k<batch;k++)
+		fn(data);	/* warm up */
+	uint64_t calls = 0, total = 0;
+	uint64_t start = profileClock();
+	while(total<BENCH_SECONDS*1e9){
+		uint64_t t = profileClock();
+		for(int k=0;k<batch;k++)
+			fn(data);
+		uint64_t ns = profileClock()-t;
+		addSample(h,ns/batch);
+		calls+=batch;
+		total=profileClock()-start;
+	}
+	addResult(name,h,calls,total);
+}
+
+struct MeshBench{
+	MeshSet set;
+	const Level *level;
+	const char *assets;
+	uint32_t hash;
+};
+
+static void clearSet (MeshSet &set)
+{
+	set.vertices.clear();
+	set.meshes.clear();
+}
+
+static void benchCircles (void *data)
+{
+	MeshBench *b = (MeshBench*)data;
+	clearSet(b->set);
+	createCircles(b->set,0,0,.5,1,0,0);
+}
+
+static void benchSemiCircles (void *data)
+{
+	MeshBench *b = (MeshBench*)data;
+	clearSet(b->set);
+	createSemiCircles(b->set,0,0,.5,1,0,0);
+}
+
+static void benchRectangles (void *data)
+{
+	MeshBench *b = (MeshBench*)data;
+	clearSet(b->set);
+	createRectangles(b->set,0,0,.4,8,1,0,0);
+}
+
+static void benchGameMeshes (void *data)
+{
+	MeshBench *b = (MeshBench*)data;
+	buildGameMeshes(b->set,*b->level);
+}
+
+/* What the game does before its one glBufferData */
+static void benchLoadBlob (void *data)
+{
+	MeshBench *b = (MeshBench*)data;
+	MeshBlob blob;
+	if(loadMeshBlob(blob,b->assets,b->hash))
+		unloadMeshBlob(blob);
+}
+
+struct GameBench{
+	Game start;
+	Game game;
+	int value;
+	std::vector<uint8_t> snapshot;
+};
+
+static void benchTick (void *data)
+{
+	GameBench *b = (GameBench*)data;
+	if(b->game.over)
+		b->game=b->start;
+	tickGame(b->game,1.0f/TICKS_PER_SECOND);
+}
+
+static void benchSaveSnapshot (void *data)
+{
+	GameBench *b = (GameBench*)data;
+	saveSnapshot(b->snapshot,b->start);
+}
+
+/* Into a Game that already holds a match, as the planner and rollback do */
+static void benchRestoreSnapshot (void *data)
+{
+	GameBench *b = (GameBench*)data;
+	restoreSnapshot(b->game,&b->snapshot[0],b->snapshot.size());
+}
+
+static void benchCreatenumber (void *data)
+{
+	GameBench *b = (GameBench*)data;
+	createnumber(b->value++%10);
+}
+
+static void benchDrawscore (void *data)
+{
+	GameBench *b = (GameBench*)data;
+	drawscore(b->game.world,b->value++%100);
+}
+
+struct ScoresBench{
+	ScoreStore store;
+	std::vector<ScoreRecord> out;
+	int value;
+};
+
+/* A log of BENCH_SCORES made up records, indexed, in a temporary file */
+static int fillScores (ScoresBench &b, const char *path)
+{
+	unlink(path);
+	if(!openScores(b.store,path))
+		return 0;
+	Rng rng = rngStream(BENCH_SEED,0);
+	std::vector<ScoreRecord> records(BENCH_SCORES);
+	char name[32];
+	for(int k=0;k<BENCH_SCORES;k++){
+		snprintf(name,sizeof name,"sim %u",rngRange(rng,BENCH_NAMES));
+		fillScoreRecord(records[k],name,rngRange(rng,200),rngRange(rng,200));
+	}
+	return appendScores(b.store,&records[0],records.size()) && indexScores(b.store);
+}
+
+static void benchTopScores (void *data)
+{
+	ScoresBench *b = (ScoresBench*)data;
+	topScores(b->store,100,b->out);
+}
+
+static void benchPlayerScores (void *data)
+{
+	ScoresBench *b = (ScoresBench*)data;
+	char name[32];
+	snprintf(name,sizeof name,"sim %d",b->value++%BENCH_NAMES);
+	playerScores(b->store,name,10,b->out);
+}
+
+static void benchScoreRank (void *data)
+{
+	ScoresBench *b = (ScoresBench*)data;
+	scoreRank(b->store,b->value++%200);
+}
+
+struct ReplayBench{
+	Replay replay;
+	Game game;
+	Rng rng;
+};
+
+/* A match of the closed form aimers recorded to a temporary file and read back */
+static int recordMatch (ReplayBench &b, const Game &start, const char *path)
+{
+	ReplayRecorder rec;
+	Game game = start;
+	if(!startReplay(rec,path,game,REPLAY_INTERVAL,REPLAY_ENTROPY))
+		return 0;
+	while(!game.over){
+		replayTick(rec,game);
+		tickGame(game,1.0f/TICKS_PER_SECOND);
+	}
+	stopReplay(rec,game);
+	b.game=start;
+	b.rng=rngStream(BENCH_SEED,0);
+	return loadReplay(b.replay,path,b.game);
+}
+
+/* Anywhere in the match, from wherever the last seek left it */
+static void benchSeekReplay (void *data)
+{
+	ReplayBench *b = (ReplayBench*)data;
+	seekReplay(b->replay,b->game,b->replay.first+rngRange(b->rng,b->replay.end-b->replay.first));
+}
+
+struct PackBench{
+	std::vector<uint8_t> previous, keyframe;	/* a second of play apart */
+	std::vector<uint8_t> packed, entropy, out;
+};
+
+static void benchPackSnapshot (void *data)
+{
+	PackBench *b = (PackBench*)data;
+	b->packed.clear();
+	packSnapshot(b->packed,&b->keyframe[0],b->keyframe.size(),&b->previous[0],b->previous.size());
+}
+
+static void benchUnpackSnapshot (void *data)
+{
+	PackBench *b = (PackBench*)data;
+	unpackSnapshot(b->out,&b->packed[0],b->packed.size(),&b->previous[0],b->previous.size());
+}
+
+static void benchPackEntropy (void *data)
+{
+	PackBench *b = (PackBench*)data;
+	b->entropy.clear();
+	packEntropy(b->entropy,&b->packed[0],b->packed.size());
+}
+
+static void benchUnpackEntropy (void *data)
+{
+	PackBench *b = (PackBench*)data;
+	unpackEntropy(b->out,&b->entropy[0],b->entropy.size());
+}
+
+/* Both stages have to give back what they packed, and a damaged input,
+   cut short, flipped or with sizes made up, has to be refused or decode
+   to something without writing out of bounds. Returns 0 on a mismatch */
+static int checkPack (PackBench &b)
+{
+	std::vector<uint8_t> out;
+	packSnapshot(b.packed,&b.keyframe[0],b.keyframe.size(),NULL,0);
+	if(!unpackSnapshot(out,&b.packed[0],b.packed.size(),NULL,0) || out!=b.keyframe)
+		return 0;
+	b.packed.clear();
+	packSnapshot(b.packed,&b.keyframe[0],b.keyframe.size(),&b.previous[0],b.previous.size());
+	if(!unpackSnapshot(out,&b.packed[0],b.packed.size(),&b.previous[0],b.previous.size()) || out!=b.keyframe)
+		return 0;
+	b.entropy.clear();
+	packEntropy(b.entropy,&b.packed[0],b.packed.size());
+	if(!unpackEntropy(out,&b.entropy[0],b.entropy.size()) || out!=b.packed)
+		return 0;
+
+	long refused = 0, tried = 0;
+	/* a run of 2^32-1 words and one literal, which once wrapped the bounds check */
+	std::vector<uint8_t> made;
+	putVarint(made,64);
+	putVarint(made,0xffffffffu);
+	putVarint(made,1);
+	refused+=!unpackSnapshot(out,&made[0],made.size(),&b.previous[0],b.previous.size());
+	made.clear();
+	putVarint(made,0xfffffff0u);
+	made.resize(made.size()+8,0);
+	refused+=!unpackSnapshot(out,&made[0],made.size(),NULL,0);
+	refused+=!unpackEntropy(out,&made[0],made.size());
+	tried+=3;
+	for(size_t n=1;n<b.packed.size();n++,tried++)
+		refused+=!unpackSnapshot(out,&b.packed[0],n,&b.previous[0],b.previous.size());
+	for(size_t n=1;n<b.entropy.size();n++,tried++)
+		refused+=!unpackEntropy(out,&b.entropy[0],n);
+	Rng rng;
+	seedRng(rng,BENCH_SEED);
+	for(int k=0;k<1000;k++,tried+=2){
+		std::vector<uint8_t> packed = b.packed, entropy = b.entropy;
+		packed[rngRange(rng,packed.size())]^=1+rngRange(rng,255);
+		entropy[rngRange(rng,entropy.size())]^=1+rngRange(rng,255);
+		refused+=!unpackSnapshot(out,&packed[0],packed.size(),&b.previous[0],b.previous.size());
+		refused+=!unpackEntropy(out,&entropy[0],entropy.size());
+	}
+	fprintf(stderr,"Bench : pack round trips, %ld of %ld damaged inputs refused\n",refused,tried);
+	return 1;
+}
+
+/* The target the aimer solved for, in the order aimShot() lists them */
+static Entity aimedTarget (World &world, int index)
+{
+	for(size_t a=0;a<world.archetypes.size();a++){
+		Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,COMP_TRANSFORM|COMP_VELOCITY|TAG_TARGET|TAG_ACTIVE))
+			continue;
+		if(index<(int)arch.entities.size())
+			return arch.entities[index];
+		index-=arch.entities.size();
+	}
+	return NULL_ENTITY;
+}
+
+/* Replays solved shots through the game's own ticks: a shot fired by the
+   aimer at tick T, solved for n steps, has the bullet's centre on the
+   target's when tick T+n tests them, unless it hit something sooner.
+   The aimer does not lead a scrolling camera, shots that fly while it
+   moves are left out. Returns 0 if a shot misses that centre by more than AIM_TOLERANCE */
+#define AIM_TOLERANCE .02f
+static int checkAim (const Game &start)
+{
+	Game game = start;
+	game.cannons[PLAYER].control=game.cannons[ENEMY].control=CONTROL_HUMAN;
+	int shots = 0, early = 0, scrolled = 0;
+	float worst = 0;
+	while(!game.over && game.stage==0){
+		Game g = game;
+		tickGame(game,1.0f/TICKS_PER_SECOND);
+		g.cannons[PLAYER].control=CONTROL_AUTOAIM;
+		tickGame(g,1.0f/TICKS_PER_SECOND);
+		Cannon &can = g.cannons[PLAYER];
+		if(!can.shootflag || can.launchtick!=g.ticks-1)
+			continue;
+		/* the targets and the base are where the aimer saw them */
+		AimShot shot;
+		if(!aimShot(g,PLAYER,AI_MAX_CHARGE,shot))
+			return 0;
+		Entity target = aimedTarget(g.world,shot.target);
+		float camerax = g.camerax;
+		can.control=CONTROL_HUMAN;
+		int k;
+		for(k=1;k<shot.frames && !can.hits;k++)
+			tickGame(g,1.0f/TICKS_PER_SECOND);
+		if(g.camerax!=camerax){
+			scrolled++;
+			continue;
+		}
+		shots++;
+		if(can.hits){
+			early++;
+			continue;
+		}
+		Transform *b = getTransform(g.world,can.bullet), *t = getTransform(g.world,target);
+		if(!t)
+			return 0;
+		float miss = hypotf(b->x+g.camerax-t->x,b->y-t->y);
+		if(miss>worst)
+			worst=miss;
+	}
+	fprintf(stderr,"Bench : %d aimed shots (%d more during a scroll), %d hit before their step, the others miss the target's centre by %.4f at most\n",
+		shots,scrolled,early,worst);
+	return shots>0 && worst<=AIM_TOLERANCE;
+}
+
+/* One match with the profiler on, the tick phases are reported per call */
+static void benchMatch (GameBench &b)
+{
+	static Profiler profiler;
+	clearProfiler(profiler);
+	Game game = b.start;
+	game.profiler=&profiler;
+	uint64_t allocations = 0;
+	int steady = 0, allocating = 0;
+	while(!game.over){
+		uint64_t before = heapAllocations();
+		tickGame(game,1.0f/TICKS_PER_SECOND);
+		if(game.ticks>TICKS_PER_SECOND){
+			uint64_t n = heapAllocations()-before;
+			steady++;
+			allocating+=n>0;
+			allocations+=n;
+		}
+	}
+	fprintf(stderr,"Bench : %d of %d ticks after the first second allocated, %llu allocations\n",allocating,steady,(unsigned long long)allocations);
+	static const int phases[] = {PHASE_SCROLL, PHASE_COLLISION, PHASE_TARGETS, PHASE_PROJECTILES, PHASE_COUNTDOWN};
+	for(size_t k=0;k<sizeof phases/sizeof phases[0];k++){
+		const Histogram &h = profiler.phases[phases[k]];
+		std::string name = std::string("tick.")+phasenames[phases[k]];
+		addResult(name.c_str(),h,h.count,h.sum);
+	}
+}
+
+static std::map<std::string,double> readBaseline (const char *path)
+{
+	std::map<std::string,double> baseline;
+	FILE *in = fopen(path,"r");
+	if(!in){
+		fprintf(stderr,"Bench : cannot read %s\n",path);
+		return baseline;
+	}
+	char line[256], name[128];
+	double p50;
+	while(fgets(line,sizeof line,in)){
+		if(sscanf(line,"%127[^,],%*u,%*f,%lf",name,&p50)==2)
+			baseline[name]=p50;
+	}
+	fclose(in);
+	return baseline;
+}
+
+static void writeResults (FILE *out, const std::map<std::string,double> *baseline)
+{
+	fprintf(out,"name,calls,ns_per_call,p50_ns,p99_ns%s\n",baseline ? ",baseline_p50_ns,change_pct" : "");
+	for(size_t k=0;k<results.size();k++){
+		const BenchResult &r = results[k];
+		fprintf(out,"%s,%llu,%.1f,%llu,%llu",r.name.c_str(),(unsigned long long)r.calls,r.ns,
+			(unsigned long long)r.p50,(unsigned long long)r.p99);
+		if(baseline){
+			std::map<std::string,double>::const_iterator b = baseline->find(r.name);
+			if(b!=baseline->end() && b->second>0)
+				fprintf(out,",%.0f,%+.1f",b->second,100*(r.p50-b->second)/b->second);
+			else
+				fprintf(out,",,");
+		}
+		fprintf(out,"\n");
+	}
+}
+
+int main (int argc, char **argv)
+{
+	const char *levelpath = "levels.bin";
+	const char *assets = "assets.bin";
+	const char *compare = NULL;
+	const char *writepath = NULL;
+	for(int k=1;k+1<argc;k++){
+		if(strcmp(argv[k],"--level")==0)
+			levelpath = argv[k+1];
+		if(strcmp(argv[k],"--assets")==0)
+			assets = argv[k+1];
+		if(strcmp(argv[k],"--compare")==0)
+			compare = argv[k+1];
+		if(strcmp(argv[k],"--write")==0)
+			writepath = argv[k+1];
+	}
+	Level level;
+	if(!loadLevel(level,levelpath))
+		return 1;
+	/* one thread, the numbers should not depend on the machine's core count */
+	initJobs(0);
+
+	MeshBench *meshbench = new MeshBench;
+	meshbench->level=&level;
+	meshbench->assets=assets;
+	meshbench->hash=levelHash(level);
+	bench("mesh.createCircles",1000,benchCircles,meshbench);
+	bench("mesh.createSemiCircles",1000,benchSemiCircles,meshbench);
+	bench("mesh.createRectangles",1000,benchRectangles,meshbench);
+	bench("mesh.buildGameMeshes",100,benchGameMeshes,meshbench);
+	MeshBlob blob;
+	if(loadMeshBlob(blob,assets,meshbench->hash)){
+		unloadMeshBlob(blob);
+		bench("mesh.loadMeshBlob",100,benchLoadBlob,meshbench);
+	}
+	else
+		fprintf(stderr,"Bench : %s is missing or stale, skipping mesh.loadMeshBlob\n",assets);
+
+	/* the benchmarks never draw, the meshes can stay NULL */
+	GameAssets gameassets;
+	memset(&gameassets,0,sizeof gameassets);
+	GameBench *gamebench = new GameBench;
+	initGame(gamebench->start,gameassets,&level,BENCH_SEED);
+	for(int c=0;c<2;c++)
+		gamebench->start.cannons[c].control=CONTROL_AUTOAIM;
+	gamebench->game=gamebench->start;
+	gamebench->value=0;
+	if(!checkAim(gamebench->start)){
+		fprintf(stderr,"Bench : the aimer's shots do not land where it solved them\n");
+		return 1;
+	}
+	bench("sim.tickGame",100,benchTick,gamebench);
+	benchMatch(*gamebench);
+	bench("snapshot.save",100,benchSaveSnapshot,gamebench);
+	bench("snapshot.restore",100,benchRestoreSnapshot,gamebench);
+	PackBench *packbench = new PackBench;
+	Game packgame = gamebench->start;
+	for(int k=0;k<10*TICKS_PER_SECOND;k++)
+		tickGame(packgame,1.0f/TICKS_PER_SECOND);
+	saveSnapshot(packbench->previous,packgame);
+	for(int k=0;k<REPLAY_INTERVAL;k++)
+		tickGame(packgame,1.0f/TICKS_PER_SECOND);
+	saveSnapshot(packbench->keyframe,packgame);
+	if(!checkPack(*packbench)){
+		fprintf(stderr,"Bench : pack does not round trip\n");
+		return 1;
+	}
+	bench("pack.snapshot",100,benchPackSnapshot,packbench);
+	bench("pack.unpackSnapshot",100,benchUnpackSnapshot,packbench);
+	bench("pack.entropy",10,benchPackEntropy,packbench);
+	bench("pack.unpackEntropy",10,benchUnpackEntropy,packbench);
+	fprintf(stderr,"Bench : a %d byte keyframe packs to %d bytes against the one a second before, %d after the entropy stage\n",
+		(int)packbench->keyframe.size(),(int)packbench->packed.size(),(int)packbench->entropy.size());
+	delete packbench;
+	ReplayBench *replaybench = new ReplayBench;
+	char replaypath[64];
+	snprintf(replaypath,sizeof replaypath,"/tmp/bench-replay-%d",(int)getpid());
+	if(recordMatch(*replaybench,gamebench->start,replaypath))
+		bench("replay.seek",10,benchSeekReplay,replaybench);
+	else
+		fprintf(stderr,"Bench : cannot write %s, skipping the replay seek\n",replaypath);
+	unlink(replaypath);
+	delete replaybench;
+	ScoresBench *scoresbench = new ScoresBench;
+	char scorespath[64];
+	snprintf(scorespath,sizeof scorespath,"/tmp/bench-scores-%d",(int)getpid());
+	if(fillScores(*scoresbench,scorespath)){
+		bench("scores.top100",10,benchTopScores,scoresbench);
+		bench("scores.player10",10,benchPlayerScores,scoresbench);
+		bench("scores.rank",100,benchScoreRank,scoresbench);
+	}
+	else
+		fprintf(stderr,"Bench : cannot write %s, skipping the high score queries\n",scorespath);
+	closeScores(scoresbench->store);
+	unlink(scorespath);
+	unlink((std::string(scorespath)+".idx").c_str());
+	delete scoresbench;
+	bench("hud.createnumber",1000,benchCreatenumber,gamebench);
+	bench("hud.drawscore",1000,benchDrawscore,gamebench);
+
+	std::map<std::string,double> baseline;
+	if(compare)
+		baseline=readBaseline(compare);
+	writeResults(stdout,compare ? &baseline : NULL);
+	if(writepath){
+		FILE *out = fopen(writepath,"w");
+		if(!out)
+			fprintf(stderr,"Bench : cannot write %s\n",writepath);
+		else{
+			writeResults(out,NULL);
+			fclose(out);
+		}
+	}
+	delete gamebench;
+	delete meshbench;
+	shutdownJobs();
+	unloadLevel(level);
+	return 0;
+}
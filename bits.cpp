@@ -0,0 +1,80 @@
+#include "bits.h"
+
+static const int varwidths[4] = {4, 8, 16, 32};
+
+void clearBits (BitWriter &w)
+{
+	w.bytes.clear();
+	w.acc=0;
+	w.nbits=0;
+}
+
+void writeBits (BitWriter &w, uint32_t value, int n)
+{
+	if(n<32)
+		value&=(1u<<n)-1;
+	w.acc|=(uint64_t)value<<w.nbits;
+	w.nbits+=n;
+	while(w.nbits>=8){
+		w.bytes.push_back((uint8_t)w.acc);
+		w.acc>>=8;
+		w.nbits-=8;
+	}
+}
+
+void writeVar (BitWriter &w, uint32_t value)
+{
+	int c = 0;
+	while(c<3 && value>>varwidths[c])
+		c++;
+	writeBits(w,c,2);
+	writeBits(w,value,varwidths[c]);
+}
+
+void writeSigned (BitWriter &w, int32_t value)
+{
+	writeVar(w,zigzag(value));
+}
+
+void flushBits (BitWriter &w)
+{
+	if(w.nbits>0)
+		w.bytes.push_back((uint8_t)w.acc);
+	w.acc=0;
+	w.nbits=0;
+}
+
+void startBits (BitReader &r, const uint8_t *bytes, size_t size)
+{
+	r.bytes=bytes;
+	r.size=size;
+	r.pos=0;
+	r.acc=0;
+	r.nbits=0;
+	r.overrun=0;
+}
+
+uint32_t readBits (BitReader &r, int n)
+{
+	while(r.nbits<n){
+		if(r.pos<r.size)
+			r.acc|=(uint64_t)r.bytes[r.pos++]<<r.nbits;
+		else
+			r.overrun=1;
+		r.nbits+=8;
+	}
+	uint32_t value = (uint32_t)(n<32 ? r.acc&((1ull<<n)-1) : r.acc);
+	r.acc>>=n;
+	r.nbits-=n;
+	return value;
+}
+
+uint32_t readVar (BitReader &r)
+{
+	return readBits(r,varwidths[readBits(r,2)]);
+}
+
+int32_t readSigned (BitReader &r)
+{
+	return unzigzag(readVar(r));
+}
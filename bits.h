@@ -0,0 +1,51 @@
+#ifndef BITS_H
+#define BITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Bit packing for the wire formats.
+   Bits are written least significant first into whole bytes. Small
+   integers take a 2 bit width class and then 4, 8, 16 or 32 bits, and
+   signed ones are zigzagged first so a small delta of either sign stays
+   small. A reader that runs past its bytes reads zeros and sets overrun. */
+
+struct BitWriter{
+	std::vector<uint8_t> bytes;
+	uint64_t acc;
+	int nbits;
+};
+
+struct BitReader{
+	const uint8_t *bytes;
+	size_t size;
+	size_t pos;
+	uint64_t acc;
+	int nbits;
+	int overrun;
+};
+
+void clearBits (BitWriter &w);
+void writeBits (BitWriter &w, uint32_t value, int n);
+void writeVar (BitWriter &w, uint32_t value);
+void writeSigned (BitWriter &w, int32_t value);
+/* Pads the last byte, the bytes are complete afterwards */
+void flushBits (BitWriter &w);
+
+void startBits (BitReader &r, const uint8_t *bytes, size_t size);
+uint32_t readBits (BitReader &r, int n);
+uint32_t readVar (BitReader &r);
+int32_t readSigned (BitReader &r);
+
+static inline uint32_t zigzag (int32_t v)
+{
+	return ((uint32_t)v<<1)^(uint32_t)(v>>31);
+}
+
+static inline int32_t unzigzag (uint32_t v)
+{
+	return (int32_t)(v>>1)^-(int32_t)(v&1);
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include <cstddef>
+
+#include "ecs.h"
+
+/* Apply X(bit, member) to every data column of an archetype */
+#define ECS_COLUMNS(X) \
+	X(COMP_TRANSFORM, transforms) \
+	X(COMP_VELOCITY, velocities) \
+	X(COMP_SHAPE, shapes) \
+	X(COMP_MESH, meshes) \
+	X(COMP_COLLIDER, colliders) \
+	X(COMP_SCORE, scores) \
+	X(COMP_SEGMENT, segments)
+
+static inline unsigned int entityIndex (Entity e)
+{
+	return e & ENTITY_INDEX_MASK;
+}
+
+static inline unsigned int entityGeneration (Entity e)
+{
+	return e >> ENTITY_INDEX_BITS;
+}
+
+static int findArchetype (World &world, unsigned int mask)
+{
+	for(size_t a=0;a<world.archetypes.size();a++){
+		if(world.archetypes[a].mask==mask)
+			return (int)a;
+	}
+	Archetype arch;
+	arch.mask=mask;
+	world.archetypes.push_back(arch);
+	return (int)world.archetypes.size()-1;
+}
+
+/* Append a default initialised row, returns its index */
+static int pushRow (Archetype &arch, Entity e)
+{
+	arch.entities.push_back(e);
+#define PUSH_COLUMN(bit, member) \
+	if(arch.mask & bit) arch.member.push_back(decltype(arch.member)::value_type());
+	ECS_COLUMNS(PUSH_COLUMN)
+#undef PUSH_COLUMN
+	return (int)arch.entities.size()-1;
+}
+
+/* Swap-remove a row and patch the record of the entity moved into its place */
+static void removeRow (World &world, Archetype &arch, int row)
+{
+	int last = (int)arch.entities.size()-1;
+	if(row!=last){
+		arch.entities[row]=arch.entities[last];
+#define MOVE_COLUMN(bit, member) \
+		if(arch.mask & bit) arch.member[row]=arch.member[last];
+		ECS_COLUMNS(MOVE_COLUMN)
+#undef MOVE_COLUMN
+		world.records[entityIndex(arch.entities[row])].row=row;
+	}
+	arch.entities.pop_back();
+#define POP_COLUMN(bit, member) \
+	if(arch.mask & bit) arch.member.pop_back();
+	ECS_COLUMNS(POP_COLUMN)
+#undef POP_COLUMN
+}
+
+Entity createEntity (World &world, unsigned int mask)
+{
+	unsigned int index;
+	if(!world.freeindices.empty()){
+		index=world.freeindices.back();
+		world.freeindices.pop_back();
+	}
+	else{
+		EntityRecord rec;
+		rec.archetype=-1;
+		rec.row=-1;
+		rec.generation=0;
+		index=(unsigned int)world.records.size();
+		world.records.push_back(rec);
+	}
+	EntityRecord &rec = world.records[index];
+	Entity e = index | (rec.generation<<ENTITY_INDEX_BITS);
+	rec.archetype=findArchetype(world,mask);
+	rec.row=pushRow(world.archetypes[rec.archetype],e);
+	return e;
+}
+
+bool entityAlive (const World &world, Entity e)
+{
+	unsigned int index = entityIndex(e);
+	if(e==NULL_ENTITY || index>=world.records.size())
+		return false;
+	const EntityRecord &rec = world.records[index];
+	return rec.archetype>=0 && rec.generation==entityGeneration(e);
+}
+
+void destroyEntity (World &world, Entity e)
+{
+	if(!entityAlive(world,e))
+		return;
+	unsigned int index = entityIndex(e);
+	EntityRecord &rec = world.records[index];
+	removeRow(world,world.archetypes[rec.archetype],rec.row);
+	rec.archetype=-1;
+	rec.row=-1;
+	rec.generation=(rec.generation+1)&0xff;
+	world.freeindices.push_back(index);
+}
+
+unsigned int entityMask (const World &world, Entity e)
+{
+	if(!entityAlive(world,e))
+		return 0;
+	return world.archetypes[world.records[entityIndex(e)].archetype].mask;
+}
+
+void setEntityMask (World &world, Entity e, unsigned int mask)
+{
+	if(!entityAlive(world,e))
+		return;
+	EntityRecord &rec = world.records[entityIndex(e)];
+	if(world.archetypes[rec.archetype].mask==mask)
+		return;
+	int to = findArchetype(world,mask);
+	Archetype &src = world.archetypes[rec.archetype];
+	Archetype &dst = world.archetypes[to];
+	int row = pushRow(dst,e);
+	/* components present in both masks keep their data */
+#define COPY_COLUMN(bit, member) \
+	if((src.mask & bit) && (dst.mask & bit)) dst.member[row]=src.member[rec.row];
+	ECS_COLUMNS(COPY_COLUMN)
+#undef COPY_COLUMN
+	removeRow(world,src,rec.row);
+	rec.archetype=to;
+	rec.row=row;
+}
+
+void addTags (World &world, Entity e, unsigned int tags)
+{
+	setEntityMask(world,e,entityMask(world,e)|tags);
+}
+
+void removeTags (World &world, Entity e, unsigned int tags)
+{
+	setEntityMask(world,e,entityMask(world,e)&~tags);
+}
+
+void queueTags (World &world, Entity e, unsigned int add, unsigned int remove)
+{
+	MaskChange c;
+	c.e=e;
+	c.add=add;
+	c.remove=remove;
+	world.pending.push_back(c);
+}
+
+void flushWorld (World &world)
+{
+	for(size_t k=0;k<world.pending.size();k++){
+		MaskChange &c = world.pending[k];
+		setEntityMask(world,c.e,(entityMask(world,c.e)|c.add)&~c.remove);
+	}
+	world.pending.clear();
+}
+
+bool archetypeMatches (const Archetype &arch, unsigned int all, unsigned int none)
+{
+	return (arch.mask & all)==all && (arch.mask & none)==0;
+}
+
+#define ECS_GETTER(name, type, bit, member) \
+type* name (World &world, Entity e) \
+{ \
+	if(!entityAlive(world,e)) \
+		return NULL; \
+	EntityRecord &rec = world.records[entityIndex(e)]; \
+	Archetype &arch = world.archetypes[rec.archetype]; \
+	if(!(arch.mask & bit)) \
+		return NULL; \
+	return &arch.member[rec.row]; \
+}
+
+ECS_GETTER(getTransform, Transform, COMP_TRANSFORM, transforms)
+ECS_GETTER(getVelocity, Velocity, COMP_VELOCITY, velocities)
+ECS_GETTER(getShape, Shape, COMP_SHAPE, shapes)
+ECS_GETTER(getMesh, RenderMesh, COMP_MESH, meshes)
+ECS_GETTER(getCollider, Collider, COMP_COLLIDER, colliders)
+ECS_GETTER(getScore, ScoreValue, COMP_SCORE, scores)
+ECS_GETTER(getSegment, Segment, COMP_SEGMENT, segments)
@@ -0,0 +1,150 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <vector>
+
+/* Archetype based entity-component-system.
+   Every distinct component mask gets its own Archetype which stores each
+   component in a packed array, so systems walk contiguous memory. */
+
+struct VAO;
+
+typedef unsigned int Entity;
+#define NULL_ENTITY 0xffffffffu
+#define ENTITY_INDEX_BITS 24
+#define ENTITY_INDEX_MASK ((1u<<ENTITY_INDEX_BITS)-1)
+
+/* Component bits. Tags carry no data and only split entities into archetypes */
+enum {
+	COMP_TRANSFORM = 1<<0,
+	COMP_VELOCITY  = 1<<1,
+	COMP_SHAPE     = 1<<2,
+	COMP_MESH      = 1<<3,
+	COMP_COLLIDER  = 1<<4,
+	COMP_SCORE     = 1<<5,
+	COMP_SEGMENT   = 1<<6,
+
+	TAG_BACKGROUND = 1<<16,
+	TAG_CANNON     = 1<<17,
+	TAG_PROJECTILE = 1<<18,
+	TAG_TARGET     = 1<<19,
+	TAG_OBSTACLE   = 1<<20,
+	TAG_DIGIT      = 1<<21,
+	TAG_ACTIVE     = 1<<22,
+	TAG_SCREEN     = 1<<23	/* placed in screen space, the camera scroll leaves it alone */
+};
+#define COMP_DATA_MASK 0xffffu
+
+/* rotation is in degrees, like rectangle_rotation */
+struct Transform{
+	float x;
+	float y;
+	float rotation;
+};
+
+/* t is the flight time used by the projectile and target trajectories */
+struct Velocity{
+	float vx;
+	float vy;
+	float t;
+};
+
+enum {
+	SHAPE_RECTANGLE,
+	SHAPE_CIRCLE,
+	SHAPE_SEMICIRCLE,
+	SHAPE_TRIANGLE,
+	SHAPE_RHOMBUS,
+	SHAPE_SQUARE
+};
+
+struct Shape{
+	int kind;
+	float radius;
+	float length;
+	float breadth;
+	float c1,c2,c3;
+};
+
+/* Meshes are drawn in ascending layer order */
+struct RenderMesh{
+	VAO *vao;
+	int layer;
+	int visible;
+};
+
+/* Circle if radius > 0, otherwise an axis aligned box */
+struct Collider{
+	float radius;
+	float halfw;
+	float halfh;
+};
+
+struct ScoreValue{
+	int points;
+	int kind;	/* the spawner class it was made from */
+};
+
+/* One bar of a seven segment HUD digit */
+struct Segment{
+	int display;
+	int place;
+	int segment;
+};
+
+struct Archetype{
+	unsigned int mask;
+	std::vector<Entity> entities;
+	std::vector<Transform> transforms;
+	std::vector<Velocity> velocities;
+	std::vector<Shape> shapes;
+	std::vector<RenderMesh> meshes;
+	std::vector<Collider> colliders;
+	std::vector<ScoreValue> scores;
+	std::vector<Segment> segments;
+};
+
+struct EntityRecord{
+	int archetype;
+	int row;
+	unsigned int generation;
+};
+
+struct MaskChange{
+	Entity e;
+	unsigned int add;
+	unsigned int remove;
+};
+
+struct World{
+	std::vector<Archetype> archetypes;
+	std::vector<EntityRecord> records;
+	std::vector<unsigned int> freeindices;
+	std::vector<MaskChange> pending;
+};
+
+Entity createEntity (World &world, unsigned int mask);
+void destroyEntity (World &world, Entity e);
+bool entityAlive (const World &world, Entity e);
+unsigned int entityMask (const World &world, Entity e);
+
+/* Structural changes move the entity to the archetype of the new mask */
+void setEntityMask (World &world, Entity e, unsigned int mask);
+void addTags (World &world, Entity e, unsigned int tags);
+void removeTags (World &world, Entity e, unsigned int tags);
+
+/* Deferred structural changes, safe to queue while a system iterates */
+void queueTags (World &world, Entity e, unsigned int add, unsigned int remove);
+void flushWorld (World &world);
+
+bool archetypeMatches (const Archetype &arch, unsigned int all, unsigned int none=0);
+
+Transform* getTransform (World &world, Entity e);
+Velocity* getVelocity (World &world, Entity e);
+Shape* getShape (World &world, Entity e);
+RenderMesh* getMesh (World &world, Entity e);
+Collider* getCollider (World &world, Entity e);
+ScoreValue* getScore (World &world, Entity e);
+Segment* getSegment (World &world, Entity e);
+
+#endif
@@ -0,0 +1,117 @@
+#include "hud.h"
+#include "sim.h"
+
+int boolean[10];
+
+void createnumber(int num){
+	for(int k=0;k<7;k++){
+		boolean[k]=0;
+	}
+	if(num==1){
+		boolean[0]=1;
+		boolean[1]=1;
+	}
+	if(num==2){
+		boolean[5]=1;
+		boolean[0]=1;
+		boolean[6]=1;
+		boolean[3]=1;
+		boolean[2]=1;
+
+	}
+	if(num==3){
+		boolean[5]=1;
+		boolean[0]=1;
+		boolean[6]=1;
+		boolean[1]=1;
+		boolean[2]=1;
+
+	}
+	if(num==4){
+		boolean[4]=1;
+		boolean[6]=1;
+		boolean[0]=1;
+		boolean[1]=1;
+	}
+	if(num==5){
+		boolean[5]=1;
+		boolean[4]=1;
+		boolean[6]=1;
+		boolean[1]=1;
+		boolean[2]=1;
+
+	}
+	if(num==6){
+		boolean[5]=1;
+		boolean[4]=1;
+		boolean[6]=1;
+		boolean[1]=1;
+		boolean[2]=1;
+		boolean[3]=1;
+	}
+	if(num==7){
+		boolean[5]=1;
+		boolean[0]=1;
+		boolean[1]=1;
+
+	}
+	if(num==8){
+		boolean[0]=1;
+		boolean[1]=1;
+		boolean[2]=1;
+		boolean[3]=1;
+		boolean[4]=1;
+		boolean[5]=1;
+		boolean[6]=1;
+
+	}
+	if(num==9){
+		boolean[4]=1;
+		boolean[5]=1;
+		boolean[6]=1;
+		boolean[0]=1;
+		boolean[1]=1;
+	}
+	if(num==0){
+		boolean[0]=1;
+		boolean[1]=1;
+		boolean[2]=1;
+		boolean[3]=1;
+		boolean[4]=1;
+		boolean[5]=1;
+	}
+}
+
+/* Light the segments of a two digit HUD display */
+void drawdigits(World &world, int display, int value){
+	int lit[2][7];
+	for(int place=0;place<2;place++){
+		createnumber(value%10);
+		for(int k=0;k<7;k++){
+			lit[place][k]=boolean[k];
+		}
+		value=value/10;
+	}
+	for(size_t a=0;a<world.archetypes.size();a++){
+		Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,COMP_SEGMENT|COMP_MESH))
+			continue;
+		for(size_t r=0;r<arch.entities.size();r++){
+			Segment &seg = arch.segments[r];
+			if(seg.display==display)
+				arch.meshes[r].visible=lit[seg.place][seg.segment];
+		}
+	}
+}
+
+void drawscore(World &world, int score){
+	drawdigits(world,DISPLAY_SCORE,score);
+}
+
+void drawenemyscore(World &world, int score){
+	drawdigits(world,DISPLAY_ENEMYSCORE,score);
+}
+
+void drawenemycountdown(World &world, int count){
+	drawdigits(world,DISPLAY_COUNTDOWN,count);
+}
@@ -0,0 +1,18 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include "ecs.h"
+
+/* Seven segment HUD. createnumber lights boolean[0..6] for one digit,
+   drawdigits shows a two digit value on the segment entities of one
+   DISPLAY_* by toggling their meshes. Neither touches GL. */
+
+extern int boolean[10];
+
+void createnumber(int num);
+void drawdigits(World &world, int display, int value);
+void drawscore(World &world, int score);
+void drawenemyscore(World &world, int score);
+void drawenemycountdown(World &world, int count);
+
+#endif
@@ -0,0 +1,34 @@
+#include <chrono>
+
+#include "input.h"
+
+double inputClock ()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+int pushInput (InputQueue &queue, int cannon, int type, int value)
+{
+	unsigned int tail = queue.tail.load(std::memory_order_relaxed);
+	if(tail-queue.head.load(std::memory_order_acquire)>=INPUT_QUEUE_SIZE)
+		return 0;
+	InputEvent &event = queue.events[tail&(INPUT_QUEUE_SIZE-1)];
+	event.time=inputClock();
+	event.cannon=cannon;
+	event.type=type;
+	event.value=value;
+	/* publish the slot only once it is written */
+	queue.tail.store(tail+1,std::memory_order_release);
+	return 1;
+}
+
+int popInput (InputQueue &queue, InputEvent &event)
+{
+	unsigned int head = queue.head.load(std::memory_order_relaxed);
+	if(head==queue.tail.load(std::memory_order_acquire))
+		return 0;
+	event=queue.events[head&(INPUT_QUEUE_SIZE-1)];
+	queue.head.store(head+1,std::memory_order_release);
+	return 1;
+}
@@ -0,0 +1,43 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <atomic>
+
+/* Timestamped input events.
+   The GLFW callbacks only stamp and queue what happened; the simulation
+   drains the queue at the start of its tick, in order. The queue is a
+   single producer, single consumer ring without locks, so the producer
+   may as well be a dedicated input thread. */
+
+enum {
+	INPUT_CHARGE,		/* value 1 press, 0 release */
+	INPUT_UP,
+	INPUT_DOWN,
+	INPUT_DIRUP,
+	INPUT_DIRDOWN,
+	INPUT_AUTOAIM		/* toggles the closed form aimer */
+};
+
+struct InputEvent{
+	double time;		/* inputClock() seconds */
+	int cannon;
+	int type;
+	int value;
+};
+
+#define INPUT_QUEUE_SIZE 256	/* power of two */
+
+struct InputQueue{
+	InputEvent events[INPUT_QUEUE_SIZE];
+	std::atomic<unsigned int> head;	/* next to read, owned by the consumer */
+	std::atomic<unsigned int> tail;	/* next to write, owned by the producer */
+	InputQueue() : head(0), tail(0) {}
+};
+
+/* Monotonic seconds with sub-microsecond resolution */
+double inputClock ();
+/* Returns 0 and drops the event if the consumer is INPUT_QUEUE_SIZE behind */
+int pushInput (InputQueue &queue, int cannon, int type, int value);
+int popInput (InputQueue &queue, InputEvent &event);
+
+#endif
@@ -0,0 +1,257 @@
+#include <chrono>
+#include <cstdio>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+#include "trace.h"
+
+#define JOB_RING_MIN 64
+#define PARKED_BLOCK 256
+
+/* A deque of jobs in a ring, grown by doubling */
+struct JobQueue{
+	std::mutex lock;
+	std::vector<Job> ring;
+	size_t head, count;
+	JobQueue() : head(0), count(0) {}
+};
+
+static std::vector<JobQueue*> queues;
+static std::vector<std::thread> workers;
+static std::atomic<int> queued(0);
+static std::atomic<bool> running(false);
+static std::mutex sleeplock;
+static std::condition_variable wakeup;
+static thread_local int threadindex = 0;
+static std::mutex parkedlock;
+static ParkedJob *parkedfree = NULL;
+static std::vector<ParkedJob*> parkedblocks;
+
+static void growQueue (JobQueue *q)
+{
+	std::vector<Job> ring(q->ring.size() ? 2*q->ring.size() : JOB_RING_MIN);
+	for(size_t k=0;k<q->count;k++)
+		ring[k]=q->ring[(q->head+k)%q->ring.size()];
+	q->ring.swap(ring);
+	q->head=0;
+}
+
+static void pushJob (const Job &job)
+{
+	JobQueue *q = queues[threadindex];
+	{
+		std::lock_guard<std::mutex> guard(q->lock);
+		if(q->count==q->ring.size())
+			growQueue(q);
+		q->ring[(q->head+q->count)%q->ring.size()]=job;
+		q->count++;
+	}
+	queued++;
+	wakeup.notify_one();
+}
+
+/* Own deque from the back, then steal from the front of the others */
+static bool popJob (Job &job)
+{
+	int n = (int)queues.size();
+	JobQueue *own = queues[threadindex];
+	{
+		std::lock_guard<std::mutex> guard(own->lock);
+		if(own->count){
+			own->count--;
+			job=own->ring[(own->head+own->count)%own->ring.size()];
+			queued--;
+			return true;
+		}
+	}
+	for(int k=1;k<n;k++){
+		JobQueue *victim = queues[(threadindex+k)%n];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if(victim->count){
+			job=victim->ring[victim->head];
+			victim->head=(victim->head+1)%victim->ring.size();
+			victim->count--;
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Parked nodes come from blocks that live until shutdownJobs */
+static ParkedJob *takeParked ()
+{
+	std::lock_guard<std::mutex> guard(parkedlock);
+	if(!parkedfree){
+		ParkedJob *block = new ParkedJob[PARKED_BLOCK];
+		for(int k=0;k<PARKED_BLOCK;k++)
+			block[k].next=k+1<PARKED_BLOCK ? &block[k+1] : NULL;
+		parkedblocks.push_back(block);
+		parkedfree=block;
+	}
+	ParkedJob *p = parkedfree;
+	parkedfree=p->next;
+	return p;
+}
+
+static void giveParked (ParkedJob *first, ParkedJob *last)
+{
+	std::lock_guard<std::mutex> guard(parkedlock);
+	last->next=parkedfree;
+	parkedfree=first;
+}
+
+/* Queue the job now, or park it on its dependency until that is done */
+static void scheduleJob (const Job &job, JobCounter *after)
+{
+	if(after){
+		std::lock_guard<std::mutex> guard(after->lock);
+		if(after->pending.load()>0){
+			ParkedJob *p = takeParked();
+			p->job=job;
+			p->next=after->waiting;
+			after->waiting=p;
+			return;
+		}
+	}
+	pushJob(job);
+}
+
+static void finishJob (JobCounter *counter)
+{
+	/* decrement under the lock so waitJobs cannot return, and the caller
+	   free the counter, while this thread still touches it */
+	ParkedJob *released;
+	{
+		std::lock_guard<std::mutex> guard(counter->lock);
+		if(counter->pending.fetch_sub(1)!=1)
+			return;
+		released=counter->waiting;
+		counter->waiting=NULL;
+	}
+	if(!released)
+		return;
+	ParkedJob *last = released;
+	for(ParkedJob *p=released;p;p=p->next){
+		pushJob(p->job);
+		last=p;
+	}
+	giveParked(released,last);
+}
+
+static void executeJob (const Job &job)
+{
+	{
+		TraceScope scope("job");
+		job.fn(job.data,job.begin,job.end);
+	}
+	finishJob(job.counter);
+}
+
+static void workerLoop (int index)
+{
+	threadindex=index;
+	char name[32];
+	snprintf(name,sizeof name,"worker %d",index);
+	traceThreadName(name);
+	Job job;
+	while(running.load()){
+		if(popJob(job)){
+			executeJob(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleeplock);
+		if(queued.load()==0 && running.load())
+			wakeup.wait_for(guard,std::chrono::milliseconds(1));
+	}
+}
+
+void initJobs (int count)
+{
+	if(running.load())
+		return;
+	if(count<0){
+		count=(int)std::thread::hardware_concurrency()-1;
+		if(count<0)
+			count=0;
+	}
+	threadindex=0;
+	for(int k=0;k<=count;k++)
+		queues.push_back(new JobQueue);
+	running=true;
+	for(int k=1;k<=count;k++)
+		workers.push_back(std::thread(workerLoop,k));
+}
+
+void shutdownJobs ()
+{
+	running=false;
+	wakeup.notify_all();
+	for(size_t k=0;k<workers.size();k++)
+		workers[k].join();
+	workers.clear();
+	for(size_t k=0;k<queues.size();k++)
+		delete queues[k];
+	queues.clear();
+	for(size_t k=0;k<parkedblocks.size();k++)
+		delete[] parkedblocks[k];
+	parkedblocks.clear();
+	parkedfree=NULL;
+}
+
+int jobWorkerCount ()
+{
+	return (int)workers.size();
+}
+
+int jobThreadIndex ()
+{
+	return threadindex;
+}
+
+void runJob (JobCounter *counter, JobCounter *after, JobFunction fn, void *data, int begin, int end)
+{
+	Job job;
+	job.fn=fn;
+	job.data=data;
+	job.begin=begin;
+	job.end=end;
+	job.counter=counter;
+	counter->pending++;
+	if(queues.empty()){
+		/* job system not started, behave like a plain call */
+		executeJob(job);
+		return;
+	}
+	scheduleJob(job,after);
+}
+
+void parallelFor (JobCounter *counter, JobCounter *after, int count, int grain, JobFunction fn, void *data)
+{
+	if(count<=0)
+		return;
+	if(grain<1)
+		grain=1;
+	if(count<=grain && (!after || after->pending.load()==0)){
+		fn(data,0,count);
+		return;
+	}
+	for(int begin=0;begin<count;begin+=grain){
+		int end = begin+grain<count ? begin+grain : count;
+		runJob(counter,after,fn,data,begin,end);
+	}
+}
+
+void waitJobs (JobCounter *counter)
+{
+	Job job;
+	while(counter->pending.load()>0){
+		if(!queues.empty() && popJob(job))
+			executeJob(job);
+		else
+			std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> guard(counter->lock);
+}
@@ -0,0 +1,54 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <mutex>
+
+/* Work-stealing job system.
+   Every thread owns a deque: it pushes and pops its own jobs at the back
+   while idle threads steal from the front of the others. The main thread
+   is thread 0 and only runs jobs while it waits on a counter, so anything
+   that must stay on it (GL calls) simply is not turned into a job.
+   The deques are rings that only grow, so once the biggest frame has
+   been queued scheduling no longer allocates. */
+
+typedef void (*JobFunction)(void *data, int begin, int end);
+
+struct Job{
+	JobFunction fn;
+	void *data;
+	int begin;
+	int end;
+	struct JobCounter *counter;
+};
+
+struct ParkedJob{
+	Job job;
+	ParkedJob *next;
+};
+
+/* Counts the unfinished jobs of a batch. Jobs queued "after" a counter
+   are held back until it drops to zero, parked in nodes the job system
+   recycles */
+struct JobCounter{
+	std::atomic<int> pending;
+	std::mutex lock;
+	ParkedJob *waiting;
+	JobCounter() : pending(0), waiting(NULL) {}
+};
+
+/* workers < 0 picks one per spare hardware thread */
+void initJobs (int workers=-1);
+void shutdownJobs ();
+int jobWorkerCount ();
+/* 0 on the main thread, 1..n on the workers */
+int jobThreadIndex ();
+
+void runJob (JobCounter *counter, JobCounter *after, JobFunction fn, void *data, int begin, int end);
+/* Split [0,count) into jobs of at most grain items. A batch that fits in
+   one grain and has nothing to wait for runs inline on the caller */
+void parallelFor (JobCounter *counter, JobCounter *after, int count, int grain, JobFunction fn, void *data);
+/* Runs queued jobs on the calling thread until the counter reaches zero */
+void waitJobs (JobCounter *counter);
+
+#endif
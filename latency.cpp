@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "latency.h"
+#include "rng.h"
+#include "trace.h"
+
+static void probeThread (LatencyProbe *probe)
+{
+	traceThreadName("latency probe");
+	Rng rng;
+	seedRng(rng,clockSeed());
+	while(probe->running.load()){
+		if(!probe->armed.load()){
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		probe->armed.store(0);
+		/* a random phase against the frame, like a real key */
+		std::this_thread::sleep_for(std::chrono::microseconds(100000+rngRange(rng,200000)));
+		pushInput(probe->queue,PLAYER,INPUT_CHARGE,1);
+		std::this_thread::sleep_for(std::chrono::duration<double>(PROBE_HOLD));
+		pushInput(probe->queue,PLAYER,INPUT_CHARGE,0);
+	}
+}
+
+void startLatencyProbe (LatencyProbe &probe, int wanted, int headless)
+{
+	probe.wanted=wanted;
+	probe.headless=headless;
+	probe.state=PROBE_IDLE;
+	if(!headless){
+		glGenQueries(1,&probe.query);
+		/* maps GPU timestamps onto inputClock() */
+		GLint64 gpu;
+		glGetInteger64v(GL_TIMESTAMP,&gpu);
+		probe.gpuoffset=inputClock()-gpu*1e-9;
+	}
+	probe.running.store(1);
+	probe.armed.store(1);
+	probe.thread=std::thread(probeThread,&probe);
+}
+
+void stopLatencyProbe (LatencyProbe &probe)
+{
+	if(!probe.running.load())
+		return;
+	probe.running.store(0);
+	probe.thread.join();
+	if(probe.fence)
+		glDeleteSync(probe.fence);
+	probe.fence=0;
+	if(!probe.headless)
+		glDeleteQueries(1,&probe.query);
+}
+
+void applyProbeInput (LatencyProbe &probe, Game &game)
+{
+	InputEvent event;
+	while(popInput(probe.queue,event)){
+		applyInput(game,event);
+		if(event.type!=INPUT_CHARGE || event.value)
+			continue;
+		probe.released=event.time;
+		probe.releasetick=game.ticks;
+		probe.state=PROBE_RELEASED;
+	}
+}
+
+static void sample (LatencyProbe &probe, double latency, double gpulatency)
+{
+	probe.latencies.push_back(latency*1000);
+	if(!probe.headless)
+		probe.gpulatencies.push_back(gpulatency*1000);
+	probe.state=PROBE_IDLE;
+	if(!probeDone(probe))
+		probe.armed.store(1);
+}
+
+static void drop (LatencyProbe &probe)
+{
+	probe.dropped++;
+	probe.state=PROBE_IDLE;
+	probe.armed.store(1);
+}
+
+/* Returns once the frame drawn so far is in the framebuffer */
+static void readPixel (int fbwidth, int fbheight)
+{
+	unsigned char rgb[3];
+	glPixelStorei(GL_PACK_ALIGNMENT,1);
+	glReadPixels(fbwidth/2,fbheight/2,1,1,GL_RGB,GL_UNSIGNED_BYTE,rgb);
+}
+
+static void pollFence (LatencyProbe &probe)
+{
+	if(probe.state!=PROBE_FENCED || !probe.fence)
+		return;
+	GLenum status = glClientWaitSync(probe.fence,GL_SYNC_FLUSH_COMMANDS_BIT,0);
+	if(status!=GL_ALREADY_SIGNALED && status!=GL_CONDITION_SATISFIED)
+		return;
+	double now = inputClock();
+	GLuint64 drawn;
+	glGetQueryObjectui64v(probe.query,GL_QUERY_RESULT,&drawn);
+	glDeleteSync(probe.fence);
+	probe.fence=0;
+	sample(probe,now-probe.released,drawn*1e-9+probe.gpuoffset-probe.released);
+}
+
+void probeAfterDraw (LatencyProbe &probe, const Game &game, int fbwidth, int fbheight)
+{
+	if(!probe.wanted)
+		return;
+	pollFence(probe);
+	if(probe.state!=PROBE_RELEASED)
+		return;
+	if(inputClock()-probe.released>PROBE_TIMEOUT){
+		drop(probe);
+		return;
+	}
+	/* the frame just drawn shows the release once it shows its tick,
+	   where the bullet flew since is the game's, not the latency */
+	if(game.ticks<probe.releasetick)
+		return;
+	if(probe.headless){
+		readPixel(fbwidth,fbheight);
+		sample(probe,inputClock()-probe.released,0);
+		return;
+	}
+	glQueryCounter(probe.query,GL_TIMESTAMP);
+	probe.state=PROBE_FENCED;
+}
+
+void probeAfterSwap (LatencyProbe &probe)
+{
+	if(probe.state!=PROBE_FENCED)
+		return;
+	if(!probe.fence)
+		probe.fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+	else
+		pollFence(probe);
+}
+
+int probeDone (const LatencyProbe &probe)
+{
+	return probe.wanted && (int)probe.latencies.size()>=probe.wanted;
+}
+
+static void printDistribution (const char *name, std::vector<double> ms)
+{
+	if(ms.empty())
+		return;
+	std::sort(ms.begin(),ms.end());
+	double sum = 0;
+	for(size_t k=0;k<ms.size();k++)
+		sum+=ms[k];
+	size_t last = ms.size()-1;
+	printf("%s : min %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f mean %.2f ms\n",name,
+		ms[0],ms[last/2],ms[(size_t)(last*.9+.5)],ms[(size_t)(last*.99+.5)],ms[last],sum/ms.size());
+}
+
+void reportLatency (const LatencyProbe &probe)
+{
+	if(!probe.wanted)
+		return;
+	printf("latency : %d samples, %d dropped, %s\n",(int)probe.latencies.size(),probe.dropped,
+		probe.headless ? "headless readback" : "windowed");
+	if(probe.headless)
+		printDistribution("input to readback",probe.latencies);
+	else{
+		printDistribution("input to draw done",probe.gpulatencies);
+		printDistribution("input to swap done",probe.latencies);
+	}
+}
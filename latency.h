@@ -0,0 +1,64 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "sim.h"
+#include "input.h"
+
+/* Input to photon latency probe.
+   A thread plays player 1: it holds SPACE for a moment at a random phase
+   of the frame and releases it, stamping both events like the keyboard
+   callback would. The sample ends with the first frame that draws the
+   tick which applied the release, so the bullet's flight is not counted.
+   Headless (hidden window) reads a pixel back from that frame, which
+   waits for its draw; windowed puts a GL_TIMESTAMP query after that draw
+   and a fence after its swap, and reports both once the fence has
+   signalled. */
+
+#define PROBE_HOLD .3		/* seconds SPACE is held */
+#define PROBE_TIMEOUT 1.0	/* seconds before a shot that never shows is dropped */
+
+enum {
+	PROBE_IDLE,		/* waiting for the thread to fire */
+	PROBE_RELEASED,		/* release applied, its tick not drawn yet */
+	PROBE_FENCED		/* windowed, query and fence issued, waiting for the GPU */
+};
+
+struct LatencyProbe{
+	int wanted;		/* samples, 0 if the probe is off */
+	int headless;
+	int state;
+	InputQueue queue;	/* fed by the probe thread only */
+	std::thread thread;
+	std::atomic<int> armed;	/* the thread may fire */
+	std::atomic<int> running;
+	double released;	/* inputClock() of the release event */
+	int releasetick;	/* the tick that applied it */
+	GLuint query;
+	GLsync fence;
+	double gpuoffset;	/* inputClock() minus GL_TIMESTAMP seconds */
+	/* milliseconds from release to the frame showing it */
+	std::vector<double> latencies;
+	std::vector<double> gpulatencies;	/* windowed, to the end of the draw */
+	int dropped;
+	LatencyProbe() : wanted(0), headless(0), state(PROBE_IDLE), armed(0), running(0), fence(0), dropped(0) {}
+};
+
+/* Needs the GL context, starts the probe thread */
+void startLatencyProbe (LatencyProbe &probe, int wanted, int headless);
+void stopLatencyProbe (LatencyProbe &probe);
+/* Applies the probe thread's events, call with the other input */
+void applyProbeInput (LatencyProbe &probe, Game &game);
+/* Call after draw(), before the swap, with the framebuffer size; then
+   again after the swap */
+void probeAfterDraw (LatencyProbe &probe, const Game &game, int fbwidth, int fbheight);
+void probeAfterSwap (LatencyProbe &probe);
+int probeDone (const LatencyProbe &probe);
+void reportLatency (const LatencyProbe &probe);
+
+#endif
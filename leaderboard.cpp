@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "scores.h"
+#include "profile.h"
+#include "rng.h"
+
+/* Queries and maintenance of a high score log.
+
+   leaderboard <file> top [n]            best n records (10)
+   leaderboard <file> player <name> [n]  best n records of one name
+   leaderboard <file> rank <score>       place a score would take
+   leaderboard <file> compact [keep]     keeps the best keep of every name (100)
+   leaderboard <file> index              rewrites the index of the whole log
+   leaderboard <file> fill <n> [names]   appends n made up records over names
+                                         players (1000), for trying it at scale
+
+   Every query prints how long it took. */
+
+static void printRecords (const std::vector<ScoreRecord> &records)
+{
+	for(size_t k=0;k<records.size();k++){
+		const ScoreRecord &r = records[k];
+		char when[32];
+		time_t t = r.time;
+		strftime(when,sizeof when,"%Y-%m-%d %H:%M",localtime(&t));
+		printf("%4d %6d  %-*.*s  %d-%d  player %d  %s  seed %llu\n",(int)k+1,r.score,SCORES_NAME,SCORES_NAME,r.name,
+			r.score,r.opponent,r.side+1,when,(unsigned long long)r.seed);
+	}
+}
+
+static void fill (ScoreStore &store, long n, int names)
+{
+	Rng rng = rngStream(clockSeed(),0);
+	std::vector<ScoreRecord> batch(4096);
+	char name[SCORES_NAME];
+	for(long done=0;done<n;){
+		size_t count = n-done<(long)batch.size() ? n-done : batch.size();
+		for(size_t k=0;k<count;k++){
+			snprintf(name,sizeof name,"sim %u",rngRange(rng,names));
+			fillScoreRecord(batch[k],name,rngRange(rng,200),rngRange(rng,200));
+			batch[k].seed=nextRng(rng);
+			batch[k].side=rngRange(rng,2);
+			batch[k].ticks=3600;
+		}
+		if(!appendScores(store,&batch[0],count))
+			return;
+		done+=count;
+	}
+}
+
+int main (int argc, char** argv)
+{
+	if(argc<3){
+		fprintf(stderr,"usage: leaderboard <file> top|player|rank|compact|index|fill ...\n");
+		return 1;
+	}
+	const char *command = argv[2];
+	ScoreStore store;
+	uint64_t start = profileClock();
+	if(!openScores(store,argv[1]))
+		return 1;
+	printf("%s : %u records, %u damaged, %u indexed, opened in %.3f ms\n",argv[1],scoreCount(store),store.damaged,
+		store.indexed,(profileClock()-start)*1e-6);
+
+	std::vector<ScoreRecord> records;
+	start = profileClock();
+	if(strcmp(command,"top")==0){
+		topScores(store,argc>3 ? atoi(argv[3]) : 10,records);
+		double us = (profileClock()-start)*1e-3;
+		printRecords(records);
+		printf("top %d in %.1f us\n",(int)records.size(),us);
+	}
+	else if(strcmp(command,"player")==0 && argc>3){
+		playerScores(store,argv[3],argc>4 ? atoi(argv[4]) : 10,records);
+		double us = (profileClock()-start)*1e-3;
+		printRecords(records);
+		printf("%d of %s in %.1f us\n",(int)records.size(),argv[3],us);
+	}
+	else if(strcmp(command,"rank")==0 && argc>3){
+		uint32_t rank = scoreRank(store,atoi(argv[3]));
+		printf("%s would be number %u of %u, in %.1f us\n",argv[3],rank,scoreCount(store)+1,(profileClock()-start)*1e-3);
+	}
+	else if(strcmp(command,"compact")==0){
+		uint32_t before = store.records;
+		if(!compactScores(store,argc>3 ? atoi(argv[3]) : SCORES_KEEP))
+			return 1;
+		printf("compacted %u records to %u in %.0f ms\n",before,store.records,(profileClock()-start)*1e-6);
+	}
+	else if(strcmp(command,"index")==0){
+		if(!indexScores(store))
+			return 1;
+		printf("indexed %u records in %.0f ms\n",store.indexed,(profileClock()-start)*1e-6);
+	}
+	else if(strcmp(command,"fill")==0 && argc>3){
+		long n = atol(argv[3]);
+		fill(store,n,argc>4 ? atoi(argv[4]) : 1000);
+		printf("appended %ld records in %.0f ms\n",n,(profileClock()-start)*1e-6);
+		/* leave an index behind, the next open would make one anyway */
+		start = profileClock();
+		if(!indexScores(store))
+			return 1;
+		printf("indexed %u records in %.0f ms\n",store.indexed,(profileClock()-start)*1e-6);
+	}
+	else{
+		fprintf(stderr,"leaderboard : unknown command %s\n",command);
+		return 1;
+	}
+	closeScores(store);
+	return 0;
+}
@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "level.h"
+#include "sim.h"
+
+/* A section must lie inside the file */
+static int sectionFits (const LevelHeader *h, uint32_t offset, uint32_t count, size_t record)
+{
+	return offset<=h->size && count<=(h->size-offset)/record;
+}
+
+/* The game indexes with these fields, a record that is out of range
+   rejects the file. Returns what is wrong or NULL */
+static const char *badRecord (const LevelHeader *h, const char *base)
+{
+	const LevelStage *stages = (const LevelStage*)(base+h->stages);
+	const LevelProp *props = (const LevelProp*)(base+h->props);
+	const LevelTarget *targets = (const LevelTarget*)(base+h->targets);
+	for(uint32_t k=0;k<h->nstages;k++){
+		if(stages[k].seconds<1)
+			return "a stage lasts less than a second";
+		int d = stages[k].spawn.distribution;
+		if(d!=SPAWN_UNIFORM_INT && d!=SPAWN_UNIFORM && d!=SPAWN_NORMAL)
+			return "a stage has an unknown spawn distribution";
+	}
+	for(uint32_t k=0;k<h->nprops;k++){
+		const LevelProp &p = props[k];
+		if(p.stage<0 || (uint32_t)p.stage>=h->nstages)
+			return "a prop belongs to no stage";
+		if(p.layer<-1 || p.layer>LAYER_HUD)
+			return "a prop has an unknown layer";
+		if(p.kind!=SHAPE_RECTANGLE && p.kind!=SHAPE_CIRCLE)
+			return "a prop is neither a rectangle nor a circle";
+	}
+	for(uint32_t k=0;k<h->ntargets;k++)
+		if(targets[k].kind<SHAPE_RECTANGLE || targets[k].kind>SHAPE_SQUARE)
+			return "a target has an unknown shape";
+	return NULL;
+}
+
+int loadLevel (Level &level, const char *path)
+{
+	level.map=NULL;
+	level.size=0;
+	int fd = open(path,O_RDONLY);
+	if(fd<0){
+		fprintf(stderr,"Level : cannot open %s\n",path);
+		return 0;
+	}
+	struct stat st;
+	if(fstat(fd,&st)<0 || (size_t)st.st_size<sizeof(LevelHeader)){
+		fprintf(stderr,"Level : %s is too short\n",path);
+		close(fd);
+		return 0;
+	}
+	void *map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(map==MAP_FAILED){
+		fprintf(stderr,"Level : cannot map %s\n",path);
+		return 0;
+	}
+	const char *base = (const char*)map;
+	const LevelHeader *h = (const LevelHeader*)base;
+	if(h->magic!=LEVEL_MAGIC || h->version!=LEVEL_VERSION || h->size!=(uint32_t)st.st_size
+		|| h->nstages<1 || h->nstages>MAX_LEVEL_STAGES || h->ntargets<1 || h->ntargets>MAX_TARGET_CLASSES
+		|| !sectionFits(h,h->stages,h->nstages,sizeof(LevelStage))
+		|| !sectionFits(h,h->props,h->nprops,sizeof(LevelProp))
+		|| !sectionFits(h,h->targets,h->ntargets,sizeof(LevelTarget))){
+		fprintf(stderr,"Level : %s is not a version %d level, rebuild it with levelc\n",path,LEVEL_VERSION);
+		munmap(map,st.st_size);
+		return 0;
+	}
+	const char *bad = badRecord(h,base);
+	if(bad){
+		fprintf(stderr,"Level : %s is damaged, %s\n",path,bad);
+		munmap(map,st.st_size);
+		return 0;
+	}
+	level.header=h;
+	level.stages=(const LevelStage*)(base+h->stages);
+	level.props=(const LevelProp*)(base+h->props);
+	level.targets=(const LevelTarget*)(base+h->targets);
+	level.map=map;
+	level.size=st.st_size;
+	return 1;
+}
+
+void unloadLevel (Level &level)
+{
+	if(level.map)
+		munmap(level.map,level.size);
+	level.map=NULL;
+	level.size=0;
+}
+
+uint32_t levelHash (const Level &level)
+{
+	const unsigned char *p = (const unsigned char*)level.map;
+	uint32_t hash = 2166136261u;
+	for(size_t k=0;k<level.size;k++){
+		hash^=p[k];
+		hash*=16777619u;
+	}
+	return hash;
+}
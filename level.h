@@ -0,0 +1,73 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ecs.h"
+#include "spawner.h"
+
+/* Binary level file.
+   levelc compiles the text form (levels.txt) into this layout. The game
+   maps the file read only and uses the records in place: every section
+   is an array of the fixed size records below at an offset from the
+   start of the file, so loading is an mmap and a header check. Bump
+   LEVEL_VERSION whenever a record or the LAYER_* order changes. */
+
+#define LEVEL_MAGIC 0x4c564c41u	/* "ALVL" */
+#define LEVEL_VERSION 1
+#define MAX_LEVEL_STAGES MAX_SPAWN_LEVELS
+
+/* One screen of the match, played for seconds before the camera moves on */
+struct LevelStage{
+	float originx;		/* world x of the screen centre */
+	int32_t seconds;
+	SpawnRule spawn;	/* x range relative to originx */
+};
+
+/* Scenery. Obstacles are only solid while their stage is played */
+struct LevelProp{
+	int32_t stage;
+	int32_t kind;		/* SHAPE_RECTANGLE or SHAPE_CIRCLE */
+	int32_t layer;
+	int32_t obstacle;
+	float x, y;		/* relative to the stage origin */
+	float length, breadth;
+	float radius;
+	float c1, c2, c3;
+};
+
+/* Target palette, spawned targets cycle through it */
+struct LevelTarget{
+	int32_t kind;
+	float radius;
+	float c1, c2, c3;
+	int32_t points;
+};
+
+struct LevelHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		/* of the whole file */
+	uint32_t nstages, stages;	/* count, offset */
+	uint32_t nprops, props;
+	uint32_t ntargets, targets;
+};
+
+/* A mapped level file */
+struct Level{
+	const LevelHeader *header;
+	const LevelStage *stages;
+	const LevelProp *props;
+	const LevelTarget *targets;
+	void *map;
+	size_t size;
+};
+
+/* Returns 0 and prints why if the file is missing or not a valid level */
+int loadLevel (Level &level, const char *path);
+void unloadLevel (Level &level);
+/* FNV-1a of the file, ties baked data to the level it was made from */
+uint32_t levelHash (const Level &level);
+
+#endif
@@ -0,0 +1,189 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "level.h"
+#include "sim.h"
+
+/* Level compiler: levelc levels.txt levels.bin
+   One record per line, # starts a comment. Props, walls and spawn lines
+   belong to the last stage line above them.
+
+     stage <seconds> <originx>
+     spawn <initial> <maxactive> <rate> <uniform_int|uniform|normal> <a> <b> <y>
+     rect <layer> <x> <y> <length> <breadth> <r> <g> <b>
+     circle <layer> <x> <y> <radius> <r> <g> <b>
+     wall <x> <y> <length> <breadth> <r> <g> <b>
+     target <rhombus|triangle|circle|square|semicircle> <radius> <r> <g> <b> <points>
+*/
+
+struct Name{
+	const char *name;
+	int value;
+};
+
+static const Name layers[] = {
+	{"land",LAYER_LAND}, {"sky",LAYER_SKY}, {"sea",LAYER_SEA},
+	{"treebase",LAYER_TREEBASE}, {"tree",LAYER_TREE}, {"obstacle",LAYER_OBSTACLE},
+	{NULL,0}
+};
+
+static const Name shapes[] = {
+	{"rhombus",SHAPE_RHOMBUS}, {"triangle",SHAPE_TRIANGLE}, {"circle",SHAPE_CIRCLE},
+	{"square",SHAPE_SQUARE}, {"semicircle",SHAPE_SEMICIRCLE},
+	{NULL,0}
+};
+
+static const Name distributions[] = {
+	{"uniform_int",SPAWN_UNIFORM_INT}, {"uniform",SPAWN_UNIFORM}, {"normal",SPAWN_NORMAL},
+	{NULL,0}
+};
+
+static const char *source;
+static int line;
+
+static void fail (const char *message)
+{
+	fprintf(stderr,"%s:%d: %s\n",source,line,message);
+	exit(EXIT_FAILURE);
+}
+
+static int lookup (const Name *names, const char *name, const char *what)
+{
+	for(int k=0;names[k].name;k++){
+		if(strcmp(names[k].name,name)==0)
+			return names[k].value;
+	}
+	fprintf(stderr,"%s:%d: unknown %s '%s'\n",source,line,what,name);
+	exit(EXIT_FAILURE);
+}
+
+static uint32_t align8 (uint32_t n)
+{
+	return (n+7)&~7u;
+}
+
+int main (int argc, char **argv)
+{
+	if(argc!=3){
+		fprintf(stderr,"usage: levelc levels.txt levels.bin\n");
+		return EXIT_FAILURE;
+	}
+	source=argv[1];
+	FILE *in = fopen(argv[1],"r");
+	if(!in){
+		fprintf(stderr,"levelc : cannot open %s\n",argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<LevelStage> stages;
+	std::vector<LevelProp> props;
+	std::vector<LevelTarget> targets;
+	char text[512], word[64], name[64];
+	while(fgets(text,sizeof text,in)){
+		line++;
+		char *comment = strchr(text,'#');
+		if(comment)
+			*comment=0;
+		if(sscanf(text,"%63s",word)!=1)
+			continue;
+		char *args = strstr(text,word)+strlen(word);
+
+		if(strcmp(word,"stage")==0){
+			LevelStage s;
+			memset(&s,0,sizeof s);
+			if(sscanf(args,"%d %f",&s.seconds,&s.originx)!=2)
+				fail("expected: stage <seconds> <originx>");
+			if(s.seconds<1)
+				fail("a stage lasts at least one second");
+			s.spawn.maxactive=50;
+			s.spawn.distribution=SPAWN_UNIFORM_INT;
+			s.spawn.y=-4;
+			stages.push_back(s);
+			if(stages.size()>MAX_LEVEL_STAGES)
+				fail("too many stages");
+			continue;
+		}
+		if(strcmp(word,"target")==0){
+			LevelTarget t;
+			if(sscanf(args,"%63s %f %f %f %f %d",name,&t.radius,&t.c1,&t.c2,&t.c3,&t.points)!=6)
+				fail("expected: target <shape> <radius> <r> <g> <b> <points>");
+			t.kind=lookup(shapes,name,"shape");
+			targets.push_back(t);
+			if(targets.size()>MAX_TARGET_CLASSES)
+				fail("too many targets");
+			continue;
+		}
+		if(stages.empty())
+			fail("expected a stage line first");
+		int stage = (int)stages.size()-1;
+
+		if(strcmp(word,"spawn")==0){
+			SpawnRule &r = stages.back().spawn;
+			if(sscanf(args,"%d %d %f %63s %f %f %f",&r.initial,&r.maxactive,&r.rate,name,&r.a,&r.b,&r.y)!=7)
+				fail("expected: spawn <initial> <maxactive> <rate> <distribution> <a> <b> <y>");
+			r.distribution=lookup(distributions,name,"distribution");
+			continue;
+		}
+
+		LevelProp p;
+		memset(&p,0,sizeof p);
+		p.stage=stage;
+		if(strcmp(word,"rect")==0){
+			p.kind=SHAPE_RECTANGLE;
+			if(sscanf(args,"%63s %f %f %f %f %f %f %f",name,&p.x,&p.y,&p.length,&p.breadth,&p.c1,&p.c2,&p.c3)!=8)
+				fail("expected: rect <layer> <x> <y> <length> <breadth> <r> <g> <b>");
+			p.layer=lookup(layers,name,"layer");
+		}
+		else if(strcmp(word,"circle")==0){
+			p.kind=SHAPE_CIRCLE;
+			if(sscanf(args,"%63s %f %f %f %f %f %f",name,&p.x,&p.y,&p.radius,&p.c1,&p.c2,&p.c3)!=7)
+				fail("expected: circle <layer> <x> <y> <radius> <r> <g> <b>");
+			p.layer=lookup(layers,name,"layer");
+		}
+		else if(strcmp(word,"wall")==0){
+			p.kind=SHAPE_RECTANGLE;
+			p.layer=LAYER_OBSTACLE;
+			p.obstacle=1;
+			if(sscanf(args,"%f %f %f %f %f %f %f",&p.x,&p.y,&p.length,&p.breadth,&p.c1,&p.c2,&p.c3)!=7)
+				fail("expected: wall <x> <y> <length> <breadth> <r> <g> <b>");
+		}
+		else
+			fail("unknown record");
+		props.push_back(p);
+	}
+	fclose(in);
+	if(stages.empty())
+		fail("no stage");
+	if(targets.empty())
+		fail("no target");
+
+	LevelHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=LEVEL_MAGIC;
+	h.version=LEVEL_VERSION;
+	h.nstages=stages.size();
+	h.stages=align8(sizeof h);
+	h.nprops=props.size();
+	h.props=align8(h.stages+h.nstages*sizeof(LevelStage));
+	h.ntargets=targets.size();
+	h.targets=align8(h.props+h.nprops*sizeof(LevelProp));
+	h.size=h.targets+h.ntargets*sizeof(LevelTarget);
+
+	std::vector<char> blob(h.size,0);
+	memcpy(&blob[0],&h,sizeof h);
+	memcpy(&blob[h.stages],&stages[0],h.nstages*sizeof(LevelStage));
+	if(h.nprops)
+		memcpy(&blob[h.props],&props[0],h.nprops*sizeof(LevelProp));
+	memcpy(&blob[h.targets],&targets[0],h.ntargets*sizeof(LevelTarget));
+
+	FILE *out = fopen(argv[2],"wb");
+	if(!out || fwrite(&blob[0],1,blob.size(),out)!=blob.size()){
+		fprintf(stderr,"levelc : cannot write %s\n",argv[2]);
+		return EXIT_FAILURE;
+	}
+	fclose(out);
+	printf("%s : %d stages, %d props, %d targets, %d bytes\n",argv[2],h.nstages,h.nprops,h.ntargets,h.size);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mesh.h"
+#include "sim.h"
+
+static int beginMesh (MeshSet &set)
+{
+	MeshRange range;
+	range.first=set.vertices.size();
+	range.count=0;
+	set.meshes.push_back(range);
+	return (int)set.meshes.size()-1;
+}
+
+static void vertex (MeshSet &set, float x, float y, float r, float g, float b)
+{
+	MeshVertex v;
+	v.x=x;
+	v.y=y;
+	v.z=0;
+	v.r=r;
+	v.g=g;
+	v.b=b;
+	set.vertices.push_back(v);
+	set.meshes.back().count++;
+}
+
+/* Cannon barrel */
+int createRectangle (MeshSet &set)
+{
+	int mesh = beginMesh(set);
+	vertex(set,-1.2,-.3,1,0,0);
+	vertex(set,1.2,-.3,0,0,1);
+	vertex(set,1.2,.3,0,1,0);
+
+	vertex(set,1.2,.3,0,1,0);
+	vertex(set,-1.2,.3,0.3,0.3,0.3);
+	vertex(set,-1.2,-.3,1,0,0);
+	return mesh;
+}
+
+/* 36 slice disc of one colour */
+static int createDisc (MeshSet &set, float radius, float c)
+{
+	int mesh = beginMesh(set);
+	for(int i=0;i<36;i++){
+		float theta = (2.0f*3.14f*float(i))/float(36);
+		float next = (2.0f*3.14f*float(i+1))/float(36);
+		vertex(set,0,0,c,c,c);
+		vertex(set,radius*cosf(theta),radius*sinf(theta),c,c,c);
+		vertex(set,radius*cosf(next),radius*sinf(next),c,c,c);
+	}
+	return mesh;
+}
+
+int createCanonBase (MeshSet &set)
+{
+	return createDisc(set,.5,0);
+}
+
+/* Bullet */
+int createCircle (MeshSet &set, float radius)
+{
+	return createDisc(set,radius,1);
+}
+
+int createRectangles (MeshSet &set, float x, float y, float length, float breadth, float c1, float c2, float c3)
+{
+	int mesh = beginMesh(set);
+	vertex(set,x-(length/2),y-(breadth/2),c1,c2,c3);
+	vertex(set,x+(length/2),y-(breadth/2),c1,c2,c3);
+	vertex(set,x+(length/2),y+(breadth/2),c1,c2,c3);
+
+	vertex(set,x+(length/2),y+(breadth/2),c1,c2,c3);
+	vertex(set,x-(length/2),y+(breadth/2),c1,c2,c3);
+	vertex(set,x-(length/2),y-(breadth/2),c1,c2,c3);
+	return mesh;
+}
+
+int createTriangles (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3)
+{
+	int mesh = beginMesh(set);
+	vertex(set,x,y+radius,c1,c2,c3);
+	vertex(set,x-(1.732*radius/2),y-(radius/2),c1,c2,c3);
+	vertex(set,x+(1.732*radius/2),y-(radius/2),c1,c2,c3);
+	vertex(set,x,y-radius,c1,c2,c3);
+	vertex(set,x-(1.732*radius/2),y+(radius/2),c1,c2,c3);
+	vertex(set,x+(1.732*radius/2),y+(radius/2),c1,c2,c3);
+	return mesh;
+}
+
+int createRhombus (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3)
+{
+	int mesh = beginMesh(set);
+	vertex(set,x,y+radius+radius/4,c1,c2,c3);
+	vertex(set,x-(1.732*radius/2),0,c1,c2,c3);
+	vertex(set,x+(1.732*radius/2),0,c1,c2,c3);
+	vertex(set,x,y-radius-radius/4,c1,c2,c3);
+	vertex(set,x-(1.732*radius/2),0,c1,c2,c3);
+	vertex(set,x+(1.732*radius/2),0,c1,c2,c3);
+	return mesh;
+}
+
+int createSquare (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3)
+{
+	int mesh = beginMesh(set);
+	vertex(set,x+(radius/1.414),y+(radius/1.414),c1,c2,c3);
+	vertex(set,x-(radius/1.414),y+(radius/1.414),c1,c2,c3);
+	vertex(set,x+(radius/1.414),y-(radius/1.414),c1,c2,c3);
+	vertex(set,x+(radius/1.414),y-(radius/1.414),c1,c2,c3);
+	vertex(set,x-(radius/1.414),y-(radius/1.414),c1,c2,c3);
+	vertex(set,x-(radius/1.414),y+(radius/1.414),c1,c2,c3);
+	return mesh;
+}
+
+/* Slices from..to of a 36 slice disc, the rim is shaded darker */
+static int createSlices (MeshSet &set, int from, int to, float x, float y, float radius, float c1, float c2, float c3)
+{
+	int mesh = beginMesh(set);
+	for(int i=from;i<to;i++){
+		float theta = (2.0f*3.14f*float(i))/float(36);
+		float next = (2.0f*3.14f*float(i+1))/float(36);
+		vertex(set,x,y,c1,c2,c3);
+		vertex(set,x+(radius*cosf(theta)),y+(radius*sinf(theta)),c1-.3,c2,c3);
+		vertex(set,x+radius*cosf(next),y+radius*sinf(next),c1-.3,c2,c3);
+	}
+	return mesh;
+}
+
+int createCircles (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3)
+{
+	return createSlices(set,0,36,x,y,radius,c1,c2,c3);
+}
+
+int createSemiCircles (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3)
+{
+	return createSlices(set,18,36,x,y,radius,c1,c2,c3);
+}
+
+void buildGameMeshes (MeshSet &set, const Level &level)
+{
+	set.vertices.clear();
+	set.meshes.clear();
+	for(int c=0;c<2;c++)
+		createRectangle(set);
+	for(int c=0;c<2;c++)
+		createCanonBase(set);
+	for(int c=0;c<2;c++)
+		createCircle(set,.2);
+	createRectangles(set,0,0,.05,.2,1,1,1);
+	createRectangles(set,0,0,.2,.02,1,1,1);
+
+	const LevelHeader *h = level.header;
+	for(uint32_t k=0;k<h->nprops;k++){
+		const LevelProp &p = level.props[k];
+		if(p.kind==SHAPE_CIRCLE)
+			createCircles(set,0,0,p.radius,p.c1,p.c2,p.c3);
+		else
+			createRectangles(set,0,0,p.length,p.breadth,p.c1,p.c2,p.c3);
+	}
+	for(uint32_t k=0;k<h->ntargets;k++){
+		const LevelTarget &t = level.targets[k];
+		switch(t.kind){
+			case SHAPE_RHOMBUS:
+				createRhombus(set,0,0,t.radius,t.c1,t.c2,t.c3);
+				break;
+			case SHAPE_TRIANGLE:
+				createTriangles(set,0,0,t.radius,t.c1,t.c2,t.c3);
+				break;
+			case SHAPE_SQUARE:
+				createSquare(set,0,0,t.radius,t.c1,t.c2,t.c3);
+				break;
+			case SHAPE_SEMICIRCLE:
+				createSemiCircles(set,0,0,t.radius,t.c1,t.c2,t.c3);
+				break;
+			default:
+				createCircles(set,0,0,t.radius,t.c1,t.c2,t.c3);
+				break;
+		}
+	}
+}
+
+static uint32_t align8 (uint32_t n)
+{
+	return (n+7)&~7u;
+}
+
+int writeMeshBlob (const MeshSet &set, uint32_t levelhash, const char *path)
+{
+	MeshBlobHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=MESH_MAGIC;
+	h.version=MESH_VERSION;
+	h.levelhash=levelhash;
+	h.nmeshes=set.meshes.size();
+	h.meshes=align8(sizeof h);
+	h.nvertices=set.vertices.size();
+	h.vertices=align8(h.meshes+h.nmeshes*sizeof(MeshRange));
+	h.size=h.vertices+h.nvertices*sizeof(MeshVertex);
+
+	std::vector<char> blob(h.size,0);
+	memcpy(&blob[0],&h,sizeof h);
+	if(h.nmeshes)
+		memcpy(&blob[h.meshes],&set.meshes[0],h.nmeshes*sizeof(MeshRange));
+	if(h.nvertices)
+		memcpy(&blob[h.vertices],&set.vertices[0],h.nvertices*sizeof(MeshVertex));
+
+	FILE *out = fopen(path,"wb");
+	if(!out)
+		return 0;
+	int ok = fwrite(&blob[0],1,blob.size(),out)==blob.size();
+	fclose(out);
+	return ok;
+}
+
+int loadMeshBlob (MeshBlob &blob, const char *path, uint32_t levelhash)
+{
+	blob.map=NULL;
+	blob.size=0;
+	int fd = open(path,O_RDONLY);
+	if(fd<0)
+		return 0;
+	struct stat st;
+	if(fstat(fd,&st)<0 || (size_t)st.st_size<sizeof(MeshBlobHeader)){
+		close(fd);
+		return 0;
+	}
+	void *map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(map==MAP_FAILED)
+		return 0;
+	const char *base = (const char*)map;
+	const MeshBlobHeader *h = (const MeshBlobHeader*)base;
+	if(h->magic!=MESH_MAGIC || h->version!=MESH_VERSION || h->size!=(uint32_t)st.st_size
+		|| h->levelhash!=levelhash
+		|| h->meshes>h->size || h->nmeshes>(h->size-h->meshes)/sizeof(MeshRange)
+		|| h->vertices>h->size || h->nvertices>(h->size-h->vertices)/sizeof(MeshVertex)){
+		munmap(map,st.st_size);
+		return 0;
+	}
+	const MeshRange *meshes = (const MeshRange*)(base+h->meshes);
+	for(uint32_t k=0;k<h->nmeshes;k++){
+		if(meshes[k].first>h->nvertices || meshes[k].count>h->nvertices-meshes[k].first){
+			munmap(map,st.st_size);
+			return 0;
+		}
+	}
+	blob.header=h;
+	blob.meshes=meshes;
+	blob.vertices=(const MeshVertex*)(base+h->vertices);
+	blob.map=map;
+	blob.size=st.st_size;
+	return 1;
+}
+
+void unloadMeshBlob (MeshBlob &blob)
+{
+	if(blob.map)
+		munmap(blob.map,blob.size);
+	blob.map=NULL;
+	blob.size=0;
+}
@@ -0,0 +1,81 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "level.h"
+
+/* CPU side meshes.
+   Every mesh is a triangle list in one shared array of interleaved
+   position/colour vertices and is addressed by its first vertex, so the
+   whole set goes to the GPU as a single buffer. bake writes a MeshSet to
+   assets.bin at build time; the game maps that file and uploads it as is. */
+
+struct MeshVertex{
+	float x, y, z;
+	float r, g, b;
+};
+
+struct MeshRange{
+	uint32_t first;
+	uint32_t count;
+};
+
+struct MeshSet{
+	std::vector<MeshVertex> vertices;
+	std::vector<MeshRange> meshes;
+};
+
+/* The builders of the original initGL, each appends one mesh and returns its index */
+int createRectangle (MeshSet &set);
+int createCanonBase (MeshSet &set);
+int createCircle (MeshSet &set, float radius);
+int createRectangles (MeshSet &set, float x, float y, float length, float breadth, float c1, float c2, float c3);
+int createTriangles (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3);
+int createRhombus (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3);
+int createSquare (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3);
+int createCircles (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3);
+int createSemiCircles (MeshSet &set, float x, float y, float radius, float c1, float c2, float c3);
+
+/* Mesh order of a match, the level's props and targets follow MESH_PROPS */
+enum {
+	MESH_CANONRECT,		/* per cannon */
+	MESH_CANONBASE = 2,
+	MESH_BULLET = 4,
+	MESH_SEGMENTVERTICAL = 6,
+	MESH_SEGMENTHORIZONTAL,
+	MESH_PROPS
+};
+
+/* Every mesh of a match on the given level */
+void buildGameMeshes (MeshSet &set, const Level &level);
+
+/* Baked mesh blob, sections at offsets from the start of the file */
+#define MESH_MAGIC 0x48534d41u	/* "AMSH" */
+#define MESH_VERSION 1
+
+struct MeshBlobHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t levelhash;	/* levelHash() of the level it was baked for */
+	uint32_t nmeshes, meshes;
+	uint32_t nvertices, vertices;
+};
+
+struct MeshBlob{
+	const MeshBlobHeader *header;
+	const MeshRange *meshes;
+	const MeshVertex *vertices;
+	void *map;
+	size_t size;
+};
+
+int writeMeshBlob (const MeshSet &set, uint32_t levelhash, const char *path);
+/* Returns 0 if the blob is missing, stale or baked for another level */
+int loadMeshBlob (MeshBlob &blob, const char *path, uint32_t levelhash);
+void unloadMeshBlob (MeshBlob &blob);
+
+#endif
@@ -0,0 +1,394 @@
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+#include "net.h"
+#include "input.h"
+#include "profile.h"
+#include "telemetry.h"
+
+struct NetHeader{
+	uint32_t magic;
+	uint8_t side;
+	uint8_t count;		/* inputs after the header */
+	uint16_t reserved;
+	uint64_t seed;
+	int32_t ack;		/* sender has every input of ours up to here */
+	int32_t first;		/* tick of the first input */
+};
+
+#define NET_PACKET (sizeof(NetHeader)+NET_MAX_SEND*sizeof(NetInput))
+
+static int slot (int tick)
+{
+	return tick&(NET_RING-1);
+}
+
+int netAddress (sockaddr_in &addr, const char *hostport)
+{
+	char host[64];
+	const char *colon = strrchr(hostport,':');
+	if(!colon || colon-hostport>=(int)sizeof host){
+		fprintf(stderr,"Net : %s is not host:port\n",hostport);
+		return 0;
+	}
+	memcpy(host,hostport,colon-hostport);
+	host[colon-hostport]=0;
+	memset(&addr,0,sizeof addr);
+	addr.sin_family=AF_INET;
+	addr.sin_port=htons(atoi(colon+1));
+	if(inet_pton(AF_INET,host,&addr.sin_addr)!=1){
+		fprintf(stderr,"Net : %s is not an IPv4 address\n",host);
+		return 0;
+	}
+	return 1;
+}
+
+int openNet (NetSession &net, int side, int port, const char *peer, uint64_t seed)
+{
+	net.active=0;
+	net.side=side;
+	net.heard=0;
+	net.peerack=-1;
+	net.seed=seed;
+	net.tick=0;
+	net.confirmed=-1;
+	net.telemetry=NULL;
+	net.rollbackfrom=-1;
+	memset(&net.held,0,sizeof net.held);
+	clearSnapshotRing(net.snapshots);
+	memset(net.inputticks,0xff,sizeof net.inputticks);
+	net.delay=0;
+	net.jitter=0;
+	net.loss=0;
+	net.shimrng=rngStream(clockSeed(),0);
+	net.outgoing.clear();
+	memset(&net.stats,0,sizeof net.stats);
+
+	if(!netAddress(net.peer,peer))
+		return 0;
+
+	net.sock=socket(AF_INET,SOCK_DGRAM,0);
+	if(net.sock<0){
+		fprintf(stderr,"Net : cannot create a socket\n");
+		return 0;
+	}
+	sockaddr_in local;
+	memset(&local,0,sizeof local);
+	local.sin_family=AF_INET;
+	local.sin_addr.s_addr=htonl(INADDR_ANY);
+	local.sin_port=htons(port);
+	if(bind(net.sock,(sockaddr*)&local,sizeof local)<0){
+		fprintf(stderr,"Net : cannot bind port %d\n",port);
+		close(net.sock);
+		return 0;
+	}
+	fcntl(net.sock,F_SETFL,fcntl(net.sock,F_GETFL)|O_NONBLOCK);
+	net.active=1;
+	return 1;
+}
+
+void setNetShim (NetSession &net, float delayms, float jitterms, float losspercent)
+{
+	net.delay=delayms/1000;
+	net.jitter=jitterms/1000;
+	net.loss=losspercent/100;
+}
+
+void setNetTelemetry (NetSession &net, Game &game, Telemetry *telemetry)
+{
+	net.telemetry=telemetry;
+	net.staged.head.store(0);
+	net.staged.tail.store(0);
+	net.staged.dropped=0;
+	game.telemetry=telemetry ? &net.staged : NULL;
+}
+
+/* A rollback from tick from takes back what was staged for it and after,
+   those ticks were never confirmed so none of it was committed */
+static void dropStaged (NetSession &net, int from)
+{
+	Telemetry &st = net.staged;
+	uint32_t head = st.head.load(), tail = st.tail.load();
+	while(head!=tail && (int)st.ring[(head-1)&(TELEMETRY_RING-1)].tick>=from)
+		head--;
+	st.head.store(head);
+}
+
+static void commitStaged (NetSession &net)
+{
+	Telemetry &st = net.staged;
+	uint32_t head = st.head.load(), tail = st.tail.load();
+	while(tail!=head && (int)st.ring[tail&(TELEMETRY_RING-1)].tick<=net.confirmed){
+		recordTelemetry(*net.telemetry,st.ring[tail&(TELEMETRY_RING-1)]);
+		tail++;
+	}
+	st.tail.store(tail);
+}
+
+void closeNet (NetSession &net)
+{
+	if(net.active)
+		close(net.sock);
+	net.active=0;
+}
+
+static void sendNow (NetSession &net, const char *bytes, size_t size)
+{
+	if(sendto(net.sock,bytes,size,0,(sockaddr*)&net.peer,sizeof net.peer)==(ssize_t)size)
+		net.stats.sent++;
+}
+
+/* The shim drops or holds back what is sent, delay plus up to jitter */
+static void sendPacket (NetSession &net, const char *bytes, size_t size)
+{
+	if(net.loss>0 && rngFloat(net.shimrng)<net.loss){
+		net.stats.shimdropped++;
+		return;
+	}
+	if(net.delay<=0 && net.jitter<=0){
+		sendNow(net,bytes,size);
+		return;
+	}
+	NetDelayed held;
+	held.due=inputClock()+net.delay+net.jitter*rngFloat(net.shimrng);
+	held.bytes.assign(bytes,bytes+size);
+	net.outgoing.push_back(held);
+}
+
+static void flushShim (NetSession &net)
+{
+	double now = inputClock();
+	for(size_t k=0;k<net.outgoing.size();){
+		if(net.outgoing[k].due>now){
+			k++;
+			continue;
+		}
+		sendNow(net,&net.outgoing[k].bytes[0],net.outgoing[k].bytes.size());
+		net.outgoing[k]=net.outgoing.back();
+		net.outgoing.pop_back();
+	}
+}
+
+/* Our inputs the peer has not acknowledged, up to the latest one */
+static void sendInputs (NetSession &net)
+{
+	char packet[NET_PACKET];
+	NetHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=NET_MAGIC;
+	h.side=net.side;
+	h.seed=net.seed;
+	h.ack=net.confirmed;
+	int last = net.tick-1;
+	h.first=net.peerack+1;
+	if(h.first<last-NET_MAX_SEND+1)
+		h.first=last-NET_MAX_SEND+1;
+	h.count=last>=h.first ? last-h.first+1 : 0;
+	memcpy(packet,&h,sizeof h);
+	for(int k=0;k<h.count;k++)
+		memcpy(packet+sizeof h+k*sizeof(NetInput),&net.inputs[net.side][slot(h.first+k)],sizeof(NetInput));
+	sendPacket(net,packet,sizeof h+h.count*sizeof(NetInput));
+}
+
+static int sameInput (const NetInput &a, const NetInput &b)
+{
+	return a.buttons==b.buttons && (!(a.buttons&NET_AIM) || a.aim==b.aim);
+}
+
+static void receive (NetSession &net)
+{
+	int remote = !net.side;
+	char packet[NET_PACKET];
+	ssize_t size;
+	while((size=recv(net.sock,packet,sizeof packet,0))>0){
+		NetHeader h;
+		if((size_t)size<sizeof h)
+			continue;
+		memcpy(&h,packet,sizeof h);
+		if(h.magic!=NET_MAGIC || h.side!=remote || (size_t)size!=sizeof h+h.count*sizeof(NetInput))
+			continue;
+		net.stats.received++;
+		if(!net.heard && net.side==ENEMY)
+			net.seed=h.seed;
+		net.heard=1;
+		if(h.ack>net.peerack)
+			net.peerack=h.ack;
+		for(int k=0;k<h.count;k++){
+			int t = h.first+k;
+			if(t<=net.confirmed || net.inputticks[remote][slot(t)]==t)
+				continue;
+			NetInput &in = net.inputs[remote][slot(t)];
+			memcpy(&in,packet+sizeof h+k*sizeof(NetInput),sizeof in);
+			net.inputticks[remote][slot(t)]=t;
+			/* already simulated on a guess that turned out wrong */
+			if(t<net.tick && !sameInput(in,net.used[slot(t)]) && (net.rollbackfrom<0 || t<net.rollbackfrom))
+				net.rollbackfrom=t;
+		}
+		while(net.inputticks[remote][slot(net.confirmed+1)]==net.confirmed+1)
+			net.confirmed++;
+	}
+}
+
+int waitPeer (NetSession &net, double timeout)
+{
+	double start = inputClock();
+	double hello = -1;
+	while(!net.heard){
+		double now = inputClock();
+		if(now-start>timeout)
+			return 0;
+		if(now-hello>=NET_HELLO_SECONDS){
+			hello=now;
+			sendInputs(net);
+		}
+		flushShim(net);
+		receive(net);
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return 1;
+}
+
+void holdInput (NetInput &held, const InputEvent &event)
+{
+	uint8_t bit;
+	switch(event.type){
+		case INPUT_CHARGE: bit=NET_CHARGE; break;
+		case INPUT_UP: bit=NET_UP; break;
+		case INPUT_DOWN: bit=NET_DOWN; break;
+		case INPUT_DIRUP: bit=NET_DIRUP; break;
+		case INPUT_DIRDOWN: bit=NET_DIRDOWN; break;
+		default: return;
+	}
+	if(event.value)
+		held.buttons|=bit;
+	else
+		held.buttons&=~bit;
+}
+
+void holdAim (NetInput &held, float rotation)
+{
+	held.buttons|=NET_AIM;
+	held.aim=(int16_t)(rotation*100);
+}
+
+void netLocalInput (NetSession &net, const InputEvent &event)
+{
+	holdInput(net.held,event);
+}
+
+void netLocalAim (NetSession &net, float rotation)
+{
+	holdAim(net.held,rotation);
+}
+
+/* The peer's input for a tick, predicted from its last known one */
+static NetInput remoteInput (const NetSession &net, int t)
+{
+	int remote = !net.side;
+	if(net.inputticks[remote][slot(t)]==t)
+		return net.inputs[remote][slot(t)];
+	NetInput none;
+	memset(&none,0,sizeof none);
+	return net.confirmed>=0 ? net.inputs[remote][slot(net.confirmed)] : none;
+}
+
+void applyNetInput (Game &game, int c, const NetInput &prev, const NetInput &now, int t)
+{
+	static const int types[5] = {INPUT_CHARGE, INPUT_UP, INPUT_DOWN, INPUT_DIRUP, INPUT_DIRDOWN};
+	InputEvent event;
+	event.time=(double)t/TICKS_PER_SECOND;
+	event.cannon=c;
+	for(int k=0;k<5;k++){
+		if(!((prev.buttons^now.buttons)&(1<<k)))
+			continue;
+		event.type=types[k];
+		event.value=(now.buttons>>k)&1;
+		applyInput(game,event);
+	}
+	if(now.buttons&NET_AIM)
+		getTransform(game.world,game.cannons[c].rect)->rotation=now.aim/100.0f;
+}
+
+static void simulateTick (NetSession &net, Game &game, int t)
+{
+	pushSnapshot(net.snapshots,game);
+	NetInput none;
+	memset(&none,0,sizeof none);
+	const NetInput &local = net.inputs[net.side][slot(t)];
+	const NetInput &localprev = t>0 ? net.inputs[net.side][slot(t-1)] : none;
+	NetInput remote = remoteInput(net,t);
+	NetInput remoteprev = t>0 ? net.used[slot(t-1)] : none;
+	net.used[slot(t)]=remote;
+	/* in cannon order, so both peers record a tick's events alike */
+	if(net.side==0)
+		applyNetInput(game,0,localprev,local,t);
+	applyNetInput(game,!net.side,remoteprev,remote,t);
+	if(net.side==1)
+		applyNetInput(game,1,localprev,local,t);
+	tickGame(game,1.0f/TICKS_PER_SECOND);
+}
+
+int advanceNet (NetSession &net, Game &game)
+{
+	if(!net.active)
+		return 0;
+	receive(net);
+	int ticks = 0;
+	if(net.rollbackfrom>=0){
+		int from = net.rollbackfrom;
+		net.rollbackfrom=-1;
+		uint64_t start = profileClock();
+		restoreSnapshotTick(net.snapshots,game,from);
+		if(net.telemetry)
+			dropStaged(net,from);
+		for(int t=from;t<net.tick;t++)
+			simulateTick(net,game,t);
+		ticks+=net.tick-from;
+		double seconds = (profileClock()-start)*1e-9;
+		net.stats.rollbacks++;
+		net.stats.resimulated+=net.tick-from;
+		if(net.tick-from>net.stats.maxdepth)
+			net.stats.maxdepth=net.tick-from;
+		if(seconds>net.stats.maxresim)
+			net.stats.maxresim=seconds;
+	}
+	if(game.over){
+		/* nothing more to play, keep the inputs flowing until both settle */
+	}
+	else if(net.tick>net.confirmed+NET_MAX_ROLLBACK)
+		net.stats.stalls++;
+	else{
+		net.inputs[net.side][slot(net.tick)]=net.held;
+		net.inputticks[net.side][slot(net.tick)]=net.tick;
+		simulateTick(net,game,net.tick);
+		net.tick++;
+		ticks++;
+	}
+	if(net.telemetry)
+		commitStaged(net);
+	sendInputs(net);
+	flushShim(net);
+	return ticks;
+}
+
+int netSettled (const NetSession &net)
+{
+	return net.confirmed>=net.tick-1 && net.peerack>=net.tick-1 && net.rollbackfrom<0;
+}
+
+void reportNet (const NetSession &net)
+{
+	if(!net.active)
+		return;
+	const NetStats &s = net.stats;
+	printf("net : %d ticks, %ld packets sent, %ld received, %ld dropped by the shim\n",net.tick,s.sent,s.received,s.shimdropped);
+	printf("net : %ld rollbacks, %ld ticks resimulated, deepest %d, worst %.3f ms, %ld stalled frames\n",
+		s.rollbacks,s.resimulated,s.maxdepth,s.maxresim*1000,s.stalls);
+}
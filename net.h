@@ -0,0 +1,123 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdint.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "sim.h"
+#include "rng.h"
+#include "snapshot.h"
+#include "telemetry.h"
+
+/* Rollback netplay over UDP.
+   Each player runs their own process and owns one cannon. Every tick the
+   held buttons (and, for player 2, the mouse aim) are sampled into a
+   NetInput, stamped with the tick and sent to the peer together with
+   every input the peer has not acknowledged yet, so a lost packet is
+   covered by the next one. The peer's input for a tick that has not
+   arrived is predicted to repeat its last known one; when the real one
+   differs the game is restored from the snapshot taken before that tick
+   and the ticks since are simulated again; the snapshots are the flat
+   ones of snapshot.h, restored without allocating. A side that gets
+   NET_MAX_ROLLBACK ticks ahead of the last input it has from its peer
+   waits for it instead of predicting further.
+   Button edges become the usual InputEvents, timed by their tick, so both
+   processes apply exactly the same events. */
+
+#define NET_MAGIC 0x4e455431u	/* "NET1" */
+#define NET_MAX_ROLLBACK 8
+#define NET_RING 64		/* inputs kept per side, power of two */
+#define NET_MAX_SEND 32		/* inputs per packet at most */
+#define NET_HELLO_SECONDS .1
+#define NET_WAIT_SECONDS 60	/* for the peer to start */
+#define NET_LINGER_SECONDS 3	/* after the game, for the last inputs and acks */
+
+enum {
+	NET_CHARGE = 1<<0,
+	NET_UP = 1<<1,
+	NET_DOWN = 1<<2,
+	NET_DIRUP = 1<<3,
+	NET_DIRDOWN = 1<<4,
+	NET_AIM = 1<<5		/* aim holds the barrel angle, player 2's mouse */
+};
+
+struct NetInput{
+	uint8_t buttons;
+	int16_t aim;		/* hundredths of a degree */
+};
+
+/* Outgoing packet held back by the latency and loss shim */
+struct NetDelayed{
+	double due;
+	std::vector<char> bytes;
+};
+
+struct NetStats{
+	long sent, received, shimdropped;
+	long rollbacks, resimulated;
+	int maxdepth;
+	double maxresim;	/* seconds spent on the worst rollback */
+	long stalls;
+};
+
+struct NetSession{
+	int active;
+	int side;		/* PLAYER or ENEMY, the cannon this process owns */
+	int sock;
+	sockaddr_in peer;
+	int heard;		/* anything received from the peer yet */
+	int peerack;		/* the peer has every input of ours up to this tick */
+	uint64_t seed;		/* player 1's, adopted by player 2 */
+	int tick;		/* next tick to simulate */
+	int confirmed;		/* every peer input up to this tick has arrived */
+	int rollbackfrom;	/* earliest mispredicted tick, or -1 */
+	NetInput held;		/* local buttons right now */
+	NetInput inputs[2][NET_RING];
+	int inputticks[2][NET_RING];	/* tick stored in each slot, -1 if none */
+	NetInput used[NET_RING];	/* peer input the simulation used, real or predicted */
+	SnapshotRing snapshots;	/* game before each tick, SNAPSHOT_RING > NET_MAX_ROLLBACK+1 */
+	/* shim, applied to what this side sends */
+	float delay, jitter;	/* seconds */
+	float loss;		/* 0..1 */
+	Rng shimrng;
+	std::vector<NetDelayed> outgoing;
+	NetStats stats;
+	/* shot telemetry waits here, only its ring is used, until no
+	   rollback can change its tick, then goes on to telemetry */
+	Telemetry *telemetry;
+	Telemetry staged;
+};
+
+/* Binds the local port and sets the peer, "host:port". Returns 0 and
+   prints why on failure */
+int openNet (NetSession &net, int side, int port, const char *peer, uint64_t seed);
+void setNetShim (NetSession &net, float delayms, float jitterms, float losspercent);
+/* Exchanges hellos until the peer answers or timeout seconds pass.
+   Player 2 takes player 1's seed */
+int waitPeer (NetSession &net, double timeout);
+void closeNet (NetSession &net);
+/* Records game's shots into telemetry as their ticks are confirmed, so
+   the file holds the match as played rather than as predicted */
+void setNetTelemetry (NetSession &net, Game &game, Telemetry *telemetry);
+
+/* Parses "host:port" into addr, 0 and prints why if it is not one */
+int netAddress (sockaddr_in &addr, const char *hostport);
+/* Sets or clears the button of a press or release in held */
+void holdInput (NetInput &held, const InputEvent &event);
+void holdAim (NetInput &held, float rotation);
+/* Button edges between two ticks' inputs become ordinary input events,
+   timed by tick t, for cannon c */
+void applyNetInput (Game &game, int c, const NetInput &prev, const NetInput &now, int t);
+
+/* Local input, whichever cannon the event was meant for drives ours */
+void netLocalInput (NetSession &net, const InputEvent &event);
+void netLocalAim (NetSession &net, float rotation);
+/* Receives, rolls back if needed, then simulates the next tick unless
+   too far ahead. Returns the ticks simulated, resimulated ones included */
+int advanceNet (NetSession &net, Game &game);
+/* Once the game is over: every input both ways has arrived */
+int netSettled (const NetSession &net);
+void reportNet (const NetSession &net);
+
+#endif
@@ -0,0 +1,182 @@
+#include <cstring>
+
+#include "pack.h"
+
+#define PROB_BITS 11
+#define PROB_ONE (1u<<PROB_BITS)
+#define PROB_MOVE 5
+#define RANGE_TOP (1u<<24)
+/* A probability saturates at 31/2048 from certain, so a byte costs at
+   least 0.18 bits and a packed byte never decodes to more than about 46 */
+#define ENTROPY_MAX_RATIO 64
+
+static inline uint32_t wordAt (const uint8_t *bytes, size_t size, size_t k)
+{
+	uint32_t w = 0;
+	if(4*k+4<=size)
+		memcpy(&w,bytes+4*k,4);
+	return w;
+}
+
+void packSnapshot (std::vector<uint8_t> &out, const uint8_t *bytes, size_t size, const uint8_t *ref, size_t refsize)
+{
+	if(!ref)
+		refsize=0;
+	putVarint(out,size);
+	size_t words = size/4;
+	size_t k = 0;
+	while(k<words){
+		size_t run = k;
+		while(k<words && wordAt(bytes,size,k)==wordAt(ref,refsize,k))
+			k++;
+		size_t literal = k;
+		while(k<words && wordAt(bytes,size,k)!=wordAt(ref,refsize,k))
+			k++;
+		putVarint(out,literal-run);
+		putVarint(out,k-literal);
+		for(size_t j=literal;j<k;j++)
+			putVarint(out,wordAt(bytes,size,j)^wordAt(ref,refsize,j));
+	}
+	out.insert(out.end(),bytes+4*words,bytes+size);
+}
+
+int unpackSnapshot (std::vector<uint8_t> &out, const uint8_t *packed, size_t size, const uint8_t *ref, size_t refsize)
+{
+	if(!ref)
+		refsize=0;
+	const uint8_t *p = packed, *end = packed+size;
+	uint32_t n;
+	if(!getVarint(p,end,n) || n>PACK_MAX_SIZE)
+		return 0;
+	out.resize(n);
+	size_t words = n/4;
+	size_t k = 0;
+	while(k<words){
+		uint32_t run, literal, v;
+		if(!getVarint(p,end,run) || !getVarint(p,end,literal)
+			|| (size_t)run>words-k || (size_t)literal>words-k-run)
+			return 0;
+		for(uint32_t j=0;j<run;j++,k++){
+			uint32_t w = wordAt(ref,refsize,k);
+			memcpy(&out[4*k],&w,4);
+		}
+		for(uint32_t j=0;j<literal;j++,k++){
+			if(!getVarint(p,end,v))
+				return 0;
+			v^=wordAt(ref,refsize,k);
+			memcpy(&out[4*k],&v,4);
+		}
+	}
+	if((size_t)(end-p)!=n-4*words)
+		return 0;
+	if(n>4*words)
+		memcpy(&out[4*words],p,n-4*words);
+	return 1;
+}
+
+/* The range coder of LZMA, one adaptive probability per node of a
+   byte's bit tree */
+struct RangeEncoder{
+	std::vector<uint8_t> *out;
+	uint64_t low;
+	uint32_t range;
+	uint8_t cache;
+	uint64_t cachesize;
+};
+
+static void shiftLow (RangeEncoder &e)
+{
+	if((uint32_t)e.low<0xff000000u || (e.low>>32)!=0){
+		uint8_t carry = (uint8_t)(e.low>>32);
+		uint8_t b = e.cache;
+		do{
+			e.out->push_back((uint8_t)(b+carry));
+			b=0xff;
+		}while(--e.cachesize!=0);
+		e.cache=(uint8_t)(e.low>>24);
+	}
+	e.cachesize++;
+	e.low=(e.low&0x00ffffffu)<<8;
+}
+
+static inline void encodeBit (RangeEncoder &e, uint16_t &prob, int bit)
+{
+	uint32_t bound = (e.range>>PROB_BITS)*prob;
+	if(!bit){
+		e.range=bound;
+		prob+=(PROB_ONE-prob)>>PROB_MOVE;
+	}
+	else{
+		e.low+=bound;
+		e.range-=bound;
+		prob-=prob>>PROB_MOVE;
+	}
+	while(e.range<RANGE_TOP){
+		e.range<<=8;
+		shiftLow(e);
+	}
+}
+
+void packEntropy (std::vector<uint8_t> &out, const uint8_t *bytes, size_t size)
+{
+	uint16_t probs[256];
+	for(int k=0;k<256;k++)
+		probs[k]=PROB_ONE/2;
+	putVarint(out,size);
+	RangeEncoder e;
+	e.out=&out;
+	e.low=0;
+	e.range=0xffffffffu;
+	e.cache=0;
+	e.cachesize=1;
+	for(size_t k=0;k<size;k++){
+		uint32_t node = 1;
+		for(int b=7;b>=0;b--){
+			int bit = (bytes[k]>>b)&1;
+			encodeBit(e,probs[node],bit);
+			node=node*2+bit;
+		}
+	}
+	for(int k=0;k<5;k++)
+		shiftLow(e);
+}
+
+int unpackEntropy (std::vector<uint8_t> &out, const uint8_t *packed, size_t size)
+{
+	const uint8_t *p = packed, *end = packed+size;
+	uint32_t n;
+	if(!getVarint(p,end,n) || end-p<5 || n>PACK_MAX_SIZE || n>ENTROPY_MAX_RATIO*size)
+		return 0;
+	uint16_t probs[256];
+	for(int k=0;k<256;k++)
+		probs[k]=PROB_ONE/2;
+	uint32_t range = 0xffffffffu, code = 0;
+	for(int k=0;k<5;k++)
+		code=(code<<8)|*p++;
+	out.resize(n);
+	for(uint32_t k=0;k<n;k++){
+		uint32_t node = 1;
+		while(node<256){
+			uint16_t &prob = probs[node];
+			uint32_t bound = (range>>PROB_BITS)*prob;
+			if(code<bound){
+				range=bound;
+				prob+=(PROB_ONE-prob)>>PROB_MOVE;
+				node=node*2;
+			}
+			else{
+				code-=bound;
+				range-=bound;
+				prob-=prob>>PROB_MOVE;
+				node=node*2+1;
+			}
+			while(range<RANGE_TOP){
+				range<<=8;
+				/* the encoder's flush covers every byte read here */
+				code=(code<<8)|(p<end ? *p++ : 0);
+			}
+		}
+		out[k]=(uint8_t)node;
+	}
+	return 1;
+}
@@ -0,0 +1,57 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Compression of snapshot streams.
+   packSnapshot codes a snapshot as the XOR of its 32 bit words against a
+   reference snapshot, usually an earlier one of the same match: runs of
+   unchanged words become one varint, changed words the varint of their
+   XOR, which is short when a float only moved in its low mantissa bits.
+   With no reference it codes against zeros, which most of a snapshot is.
+   Lossless, a replay has to resimulate to the bit.
+
+   packEntropy is an optional second stage over any bytes: an adaptive
+   binary range coder with an order-0 model, a few times slower than the
+   first stage and worth about a third of what is left. Both stages start
+   from scratch on every call, so every packed block decodes on its own. */
+
+/* Most bytes either stage decodes to, far above any snapshot, so a
+   damaged size cannot ask for gigabytes */
+#define PACK_MAX_SIZE (16u<<20)
+
+void packSnapshot (std::vector<uint8_t> &out, const uint8_t *bytes, size_t size, const uint8_t *ref, size_t refsize);
+/* Returns 0 if the packed bytes are damaged */
+int unpackSnapshot (std::vector<uint8_t> &out, const uint8_t *packed, size_t size, const uint8_t *ref, size_t refsize);
+
+void packEntropy (std::vector<uint8_t> &out, const uint8_t *bytes, size_t size);
+int unpackEntropy (std::vector<uint8_t> &out, const uint8_t *packed, size_t size);
+
+/* LEB128, seven bits a byte */
+static inline void putVarint (std::vector<uint8_t> &out, uint32_t v)
+{
+	while(v>=0x80){
+		out.push_back((uint8_t)(v|0x80));
+		v>>=7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+/* Returns 0 past end */
+static inline int getVarint (const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+	v=0;
+	for(int shift=0;shift<35;shift+=7){
+		if(p==end)
+			return 0;
+		uint8_t b = *p++;
+		v|=(uint32_t)(b&0x7f)<<shift;
+		if(!(b&0x80))
+			return 1;
+	}
+	return 0;
+}
+
+#endif
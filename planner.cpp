@@ -0,0 +1,155 @@
+#include <chrono>
+#include <vector>
+
+#include "planner.h"
+#include "jobs.h"
+#include "snapshot.h"
+#include "arena.h"
+
+#define PLAN_HORIZON (3*TICKS_PER_SECOND)
+#define PLAN_CANDIDATES 24
+
+struct Rollout{
+	const std::vector<uint8_t> *snapshot;
+	Game *sim;
+	int cannon;
+	int horizon;
+	Plan plan;
+	uint64_t seed;
+	float value;
+};
+
+/* Play one candidate forward on the match restored into the rollout's
+   own Game. Its spawner is reseeded with the round's seed, so the
+   candidates of a round share one future and rounds differ */
+static void rolloutJob (void *data, int begin, int end)
+{
+	Rollout *rollouts = (Rollout*)data;
+	for(int k=begin;k<end;k++){
+		Rollout &r = rollouts[k];
+		Game &sim = *r.sim;
+		restoreSnapshot(sim,&(*r.snapshot)[0],r.snapshot->size());
+		seedRng(sim.spawner.rng,r.seed);
+		Cannon &can = sim.cannons[r.cannon];
+		can.control=CONTROL_PLAN;
+		can.plan=r.plan;
+		can.speedflag=0;
+		can.dirupflag=0;
+		can.dirdownflag=0;
+		int own = can.score;
+		int other = sim.cannons[!r.cannon].score;
+		for(int t=0;t<r.horizon && !sim.over;t++)
+			tickGame(sim,1.0f/TICKS_PER_SECOND);
+		r.value = (sim.cannons[r.cannon].score-own) - (sim.cannons[!r.cannon].score-other);
+	}
+}
+
+static Plan randomPlan (Planner &planner, Game &game)
+{
+	Cannon &can = game.cannons[planner.cannon];
+	Plan plan;
+	plan.active=1;
+	plan.moveframes=rngRange(planner.rng,PLAN_MAX_MOVE+1);
+	plan.dir = rngRange(planner.rng,2) ? 1 : -1;
+	/* keep the cannon between the ground and the HUD */
+	float y = getTransform(game.world,can.base)->y + plan.dir*.1f*plan.moveframes;
+	if(y<-3 || y>2.5)
+		plan.dir=-plan.dir;
+	/* a third of the turns move and then take the closed form shot */
+	plan.aim = rngRange(planner.rng,3)==0;
+	plan.angle=can.minangle+(can.maxangle-can.minangle)*rngFloat(planner.rng);
+	plan.charge=1+(PLAN_MAX_CHARGE-1)*rngFloat(planner.rng);
+	return plan;
+}
+
+void initPlanner (Planner &planner, int cannon, uint64_t seed, float budget)
+{
+	planner.cannon=cannon;
+	planner.budget=budget;
+	planner.horizon=PLAN_HORIZON;
+	planner.candidates=PLAN_CANDIDATES;
+	planner.rng=rngStream(seed,RNG_STREAM_AI+cannon);
+	planner.planned=0;
+	planner.rollouts=0;
+	planner.seconds=0;
+}
+
+int updatePlanner (Planner &planner, Game &game)
+{
+	Cannon &can = game.cannons[planner.cannon];
+	if(can.control!=CONTROL_PLAN || can.plan.active)
+		return 0;
+	/* a bullet rolling on the ground never leaves the field, reload it
+	   once a rollout's worth of ticks has passed */
+	if(can.shootflag && game.ticks-planner.planned<planner.horizon)
+		return 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	/* the closed form shot from where the cannon stands is always a candidate */
+	ArenaScope frame(frameArena());
+	size_t nplans = planner.candidates>1 ? planner.candidates : 1;
+	Plan *plans = arenaArray<Plan>(frame.arena,nplans);
+	plans[0]=randomPlan(planner,game);
+	plans[0].moveframes=0;
+	plans[0].aim=1;
+	for(size_t k=1;k<nplans;k++)
+		plans[k]=randomPlan(planner,game);
+	/* every rollout forks the match from one snapshot into a Game of its
+	   own, which keeps its vectors from one decision to the next */
+	saveSnapshot(planner.snapshot,game);
+	if(planner.scratch.size()<nplans){
+		Game blank = game;
+		blank.profiler=NULL;
+		blank.telemetry=NULL;
+		planner.scratch.resize(nplans,blank);
+	}
+	float *total = arenaArray<float>(frame.arena,nplans);
+	int *samples = arenaArray<int>(frame.arena,nplans);
+	for(size_t k=0;k<nplans;k++){
+		total[k]=0;
+		samples[k]=0;
+	}
+
+	/* one round plays every candidate once, rounds repeat until the budget is spent */
+	Rollout *round = arenaArray<Rollout>(frame.arena,nplans);
+	double elapsed=0;
+	do{
+		/* every candidate of a round sees the same future, so the
+		   comparison is not drowned by spawn and opponent noise */
+		uint64_t seed = nextRng(planner.rng);
+		for(size_t k=0;k<nplans;k++){
+			round[k].snapshot=&planner.snapshot;
+			round[k].sim=&planner.scratch[k];
+			round[k].cannon=planner.cannon;
+			round[k].horizon=planner.horizon;
+			round[k].plan=plans[k];
+			round[k].seed=seed;
+		}
+		JobCounter done;
+		parallelFor(&done,NULL,(int)nplans,1,rolloutJob,round);
+		waitJobs(&done);
+		for(size_t k=0;k<nplans;k++){
+			total[k]+=round[k].value;
+			samples[k]++;
+		}
+		planner.rollouts+=nplans;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	}while(elapsed<planner.budget);
+	planner.seconds+=elapsed;
+
+	size_t best=0;
+	for(size_t k=1;k<nplans;k++){
+		if(total[k]/samples[k] > total[best]/samples[best])
+			best=k;
+	}
+	can.plan=plans[best];
+	planner.planned=game.ticks;
+	return 1;
+}
+
+double plannerRolloutRate (const Planner &planner)
+{
+	if(planner.seconds<=0)
+		return 0;
+	return planner.rollouts/planner.seconds;
+}
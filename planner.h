@@ -0,0 +1,38 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+#include "rng.h"
+
+/* Monte Carlo rollout planner.
+   Whenever its cannon is loaded the planner samples candidate turns
+   (move, barrel angle, charge), plays each one forward from a snapshot
+   of the Game with fresh target spawns and keeps the one with the best
+   mean score lead. Rollouts run as jobs until the time budget is spent. */
+
+#define PLAN_MAX_MOVE 20
+
+struct Planner{
+	int cannon;
+	float budget;		/* seconds per decision */
+	int horizon;		/* ticks simulated by a rollout */
+	int candidates;
+	Rng rng;
+	int planned;		/* tick of the last decision */
+	/* totals over every decision */
+	long rollouts;
+	double seconds;
+	std::vector<uint8_t> snapshot;	/* the match at the decision */
+	std::vector<Game> scratch;	/* one per candidate */
+};
+
+void initPlanner (Planner &planner, int cannon, uint64_t seed, float budget);
+/* Plans a turn if the planner's cannon is under CONTROL_PLAN and idle,
+   returns 1 if it did */
+int updatePlanner (Planner &planner, Game &game);
+double plannerRolloutRate (const Planner &planner);
+
+#endif
@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <cstring>
+
+#include "profile.h"
+
+const char *phasenames[PHASE_COUNT] = {
+	"frame", "poll", "scroll", "collision", "reshape", "draw",
+	"drawscore", "swap", "targets", "projectiles", "countdown"
+};
+
+void clearProfiler (Profiler &profiler)
+{
+	memset(&profiler,0,sizeof profiler);
+}
+
+static int bucketOf (uint64_t ns)
+{
+	if(ns<HDR_SUB)
+		return ns;
+	int shift = 63-__builtin_clzll(ns)-6;
+	if(shift>HDR_SHIFTS)
+		return HDR_BUCKETS-1;
+	return HDR_SUB+(shift-1)*(HDR_SUB/2)+(int)(ns>>shift)-HDR_SUB/2;
+}
+
+static uint64_t bucketValue (int bucket)
+{
+	if(bucket<HDR_SUB)
+		return bucket;
+	int shift = (bucket-HDR_SUB)/(HDR_SUB/2)+1;
+	uint64_t sub = (bucket-HDR_SUB)%(HDR_SUB/2)+HDR_SUB/2;
+	return (sub<<shift)+((uint64_t)1<<(shift-1));
+}
+
+void addSample (Histogram &h, uint64_t ns)
+{
+	h.counts[bucketOf(ns)]++;
+	h.count++;
+	h.sum+=ns;
+	if(ns>h.max)
+		h.max=ns;
+}
+
+uint64_t histogramQuantile (const Histogram &h, double q)
+{
+	if(!h.count)
+		return 0;
+	uint64_t rank = (uint64_t)(q*(h.count-1))+1;
+	uint64_t seen = 0;
+	for(int k=0;k<HDR_BUCKETS;k++){
+		seen+=h.counts[k];
+		if(seen>=rank)
+			return bucketValue(k)<h.max ? bucketValue(k) : h.max;
+	}
+	return h.max;
+}
+
+void printProfile (const Profiler &profiler)
+{
+	printf("%-12s %8s %10s %10s %10s\n","phase","samples","p50 us","p99 us","max us");
+	for(int p=0;p<PHASE_COUNT;p++){
+		const Histogram &h = profiler.phases[p];
+		if(!h.count)
+			continue;
+		printf("%-12s %8llu %10.1f %10.1f %10.1f\n",phasenames[p],(unsigned long long)h.count,
+			histogramQuantile(h,.5)/1e3,histogramQuantile(h,.99)/1e3,h.max/1e3);
+	}
+}
+
+int writeProfileCsv (const Profiler &profiler, const char *path)
+{
+	FILE *out = fopen(path,"w");
+	if(!out)
+		return 0;
+	fprintf(out,"phase,samples,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+	for(int p=0;p<PHASE_COUNT;p++){
+		const Histogram &h = profiler.phases[p];
+		fprintf(out,"%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",phasenames[p],(unsigned long long)h.count,
+			h.count ? h.sum/1e3/h.count : 0.0,
+			histogramQuantile(h,.5)/1e3,histogramQuantile(h,.9)/1e3,histogramQuantile(h,.99)/1e3,
+			histogramQuantile(h,.999)/1e3,h.max/1e3);
+	}
+	return fclose(out)==0;
+}
@@ -0,0 +1,86 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <chrono>
+
+#include "trace.h"
+
+/* Per-phase frame profiler.
+   A ProfileScope times the block it lives in and adds the nanoseconds to
+   its phase's histogram. Scopes take the profiler by pointer and do
+   nothing but a null test when it is NULL, which is how the game runs
+   unless started with --profile; the planner's copies of the match are
+   never profiled. Only the main thread records. While a trace runs the
+   scopes also show up in it as begin/end events. */
+
+enum {
+	PHASE_FRAME,		/* one pass of the main loop */
+	PHASE_POLL,
+	PHASE_SCROLL,
+	PHASE_COLLISION,
+	PHASE_RESHAPE,
+	PHASE_DRAW,
+	PHASE_DRAWSCORE,
+	PHASE_SWAP,
+	PHASE_TARGETS,		/* spawner and target update */
+	PHASE_PROJECTILES,
+	PHASE_COUNTDOWN,
+	PHASE_COUNT
+};
+
+/* Log linear buckets: values below HDR_SUB are exact, above that every
+   power of two is split in HDR_SUB/2 steps, so a bucket is within 1/64
+   of its value, up to 2^(HDR_SHIFTS+7) ns (about half an hour) */
+#define HDR_SUB 128
+#define HDR_SHIFTS 34
+#define HDR_BUCKETS (HDR_SUB+HDR_SHIFTS*(HDR_SUB/2))
+
+struct Histogram{
+	uint32_t counts[HDR_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+};
+
+struct Profiler{
+	Histogram phases[PHASE_COUNT];
+};
+
+extern const char *phasenames[PHASE_COUNT];
+
+static inline uint64_t profileClock ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void clearProfiler (Profiler &profiler);
+void addSample (Histogram &h, uint64_t ns);
+/* Value at quantile q (0..1), the middle of its bucket */
+uint64_t histogramQuantile (const Histogram &h, double q);
+/* p50/p99/max per phase */
+void printProfile (const Profiler &profiler);
+/* Returns 0 if the file cannot be written */
+int writeProfileCsv (const Profiler &profiler, const char *path);
+
+struct ProfileScope{
+	Profiler *profiler;
+	int phase;
+	uint64_t start;
+	ProfileScope (Profiler *p, int ph) : profiler(p), phase(ph), start(0)
+	{
+		if(profiler){
+			traceBegin(phasenames[phase]);
+			start=profileClock();
+		}
+	}
+	~ProfileScope ()
+	{
+		if(profiler){
+			addSample(profiler->phases[phase],profileClock()-start);
+			traceEnd(phasenames[phase]);
+		}
+	}
+};
+
+#endif
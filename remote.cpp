@@ -0,0 +1,167 @@
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+#include "remote.h"
+#include "input.h"
+#include "rng.h"
+
+int openRemote (RemoteClient &remote, const char *server)
+{
+	remote.active=0;
+	if(!netAddress(remote.lobby,server))
+		return 0;
+	remote.sock=socket(AF_INET,SOCK_DGRAM,0);
+	if(remote.sock<0){
+		fprintf(stderr,"Remote : cannot create a socket\n");
+		return 0;
+	}
+	fcntl(remote.sock,F_SETFL,fcntl(remote.sock,F_GETFL)|O_NONBLOCK);
+	remote.shard=remote.lobby;
+	remote.side=PLAYER;
+	remote.match=0;
+	Rng rng = rngStream(clockSeed(),0);
+	remote.token=(uint32_t)nextRng(rng);
+	remote.seed=0;
+	remote.levelhash=0;
+	memset(&remote.held,0,sizeof remote.held);
+	initSpectatorView(remote.view);
+	remote.over=0;
+	remote.scores[0]=remote.scores[1]=0;
+	remote.heard=inputClock();
+	remote.sent=remote.received=0;
+	remote.active=1;
+	return 1;
+}
+
+static void sendTo (RemoteClient &remote, const sockaddr_in &to, const void *bytes, size_t size)
+{
+	if(sendto(remote.sock,bytes,size,0,(const sockaddr*)&to,sizeof to)==(ssize_t)size)
+		remote.sent++;
+}
+
+static void fillHeader (RemoteHeader &h, int type, const RemoteClient &remote)
+{
+	memset(&h,0,sizeof h);
+	h.magic=REMOTE_MAGIC;
+	h.type=type;
+	h.side=remote.side;
+	h.match=remote.match;
+	h.token=remote.token;
+}
+
+int waitWelcome (RemoteClient &remote, double timeout)
+{
+	double start = inputClock();
+	double join = -1;
+	uint8_t packet[64];
+	while(1){
+		double now = inputClock();
+		if(now-start>timeout)
+			return 0;
+		if(now-join>=REMOTE_JOIN_SECONDS){
+			join=now;
+			RemoteHeader h;
+			fillHeader(h,REMOTE_JOIN,remote);
+			sendTo(remote,remote.lobby,&h,sizeof h);
+		}
+		ssize_t size;
+		while((size=recv(remote.sock,packet,sizeof packet,0))>0){
+			RemoteHeader h;
+			RemoteWelcome w;
+			if((size_t)size!=sizeof h+sizeof w)
+				continue;
+			memcpy(&h,packet,sizeof h);
+			memcpy(&w,packet+sizeof h,sizeof w);
+			if(h.magic!=REMOTE_MAGIC || h.type!=REMOTE_WELCOME || h.token!=remote.token)
+				continue;
+			remote.received++;
+			remote.side=h.side ? ENEMY : PLAYER;
+			remote.match=h.match;
+			remote.shard.sin_port=htons(h.port);
+			remote.seed=w.seed;
+			remote.levelhash=w.levelhash;
+			remote.view.levelhash=w.levelhash;
+			remote.heard=inputClock();
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+int pollRemote (RemoteClient &remote)
+{
+	if(!remote.active)
+		return -1;
+	static uint8_t packet[REMOTE_MAX_PACKET];
+	int decoded = 0;
+	ssize_t size;
+	while((size=recv(remote.sock,packet,sizeof packet,0))>0){
+		RemoteHeader h;
+		if((size_t)size<sizeof h)
+			continue;
+		memcpy(&h,packet,sizeof h);
+		if(h.magic!=REMOTE_MAGIC || h.match!=remote.match || h.token!=remote.token)
+			continue;
+		remote.received++;
+		remote.heard=inputClock();
+		remote.view.bytes+=size;
+		if(h.type==REMOTE_STATE && (size_t)size>=sizeof h+sizeof(RemoteState)){
+			RemoteState s;
+			memcpy(&s,packet+sizeof h,sizeof s);
+			size_t head = sizeof h+sizeof s;
+			if(storeSpectatorFrame(remote.view,s.tick,s.basetick,packet+head,size-head)){
+				decoded++;
+				remote.view.decoded++;
+			}
+			else
+				remote.view.dropped++;
+		}
+		else if(h.type==REMOTE_END && (size_t)size==sizeof h+sizeof(RemoteEnd)){
+			RemoteEnd e;
+			memcpy(&e,packet+sizeof h,sizeof e);
+			remote.scores[0]=e.scores[0];
+			remote.scores[1]=e.scores[1];
+			remote.over=1;
+		}
+	}
+	if(remote.over || inputClock()-remote.heard>REMOTE_TIMEOUT_SECONDS)
+		return -1;
+	return decoded;
+}
+
+void sendRemoteInput (RemoteClient &remote)
+{
+	if(!remote.active)
+		return;
+	uint8_t packet[sizeof(RemoteHeader)+sizeof(RemoteInput)];
+	RemoteHeader h;
+	fillHeader(h,REMOTE_INPUT,remote);
+	RemoteInput in;
+	memset(&in,0,sizeof in);
+	in.acked=remote.view.latest;
+	in.input=remote.held;
+	memcpy(packet,&h,sizeof h);
+	memcpy(packet+sizeof h,&in,sizeof in);
+	sendTo(remote,remote.shard,packet,sizeof packet);
+}
+
+void closeRemote (RemoteClient &remote)
+{
+	if(remote.active)
+		close(remote.sock);
+	remote.active=0;
+}
+
+void reportRemote (const RemoteClient &remote)
+{
+	if(!remote.active)
+		return;
+	printf("remote : match %u, player %d, %ld datagrams sent, %ld received\n",remote.match,remote.side+1,remote.sent,remote.received);
+	reportSpectator(remote.view);
+}
@@ -0,0 +1,94 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "net.h"
+#include "spectate.h"
+
+/* Matches played on a dedicated server.
+   A player sends JOIN to the server's lobby port until it answers with
+   WELCOME: the cannon, the seed, the level hash and the port of the shard
+   that runs the match. From then on the player only talks to that shard.
+   Each frame it sends the buttons it holds, as a NetInput, together with
+   the tick of the newest state it decoded; held buttons rather than
+   presses, so a lost datagram is made good by the next one. The shard
+   owns the simulation: every tick it applies both players' latest inputs
+   and sends each player the tick's SpectatorFrame as a delta against the
+   frame that player acknowledged, which the player shows the way a
+   spectator does. END carries the final scores once the match is over. */
+
+#define REMOTE_MAGIC 0x31544d52u	/* "RMT1" */
+#define REMOTE_HISTORY 16	/* frames a shard keeps for baselines, power of two */
+#define REMOTE_MAX_PACKET 65000
+#define REMOTE_JOIN_SECONDS .25	/* between JOINs until the lobby answers */
+#define REMOTE_WAIT_SECONDS 60	/* for an opponent */
+#define REMOTE_TIMEOUT_SECONDS 5	/* silence before the other end is given up */
+
+enum {
+	REMOTE_JOIN,		/* player to lobby, token is the player's nonce */
+	REMOTE_WELCOME,		/* lobby to player, port is the shard's */
+	REMOTE_INPUT,		/* player to shard */
+	REMOTE_STATE,		/* shard to player */
+	REMOTE_END		/* shard to player */
+};
+
+struct RemoteHeader{
+	uint32_t magic;
+	uint8_t type;
+	uint8_t side;
+	uint16_t port;
+	uint32_t match;
+	uint32_t token;		/* the player's, checked on every INPUT */
+};
+
+struct RemoteWelcome{
+	uint64_t seed;
+	uint32_t levelhash;
+};
+
+struct RemoteInput{
+	uint32_t acked;		/* newest decoded tick, SPECTATE_NONE if none */
+	NetInput input;
+};
+
+/* STATE is followed by the encodeFrame bits */
+struct RemoteState{
+	uint32_t tick;
+	uint32_t basetick;
+};
+
+struct RemoteEnd{
+	int32_t scores[2];
+};
+
+struct RemoteClient{
+	int active;
+	int sock;
+	sockaddr_in lobby, shard;
+	int side;
+	uint32_t match, token;
+	uint64_t seed;
+	uint32_t levelhash;
+	NetInput held;
+	SpectatorClient view;	/* frames decoded as a spectator's */
+	int over;
+	int scores[2];
+	double heard;		/* clock of the last datagram from the shard */
+	long sent, received;
+};
+
+/* Returns 0 and prints why if the socket cannot be made */
+int openRemote (RemoteClient &remote, const char *server);
+/* Joins and waits until the lobby has paired us, up to timeout seconds */
+int waitWelcome (RemoteClient &remote, double timeout);
+/* Decodes every state that arrived, returns -1 once the match is over or
+   the shard has gone quiet */
+int pollRemote (RemoteClient &remote);
+/* Our held buttons and the newest tick we have */
+void sendRemoteInput (RemoteClient &remote);
+void closeRemote (RemoteClient &remote);
+void reportRemote (const RemoteClient &remote);
+
+#endif
@@ -0,0 +1,442 @@
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+#include "replay.h"
+#include "snapshot.h"
+#include "profile.h"
+#include "bits.h"
+#include "pack.h"
+
+static uint32_t floatBits (float f)
+{
+	uint32_t u;
+	memcpy(&u,&f,4);
+	return u;
+}
+
+static float bitsFloat (uint32_t u)
+{
+	float f;
+	memcpy(&f,&u,4);
+	return f;
+}
+
+/* Mouse aims are hundredths of a degree, as in netplay; anything else
+   keeps its float */
+static void packInputs (BitWriter &w, const ReplaySegment &s)
+{
+	int tick = s.tick;
+	int32_t aims[2] = {0, 0};
+	uint64_t time = 0;
+	for(size_t k=0;k<s.inputs.size();k++){
+		const ReplayInput &in = s.inputs[k];
+		writeVar(w,in.tick-tick);
+		tick=in.tick;
+		writeBits(w,in.type,2);
+		writeBits(w,in.cannon,1);
+		if(in.type==REPLAY_EVENT){
+			writeBits(w,in.input,3);
+			writeBits(w,in.value,1);
+			uint64_t t;
+			memcpy(&t,&in.time,8);
+			writeVar(w,(uint32_t)((t^time)>>32));
+			writeVar(w,(uint32_t)(t^time));
+			time=t;
+		}
+		else if(in.type==REPLAY_AIM){
+			int32_t aim = lrintf(in.aim*100);
+			int exact = aim/100.0f==in.aim;
+			writeBits(w,exact,1);
+			if(exact){
+				writeSigned(w,aim-aims[in.cannon]);
+				aims[in.cannon]=aim;
+			}
+			else
+				writeBits(w,floatBits(in.aim),32);
+		}
+		else{
+			writeBits(w,in.plan.active!=0,1);
+			writeVar(w,in.plan.moveframes);
+			writeSigned(w,in.plan.dir);
+			writeBits(w,in.plan.aim!=0,1);
+			writeBits(w,floatBits(in.plan.angle),32);
+			writeBits(w,floatBits(in.plan.charge),32);
+		}
+	}
+	flushBits(w);
+}
+
+static int unpackInputs (ReplaySegment &s, uint32_t count, const uint8_t *bytes, size_t size)
+{
+	/* every input takes more than a bit */
+	if(count>8*size)
+		return 0;
+	BitReader r;
+	startBits(r,bytes,size);
+	int tick = s.tick;
+	int32_t aims[2] = {0, 0};
+	uint64_t time = 0;
+	s.inputs.resize(count);
+	for(uint32_t k=0;k<count;k++){
+		ReplayInput &in = s.inputs[k];
+		memset(&in,0,sizeof in);
+		tick+=readVar(r);
+		in.tick=tick;
+		in.type=readBits(r,2);
+		in.cannon=readBits(r,1);
+		if(in.type==REPLAY_EVENT){
+			in.input=readBits(r,3);
+			in.value=readBits(r,1);
+			uint64_t hi = readVar(r);
+			time^=hi<<32|readVar(r);
+			memcpy(&in.time,&time,8);
+		}
+		else if(in.type==REPLAY_AIM){
+			if(readBits(r,1)){
+				aims[in.cannon]+=readSigned(r);
+				in.aim=aims[in.cannon]/100.0f;
+			}
+			else
+				in.aim=bitsFloat(readBits(r,32));
+		}
+		else{
+			in.plan.active=readBits(r,1);
+			in.plan.moveframes=readVar(r);
+			in.plan.dir=readSigned(r);
+			in.plan.aim=readBits(r,1);
+			in.plan.angle=bitsFloat(readBits(r,32));
+			in.plan.charge=bitsFloat(readBits(r,32));
+		}
+	}
+	return !r.overrun;
+}
+
+/* FNV-1a */
+static uint32_t fnv (const void *p, size_t size, uint32_t h = 2166136261u)
+{
+	const uint8_t *b = (const uint8_t*)p;
+	for(size_t k=0;k<size;k++){
+		h^=b[k];
+		h*=16777619u;
+	}
+	return h;
+}
+
+/* Of the header up to the checksum and the packed bytes */
+static uint32_t segmentChecksum (const ReplaySegmentHeader &h, const std::vector<uint8_t> &packed)
+{
+	return fnv(&packed[0],h.size,fnv(&h,offsetof(ReplaySegmentHeader,checksum)));
+}
+
+static void writeSegment (ReplayRecorder &rec)
+{
+	uint64_t start = profileClock();
+	ReplaySegment &s = rec.segment;
+	ReplaySegmentHeader h;
+	h.magic=REPLAY_SEGMENT_MAGIC;
+	h.tick=s.tick;
+	h.ticks=s.ticks;
+	h.inputs=s.inputs.size();
+	h.delta=rec.segments%REPLAY_ANCHOR!=0;
+	std::vector<uint8_t> &packed = rec.packed;
+	packed.clear();
+	std::vector<uint8_t> keyframe;
+	packSnapshot(keyframe,&s.keyframe[0],s.keyframe.size(),h.delta ? &rec.previous[0] : NULL,rec.previous.size());
+	putVarint(packed,keyframe.size());
+	packed.insert(packed.end(),keyframe.begin(),keyframe.end());
+	BitWriter w;
+	clearBits(w);
+	packInputs(w,s);
+	packed.insert(packed.end(),w.bytes.begin(),w.bytes.end());
+	if(rec.flags&REPLAY_ENTROPY){
+		rec.entropy.clear();
+		packEntropy(rec.entropy,&packed[0],packed.size());
+		packed.swap(rec.entropy);
+	}
+	h.size=packed.size();
+	h.checksum=segmentChecksum(h,packed);
+	rec.packseconds+=(profileClock()-start)*1e-9;
+	int ok = fwrite(&h,sizeof h,1,rec.out)==1
+		&& fwrite(&packed[0],1,packed.size(),rec.out)==packed.size()
+		&& fflush(rec.out)==0;
+	if(!ok)
+		fprintf(stderr,"Replay : cannot write the segment at tick %d\n",s.tick);
+	rec.segments++;
+	rec.inputs+=s.inputs.size();
+	rec.rawbytes+=s.keyframe.size()+s.inputs.size()*sizeof(ReplayInput);
+	rec.bytes+=sizeof h+packed.size();
+	rec.previous.swap(s.keyframe);
+}
+
+static void beginSegment (ReplayRecorder &rec, const Game &game)
+{
+	rec.segment.tick=game.ticks;
+	rec.segment.ticks=0;
+	rec.segment.inputs.clear();
+	saveSnapshot(rec.segment.keyframe,game);
+}
+
+int startReplay (ReplayRecorder &rec, const char *path, const Game &game, int interval, uint32_t flags)
+{
+	rec.active=0;
+	rec.out=fopen(path,"wb");
+	if(!rec.out){
+		fprintf(stderr,"Replay : cannot write %s\n",path);
+		return 0;
+	}
+	ReplayHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=REPLAY_MAGIC;
+	h.version=REPLAY_VERSION;
+	h.levelhash=game.levelhash;
+	h.interval=interval;
+	h.seed=game.seed;
+	h.flags=flags;
+	h.anchor=REPLAY_ANCHOR;
+	fwrite(&h,sizeof h,1,rec.out);
+	rec.interval=interval;
+	rec.flags=flags;
+	rec.previous.clear();
+	rec.segments=rec.inputs=0;
+	rec.rawbytes=0;
+	rec.bytes=sizeof h;
+	rec.packseconds=0;
+	beginSegment(rec,game);
+	rec.active=1;
+	return 1;
+}
+
+void replayTick (ReplayRecorder &rec, const Game &game)
+{
+	if(!rec.active || game.ticks%rec.interval!=0 || game.ticks==rec.segment.tick)
+		return;
+	rec.segment.ticks=game.ticks-rec.segment.tick;
+	writeSegment(rec);
+	beginSegment(rec,game);
+}
+
+static ReplayInput &addInput (ReplayRecorder &rec, const Game &game, int type, int c)
+{
+	rec.segment.inputs.push_back(ReplayInput());
+	ReplayInput &in = rec.segment.inputs.back();
+	memset(&in,0,sizeof in);
+	in.tick=game.ticks;
+	in.type=type;
+	in.cannon=c;
+	return in;
+}
+
+void recordReplayEvent (ReplayRecorder &rec, const Game &game, const InputEvent &event)
+{
+	if(!rec.active)
+		return;
+	ReplayInput &in = addInput(rec,game,REPLAY_EVENT,event.cannon);
+	in.input=event.type;
+	in.value=event.value;
+	in.time=event.time;
+}
+
+void recordReplayAim (ReplayRecorder &rec, Game &game, int c, float rotation)
+{
+	if(!rec.active || rotation==getTransform(game.world,game.cannons[c].rect)->rotation)
+		return;
+	addInput(rec,game,REPLAY_AIM,c).aim=rotation;
+}
+
+void recordReplayPlan (ReplayRecorder &rec, const Game &game, int c)
+{
+	if(!rec.active)
+		return;
+	addInput(rec,game,REPLAY_PLAN,c).plan=game.cannons[c].plan;
+}
+
+void stopReplay (ReplayRecorder &rec, const Game &game)
+{
+	if(!rec.active)
+		return;
+	rec.segment.ticks=game.ticks-rec.segment.tick;
+	writeSegment(rec);
+	fclose(rec.out);
+	rec.active=0;
+}
+
+void reportReplayRecorder (const ReplayRecorder &rec)
+{
+	if(!rec.segments)
+		return;
+	printf("replay : %ld keyframes, %ld inputs, %.1f kB packed from %.1f kB, %.1fx at %.0f MB/s\n",rec.segments,rec.inputs,
+		rec.bytes/1024.0,rec.rawbytes/1024.0,(double)rec.rawbytes/rec.bytes,rec.rawbytes/rec.packseconds*1e-6);
+}
+
+int loadReplay (Replay &replay, const char *path, const Game &game)
+{
+	replay.active=0;
+	replay.segments.clear();
+	FILE *in = fopen(path,"rb");
+	if(!in){
+		fprintf(stderr,"Replay : cannot read %s\n",path);
+		return 0;
+	}
+	ReplayHeader &h = replay.header;
+	if(fread(&h,sizeof h,1,in)!=1 || h.magic!=REPLAY_MAGIC || h.version!=REPLAY_VERSION){
+		fprintf(stderr,"Replay : %s is not a replay\n",path);
+		fclose(in);
+		return 0;
+	}
+	if(h.levelhash!=game.levelhash){
+		fprintf(stderr,"Replay : %s plays another level\n",path);
+		fclose(in);
+		return 0;
+	}
+	/* a segment cut short by a crash, or one that does not decode, ends
+	   the replay. Keyframes are restored once here into a copy of the
+	   game, so a seek never meets one that fails half way */
+	long left = 0;
+	if(fseek(in,0,SEEK_END)==0)
+		left=ftell(in)-(long)sizeof h;
+	fseek(in,sizeof h,SEEK_SET);
+	Game check = game;
+	ReplaySegmentHeader sh;
+	std::vector<uint8_t> packed, unpacked;
+	replay.rawbytes=0;
+	replay.bytes=sizeof h;
+	replay.unpackseconds=0;
+	while(fread(&sh,sizeof sh,1,in)==1 && sh.magic==REPLAY_SEGMENT_MAGIC){
+		left-=sizeof sh;
+		if(left<0 || sh.size==0 || sh.size>(unsigned long)left || (sh.delta && replay.segments.empty()))
+			break;
+		packed.resize(sh.size);
+		if(fread(&packed[0],1,sh.size,in)!=sh.size || segmentChecksum(sh,packed)!=sh.checksum)
+			break;
+		left-=sh.size;
+		uint64_t start = profileClock();
+		if(h.flags&REPLAY_ENTROPY){
+			if(!unpackEntropy(unpacked,&packed[0],packed.size()))
+				break;
+			packed.swap(unpacked);
+		}
+		ReplaySegment s;
+		s.tick=sh.tick;
+		s.ticks=sh.ticks;
+		const uint8_t *p = &packed[0], *end = p+packed.size();
+		uint32_t keyframesize;
+		if(!getVarint(p,end,keyframesize) || keyframesize>(size_t)(end-p))
+			break;
+		const std::vector<uint8_t> *ref = sh.delta ? &replay.segments.back().keyframe : NULL;
+		if(!unpackSnapshot(s.keyframe,p,keyframesize,ref ? &(*ref)[0] : NULL,ref ? ref->size() : 0)
+			|| !unpackInputs(s,sh.inputs,p+keyframesize,end-p-keyframesize)
+			|| s.keyframe.empty() || !restoreSnapshot(check,&s.keyframe[0],s.keyframe.size()) || check.ticks!=s.tick)
+			break;
+		replay.unpackseconds+=(profileClock()-start)*1e-9;
+		replay.rawbytes+=s.keyframe.size()+s.inputs.size()*sizeof(ReplayInput);
+		replay.bytes+=sizeof sh+sh.size;
+		replay.segments.push_back(s);
+	}
+	fclose(in);
+	if(replay.segments.empty()){
+		fprintf(stderr,"Replay : %s holds no whole segment\n",path);
+		return 0;
+	}
+	replay.first=replay.segments.front().tick;
+	replay.end=replay.segments.back().tick+replay.segments.back().ticks;
+	replay.synced=0;
+	replay.speed=1;
+	replay.seeks=0;
+	replay.seekseconds=replay.maxseek=0;
+	replay.active=1;
+	return 1;
+}
+
+static bool segmentBefore (int tick, const ReplaySegment &s)
+{
+	return tick<s.tick;
+}
+
+/* The segment holding tick, the last one for the end */
+static const ReplaySegment &segmentAt (const Replay &replay, int tick)
+{
+	std::vector<ReplaySegment>::const_iterator s = std::upper_bound(replay.segments.begin(),replay.segments.end(),tick,segmentBefore);
+	return s==replay.segments.begin() ? *s : *(s-1);
+}
+
+static bool inputBefore (const ReplayInput &in, int tick)
+{
+	return in.tick<tick;
+}
+
+int stepReplay (const Replay &replay, Game &game)
+{
+	if(game.ticks<replay.first || game.ticks>=replay.end)
+		return 0;
+	const ReplaySegment &s = segmentAt(replay,game.ticks);
+	std::vector<ReplayInput>::const_iterator in = std::lower_bound(s.inputs.begin(),s.inputs.end(),game.ticks,inputBefore);
+	std::vector<ReplayInput>::const_iterator end = in;
+	for(;end!=s.inputs.end() && end->tick==game.ticks;end++){
+		if(end->type!=REPLAY_EVENT)
+			continue;
+		InputEvent event;
+		event.time=end->time;
+		event.cannon=end->cannon;
+		event.type=end->input;
+		event.value=end->value;
+		applyInput(game,event);
+	}
+	beginTick(game);
+	for(;in!=end;in++){
+		if(in->type==REPLAY_AIM)
+			getTransform(game.world,game.cannons[in->cannon].rect)->rotation=in->aim;
+		else if(in->type==REPLAY_PLAN)
+			game.cannons[in->cannon].plan=in->plan;
+	}
+	endTick(game,1.0f/TICKS_PER_SECOND);
+	return 1;
+}
+
+int seekReplay (Replay &replay, Game &game, int tick)
+{
+	uint64_t start = profileClock();
+	tick=std::max(replay.first,std::min(tick,replay.end));
+	const ReplaySegment &s = segmentAt(replay,tick);
+	/* forward within reach plays on, anything else starts from the keyframe */
+	if(!replay.synced || game.ticks>tick || game.ticks<s.tick){
+		if(!restoreSnapshot(game,&s.keyframe[0],s.keyframe.size()))
+			return 0;
+		replay.synced=1;
+	}
+	while(game.ticks<tick && stepReplay(replay,game))
+		;
+	double seconds = (profileClock()-start)*1e-9;
+	replay.seeks++;
+	replay.seekseconds+=seconds;
+	if(seconds>replay.maxseek)
+		replay.maxseek=seconds;
+	return 1;
+}
+
+void viewReplay (Replay &replay, Game &game)
+{
+	if(replay.speed>0){
+		for(int k=0;k<replay.speed;k++){
+			if(!stepReplay(replay,game)){
+				replay.speed=0;
+				break;
+			}
+		}
+	}
+	else if(replay.speed<0){
+		seekReplay(replay,game,game.ticks+replay.speed);
+		if(game.ticks<=replay.first)
+			replay.speed=0;
+	}
+}
+
+void reportReplay (const Replay &replay)
+{
+	if(!replay.seeks)
+		return;
+	printf("replay : %d ticks in %d keyframes, %.1f kB unpacked to %.1f kB at %.0f MB/s, %ld seeks, mean %.3f ms, worst %.3f ms\n",
+		replay.end-replay.first,(int)replay.segments.size(),replay.bytes/1024.0,replay.rawbytes/1024.0,
+		replay.rawbytes/replay.unpackseconds*1e-6,replay.seeks,replay.seekseconds/replay.seeks*1000,replay.maxseek*1000);
+}
@@ -0,0 +1,138 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "sim.h"
+#include "input.h"
+
+/* Seekable match replays.
+   A replay is a run of segments, each a snapshot of the match at a
+   keyframe tick and everything from outside the rules that changed it
+   until the next keyframe: the input events, the mouse aim of player 2
+   and the turns the planners chose. Stepping restores nothing, it plays
+   the recorded inputs through the same beginTick and endTick as the game;
+   seeking restores the keyframe at or before the tick and plays forward
+   from there, so no seek costs more than REPLAY_INTERVAL ticks however
+   long the match. The recorder writes a segment when the next keyframe
+   starts, so a crash loses at most the last interval.
+
+   Segments are packed (pack.h): the keyframe against the one before it,
+   except every REPLAY_ANCHOR'th which stands alone, and the inputs bit
+   packed with the ticks as deltas, the aims as zigzagged deltas of
+   hundredths of a degree and the event times as the XOR of the previous
+   one. A reader can start at any anchor and reaches any keyframe after it
+   by decoding at most REPLAY_ANCHOR-1 others; loadReplay decodes them all
+   once, so seeks in memory never decode.
+
+   File: a ReplayHeader, then segments of a ReplaySegmentHeader and the
+   packed bytes: the varint size of the packed keyframe, the keyframe, the
+   inputs; all of it through packEntropy if the header has REPLAY_ENTROPY.
+   A segment whose bytes fail the checksum or whose keyframe does not
+   restore ends the replay. */
+
+#define REPLAY_MAGIC 0x314c5052u	/* "RPL1" */
+#define REPLAY_SEGMENT_MAGIC 0x47455352u	/* "RSEG" */
+#define REPLAY_VERSION 3
+#define REPLAY_INTERVAL 60	/* ticks between keyframes */
+#define REPLAY_ANCHOR 10	/* keyframes packed on their own, one in this many */
+#define REPLAY_ENTROPY 1	/* flag, the second stage is on */
+#define REPLAY_MAX_SPEED 16	/* ticks per frame when fast forwarding */
+
+enum {
+	REPLAY_EVENT,		/* an InputEvent, applied before beginTick */
+	REPLAY_AIM,		/* a barrel rotation set between the halves */
+	REPLAY_PLAN		/* a planner's turn, set between the halves */
+};
+
+struct ReplayInput{
+	int32_t tick;
+	uint8_t type;
+	uint8_t cannon;
+	uint8_t input;		/* the event's type */
+	uint8_t value;
+	double time;		/* the event's, the charge depends on it */
+	float aim;
+	Plan plan;
+};
+
+struct ReplayHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t levelhash;
+	int32_t interval;
+	uint64_t seed;
+	uint32_t flags;
+	int32_t anchor;
+};
+
+struct ReplaySegmentHeader{
+	uint32_t magic;
+	int32_t tick;		/* of the keyframe */
+	int32_t ticks;		/* played from it */
+	uint32_t inputs;
+	uint32_t size;		/* packed bytes that follow */
+	uint32_t delta;		/* 1 if the keyframe is packed against the one before */
+	uint32_t checksum;	/* FNV-1a of the fields above and the packed bytes */
+};
+
+struct ReplaySegment{
+	int tick, ticks;
+	std::vector<uint8_t> keyframe;
+	std::vector<ReplayInput> inputs;	/* in tick order */
+};
+
+struct ReplayRecorder{
+	int active;
+	FILE *out;
+	int interval;
+	uint32_t flags;
+	ReplaySegment segment;	/* the one being recorded */
+	std::vector<uint8_t> previous;	/* keyframe of the last segment written */
+	std::vector<uint8_t> packed, entropy;
+	long segments, inputs;
+	long rawbytes, bytes;	/* unpacked, the size the segments would take as they are */
+	double packseconds;
+};
+
+struct Replay{
+	int active;
+	ReplayHeader header;
+	std::vector<ReplaySegment> segments;
+	int first, end;		/* ticks the replay covers */
+	int synced;		/* the Game was restored from it and only stepped since */
+	long rawbytes, bytes;
+	double unpackseconds;
+	/* viewing */
+	int speed;		/* ticks per frame, negative rewinds */
+	long seeks;
+	double seekseconds, maxseek;
+};
+
+/* Creates the file and takes the first keyframe, at the match's tick.
+   flags is 0 or REPLAY_ENTROPY */
+int startReplay (ReplayRecorder &rec, const char *path, const Game &game, int interval, uint32_t flags);
+/* At the start of every tick, takes the keyframe when one is due */
+void replayTick (ReplayRecorder &rec, const Game &game);
+void recordReplayEvent (ReplayRecorder &rec, const Game &game, const InputEvent &event);
+/* Before the barrel is set, kept only if it moves the barrel */
+void recordReplayAim (ReplayRecorder &rec, Game &game, int c, float rotation);
+void recordReplayPlan (ReplayRecorder &rec, const Game &game, int c);
+/* Writes the last segment, up to the match's tick */
+void stopReplay (ReplayRecorder &rec, const Game &game);
+void reportReplayRecorder (const ReplayRecorder &rec);
+
+/* Reads every whole segment. Returns 0 and prints why if it is not a
+   replay of game's level, or has none */
+int loadReplay (Replay &replay, const char *path, const Game &game);
+/* Plays the tick game is at, 0 at the end of the replay */
+int stepReplay (const Replay &replay, Game &game);
+/* Puts game at tick, clamped to the replay */
+int seekReplay (Replay &replay, Game &game, int tick);
+/* One frame of the viewer, moves speed ticks forward or back */
+void viewReplay (Replay &replay, Game &game);
+void reportReplay (const Replay &replay);
+
+#endif
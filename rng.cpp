@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cmath>
+
+#include "rng.h"
+
+/* splitmix64, expands one 64 bit seed into the xoshiro state */
+static uint64_t splitmix (uint64_t &x)
+{
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void seedRng (Rng &rng, uint64_t seed)
+{
+	for(int k=0;k<4;k++)
+		rng.s[k]=splitmix(seed);
+}
+
+/* Equivalent to 2^128 calls of nextRng */
+void jumpRng (Rng &rng)
+{
+	static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+		0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+	uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for(int i=0;i<4;i++){
+		for(int b=0;b<64;b++){
+			if(JUMP[i] & (1ULL << b)){
+				s0 ^= rng.s[0];
+				s1 ^= rng.s[1];
+				s2 ^= rng.s[2];
+				s3 ^= rng.s[3];
+			}
+			nextRng(rng);
+		}
+	}
+	rng.s[0]=s0;
+	rng.s[1]=s1;
+	rng.s[2]=s2;
+	rng.s[3]=s3;
+}
+
+Rng rngStream (uint64_t seed, int stream)
+{
+	Rng rng;
+	seedRng(rng,seed);
+	for(int k=0;k<stream;k++)
+		jumpRng(rng);
+	return rng;
+}
+
+float rngNormal (Rng &rng)
+{
+	/* Box-Muller, u is kept away from 0 for the log */
+	float u = ((nextRng(rng) >> 40) + 1.0f) * (1.0f / 16777217.0f);
+	float v = rngFloat(rng);
+	return sqrtf(-2*logf(u))*cosf(2*(float)M_PI*v);
+}
+
+uint64_t clockSeed ()
+{
+	uint64_t seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	return splitmix(seed);
+}
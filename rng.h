@@ -0,0 +1,66 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* xoshiro256** pseudo random generator.
+   Each match owns its own Rng streams instead of the hidden rand() state,
+   so a seed reproduces a match bit for bit on any thread. Streams of one
+   seed are 2^128 draws apart (see jumpRng) and never overlap. */
+
+struct Rng{
+	uint64_t s[4];
+};
+
+/* Well known stream numbers of a match */
+enum {
+	RNG_STREAM_SPAWN,
+	RNG_STREAM_AI,		/* cannon c uses RNG_STREAM_AI+c */
+	RNG_STREAM_STRESS=RNG_STREAM_AI+2,
+	RNG_STREAM_WORKERS	/* worker k uses RNG_STREAM_WORKERS+k */
+};
+
+void seedRng (Rng &rng, uint64_t seed);
+/* Stream n of a seed: seeded, then jumped n times */
+Rng rngStream (uint64_t seed, int stream);
+void jumpRng (Rng &rng);
+
+static inline uint64_t rngRotl (uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t nextRng (Rng &rng)
+{
+	uint64_t *s = rng.s;
+	uint64_t result = rngRotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rngRotl(s[3], 45);
+	return result;
+}
+
+/* Uniform in [0,n) */
+static inline uint32_t rngRange (Rng &rng, uint32_t n)
+{
+	return (uint32_t)(((nextRng(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+/* Uniform in [0,1) */
+static inline float rngFloat (Rng &rng)
+{
+	return (nextRng(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+/* Standard normal */
+float rngNormal (Rng &rng);
+
+/* Seed for a fresh match, from the clock. Logged by the caller so the
+   match can be replayed with the same seed */
+uint64_t clockSeed ();
+
+#endif
@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scores.h"
+#include "rng.h"
+
+struct ScoreLogHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t recordsize;
+	uint32_t logid;		/* new for every log written, ties the index to it */
+};
+
+struct ScoreIndexHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t logid;
+	uint32_t count;		/* entries in each order */
+	uint32_t covered;	/* log records, damaged ones included */
+	uint32_t reserved;
+};
+
+/* FNV-1a */
+static uint32_t fnv (const void *p, size_t size, uint32_t h = 2166136261u)
+{
+	const uint8_t *b = (const uint8_t*)p;
+	for(size_t k=0;k<size;k++){
+		h^=b[k];
+		h*=16777619u;
+	}
+	return h;
+}
+
+static uint32_t recordChecksum (const ScoreRecord &r)
+{
+	return fnv((const uint8_t*)&r+sizeof r.checksum,sizeof r-sizeof r.checksum);
+}
+
+static uint32_t nameHash (const char *name)
+{
+	return fnv(name,strnlen(name,SCORES_NAME));
+}
+
+void fillScoreRecord (ScoreRecord &r, const char *name, int score, int opponent)
+{
+	memset(&r,0,sizeof r);
+	r.time=time(NULL);
+	r.score=score;
+	r.opponent=opponent;
+	memcpy(r.name,name,strnlen(name,SCORES_NAME));
+}
+
+/* Best score first, then the older record */
+static bool byScore (const ScoreEntry &a, const ScoreEntry &b)
+{
+	if(a.score!=b.score)
+		return a.score>b.score;
+	return a.record<b.record;
+}
+
+static bool byPlayer (const ScoreEntry &a, const ScoreEntry &b)
+{
+	if(a.namehash!=b.namehash)
+		return a.namehash<b.namehash;
+	return byScore(a,b);
+}
+
+static std::string indexPath (const std::string &path)
+{
+	return path+".idx";
+}
+
+static const ScoreRecord &recordAt (const ScoreStore &store, uint32_t k)
+{
+	if(k<store.covered)
+		return ((const ScoreRecord*)((const uint8_t*)store.logmap+sizeof(ScoreLogHeader)))[k];
+	return store.tail[k-store.covered];
+}
+
+static void unmapScores (ScoreStore &store)
+{
+	if(store.indexmap)
+		munmap(store.indexmap,store.indexsize);
+	if(store.logmap)
+		munmap(store.logmap,store.logsize);
+	store.indexmap=store.logmap=NULL;
+	store.indexsize=store.logsize=0;
+	store.byscore=store.byplayer=NULL;
+	store.indexed=store.covered=0;
+}
+
+static uint32_t logId (int fd)
+{
+	ScoreLogHeader h;
+	if(pread(fd,&h,sizeof h,0)!=(ssize_t)sizeof h)
+		return 0;
+	return h.logid;
+}
+
+/* Maps the first covered records of the log */
+static int mapLog (ScoreStore &store, uint32_t covered)
+{
+	store.logsize=sizeof(ScoreLogHeader)+(size_t)covered*sizeof(ScoreRecord);
+	store.logmap=mmap(NULL,store.logsize,PROT_READ,MAP_SHARED,store.fd,0);
+	if(store.logmap==MAP_FAILED){
+		store.logmap=NULL;
+		store.logsize=0;
+		return 0;
+	}
+	store.covered=covered;
+	return 1;
+}
+
+/* A damaged index could point queries past the mapped log */
+static int entriesInLog (const ScoreEntry *entries, size_t count, uint32_t covered)
+{
+	for(size_t k=0;k<count;k++)
+		if(entries[k].record>=covered)
+			return 0;
+	return 1;
+}
+
+static int mapIndex (ScoreStore &store)
+{
+	int fd = open(indexPath(store.path).c_str(),O_RDONLY);
+	if(fd<0)
+		return 0;
+	struct stat st;
+	ScoreIndexHeader h;
+	int ok = fstat(fd,&st)==0 && pread(fd,&h,sizeof h,0)==(ssize_t)sizeof h
+		&& h.magic==SCORES_INDEX_MAGIC && h.version==SCORES_VERSION && h.logid==logId(store.fd)
+		&& h.covered<=store.records && h.count<=h.covered
+		&& (size_t)st.st_size==sizeof h+2*(size_t)h.count*sizeof(ScoreEntry);
+	if(ok){
+		store.indexsize=st.st_size;
+		store.indexmap=mmap(NULL,store.indexsize,PROT_READ,MAP_SHARED,fd,0);
+		if(store.indexmap==MAP_FAILED){
+			store.indexmap=NULL;
+			ok=0;
+		}
+		else
+			ok=entriesInLog((const ScoreEntry*)((const uint8_t*)store.indexmap+sizeof h),2*(size_t)h.count,h.covered);
+	}
+	close(fd);
+	if(!ok || !mapLog(store,h.covered)){
+		unmapScores(store);
+		return 0;
+	}
+	store.byscore=(const ScoreEntry*)((const uint8_t*)store.indexmap+sizeof h);
+	store.byplayer=store.byscore+h.count;
+	store.indexed=h.count;
+	store.damaged=h.covered-h.count;
+	return 1;
+}
+
+/* Sorts the entries appended since the last query into both tail orders */
+static void settleTail (ScoreStore &store)
+{
+	size_t from = store.tailsorted;
+	if(from==store.tailbyscore.size())
+		return;
+	store.tailsorted=store.tailbyscore.size();
+	std::sort(store.tailbyscore.begin()+from,store.tailbyscore.end(),byScore);
+	std::inplace_merge(store.tailbyscore.begin(),store.tailbyscore.begin()+from,store.tailbyscore.end(),byScore);
+	std::sort(store.tailbyplayer.begin()+from,store.tailbyplayer.end(),byPlayer);
+	std::inplace_merge(store.tailbyplayer.begin(),store.tailbyplayer.begin()+from,store.tailbyplayer.end(),byPlayer);
+}
+
+/* Adds tail records from store.covered+store.tail.size() up to count */
+static void addTail (ScoreStore &store, const ScoreRecord *records, size_t count)
+{
+	for(size_t k=0;k<count;k++){
+		const ScoreRecord &r = records[k];
+		uint32_t number = store.covered+store.tail.size();
+		store.tail.push_back(r);
+		if(r.checksum!=recordChecksum(r)){
+			store.damaged++;
+			continue;
+		}
+		ScoreEntry e;
+		e.score=r.score;
+		e.namehash=nameHash(r.name);
+		e.record=number;
+		store.tailbyscore.push_back(e);
+		store.tailbyplayer.push_back(e);
+	}
+}
+
+static void clearTail (ScoreStore &store)
+{
+	store.tail.clear();
+	store.tailbyscore.clear();
+	store.tailbyplayer.clear();
+	store.tailsorted=0;
+}
+
+/* Everything after what the index covers */
+static int readTail (ScoreStore &store)
+{
+	clearTail(store);
+	std::vector<ScoreRecord> records(store.records-store.covered);
+	size_t bytes = records.size()*sizeof(ScoreRecord);
+	off_t at = sizeof(ScoreLogHeader)+(off_t)store.covered*sizeof(ScoreRecord);
+	if(bytes && pread(store.fd,&records[0],bytes,at)!=(ssize_t)bytes)
+		return 0;
+	if(!records.empty())
+		addTail(store,&records[0],records.size());
+	return 1;
+}
+
+static int writeAll (int fd, const void *p, size_t size)
+{
+	const uint8_t *b = (const uint8_t*)p;
+	while(size){
+		ssize_t n = write(fd,b,size);
+		if(n<=0)
+			return 0;
+		b+=n;
+		size-=n;
+	}
+	return 1;
+}
+
+int openScores (ScoreStore &store, const char *path)
+{
+	store.active=0;
+	store.path=path;
+	store.indexmap=store.logmap=NULL;
+	unmapScores(store);
+	clearTail(store);
+	store.records=store.damaged=0;
+	store.fd=open(path,O_RDWR|O_CREAT|O_APPEND,0644);
+	if(store.fd<0){
+		fprintf(stderr,"Scores : cannot open %s\n",path);
+		return 0;
+	}
+	struct stat st;
+	fstat(store.fd,&st);
+	ScoreLogHeader h;
+	if(st.st_size==0){
+		Rng rng = rngStream(clockSeed(),0);
+		h.magic=SCORES_MAGIC;
+		h.version=SCORES_VERSION;
+		h.recordsize=sizeof(ScoreRecord);
+		h.logid=(uint32_t)nextRng(rng);
+		if(!writeAll(store.fd,&h,sizeof h)){
+			fprintf(stderr,"Scores : cannot write %s\n",path);
+			close(store.fd);
+			return 0;
+		}
+		st.st_size=sizeof h;
+	}
+	else if(pread(store.fd,&h,sizeof h,0)!=(ssize_t)sizeof h || h.magic!=SCORES_MAGIC
+		|| h.version!=SCORES_VERSION || h.recordsize!=sizeof(ScoreRecord)){
+		fprintf(stderr,"Scores : %s is not a score log\n",path);
+		close(store.fd);
+		return 0;
+	}
+	size_t body = st.st_size-sizeof h;
+	store.records=body/sizeof(ScoreRecord);
+	/* a crash in the middle of an append */
+	if(body%sizeof(ScoreRecord)){
+		fprintf(stderr,"Scores : cutting a torn record off %s\n",path);
+		if(ftruncate(store.fd,sizeof h+(off_t)store.records*sizeof(ScoreRecord))<0){
+			close(store.fd);
+			return 0;
+		}
+	}
+	store.active=1;
+	if(!mapIndex(store) || !readTail(store) || store.tail.size()>SCORES_TAIL_MAX){
+		if(!indexScores(store)){
+			closeScores(store);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void closeScores (ScoreStore &store)
+{
+	if(!store.active)
+		return;
+	unmapScores(store);
+	clearTail(store);
+	close(store.fd);
+	store.active=0;
+}
+
+int appendScores (ScoreStore &store, ScoreRecord *records, size_t count)
+{
+	if(!store.active || !count)
+		return 0;
+	for(size_t k=0;k<count;k++)
+		records[k].checksum=recordChecksum(records[k]);
+	if(!writeAll(store.fd,records,count*sizeof(ScoreRecord))){
+		fprintf(stderr,"Scores : cannot append to %s\n",store.path.c_str());
+		return 0;
+	}
+	store.records+=count;
+	addTail(store,records,count);
+	return 1;
+}
+
+int appendScore (ScoreStore &store, ScoreRecord &record)
+{
+	return appendScores(store,&record,1);
+}
+
+int indexScores (ScoreStore &store)
+{
+	if(!store.active)
+		return 0;
+	unmapScores(store);
+	clearTail(store);
+	store.damaged=0;
+	if(!mapLog(store,store.records)){
+		fprintf(stderr,"Scores : cannot map %s\n",store.path.c_str());
+		return 0;
+	}
+	const ScoreRecord *records = (const ScoreRecord*)((const uint8_t*)store.logmap+sizeof(ScoreLogHeader));
+	std::vector<ScoreEntry> byscore, byplayer;
+	byscore.reserve(store.records);
+	for(uint32_t k=0;k<store.records;k++){
+		const ScoreRecord &r = records[k];
+		if(r.checksum!=recordChecksum(r)){
+			store.damaged++;
+			continue;
+		}
+		ScoreEntry e;
+		e.score=r.score;
+		e.namehash=nameHash(r.name);
+		e.record=k;
+		byscore.push_back(e);
+	}
+	byplayer=byscore;
+	std::sort(byscore.begin(),byscore.end(),byScore);
+	std::sort(byplayer.begin(),byplayer.end(),byPlayer);
+
+	ScoreIndexHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=SCORES_INDEX_MAGIC;
+	h.version=SCORES_VERSION;
+	h.logid=logId(store.fd);
+	h.count=byscore.size();
+	h.covered=store.records;
+	std::string path = indexPath(store.path);
+	std::string tmp = path+".tmp";
+	int fd = open(tmp.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+	int ok = fd>=0 && writeAll(fd,&h,sizeof h)
+		&& (byscore.empty() || (writeAll(fd,&byscore[0],byscore.size()*sizeof(ScoreEntry))
+			&& writeAll(fd,&byplayer[0],byplayer.size()*sizeof(ScoreEntry))));
+	if(fd>=0)
+		ok = close(fd)==0 && ok;
+	if(!ok || rename(tmp.c_str(),path.c_str())<0){
+		fprintf(stderr,"Scores : cannot write %s\n",path.c_str());
+		return 0;
+	}
+	unmapScores(store);
+	return mapIndex(store);
+}
+
+/* Walks the index and the tail in one order, like a merge */
+struct ScoreCursor{
+	const ScoreEntry *a, *aend;
+	const ScoreEntry *b, *bend;
+	bool (*less)(const ScoreEntry&, const ScoreEntry&);
+};
+
+static const ScoreEntry *nextEntry (ScoreCursor &c)
+{
+	if(c.a<c.aend && (c.b==c.bend || !c.less(*c.b,*c.a)))
+		return c.a++;
+	if(c.b<c.bend)
+		return c.b++;
+	return NULL;
+}
+
+static const ScoreEntry *tailBegin (const std::vector<ScoreEntry> &v)
+{
+	return v.empty() ? NULL : &v[0];
+}
+
+void topScores (ScoreStore &store, int n, std::vector<ScoreRecord> &out)
+{
+	out.clear();
+	if(!store.active)
+		return;
+	settleTail(store);
+	ScoreCursor c;
+	c.a=store.byscore;
+	c.aend=store.byscore+store.indexed;
+	c.b=tailBegin(store.tailbyscore);
+	c.bend=c.b+store.tailbyscore.size();
+	c.less=byScore;
+	const ScoreEntry *e;
+	while((int)out.size()<n && (e=nextEntry(c)))
+		out.push_back(recordAt(store,e->record));
+}
+
+void playerScores (ScoreStore &store, const char *name, int n, std::vector<ScoreRecord> &out)
+{
+	out.clear();
+	if(!store.active)
+		return;
+	settleTail(store);
+	ScoreEntry key;
+	key.namehash=nameHash(name);
+	key.score=0x7fffffff;
+	key.record=0;
+	/* the run of the player's hash, already best first */
+	ScoreCursor c;
+	c.a=std::lower_bound(store.byplayer,store.byplayer+store.indexed,key,byPlayer);
+	c.aend=store.byplayer+store.indexed;
+	c.b=tailBegin(store.tailbyplayer);
+	c.bend=c.b+store.tailbyplayer.size();
+	c.b=std::lower_bound(c.b,c.bend,key,byPlayer);
+	c.less=byPlayer;
+	const ScoreEntry *e;
+	while((int)out.size()<n && (e=nextEntry(c)) && e->namehash==key.namehash){
+		const ScoreRecord &r = recordAt(store,e->record);
+		/* another name with the same hash */
+		if(strncmp(r.name,name,SCORES_NAME)==0)
+			out.push_back(r);
+	}
+}
+
+static bool scoresMore (const ScoreEntry &e, int score)
+{
+	return e.score>score;
+}
+
+uint32_t scoreRank (ScoreStore &store, int score)
+{
+	if(!store.active)
+		return 0;
+	settleTail(store);
+	uint32_t more = std::lower_bound(store.byscore,store.byscore+store.indexed,score,scoresMore)-store.byscore;
+	more+=std::lower_bound(store.tailbyscore.begin(),store.tailbyscore.end(),score,scoresMore)-store.tailbyscore.begin();
+	return more+1;
+}
+
+uint32_t scoreCount (ScoreStore &store)
+{
+	return store.indexed+store.tailbyscore.size();
+}
+
+int compactScores (ScoreStore &store, int keep)
+{
+	if(!store.active)
+		return 0;
+	settleTail(store);
+	/* the best keep of every name, in log order */
+	std::vector<uint32_t> kept;
+	ScoreCursor c;
+	c.a=store.byplayer;
+	c.aend=store.byplayer+store.indexed;
+	c.b=tailBegin(store.tailbyplayer);
+	c.bend=c.b+store.tailbyplayer.size();
+	c.less=byPlayer;
+	std::vector<std::pair<std::string,int> > names;	/* of the current hash */
+	uint32_t hash = 0;
+	const ScoreEntry *e;
+	while((e=nextEntry(c))){
+		if(names.empty() || e->namehash!=hash){
+			names.clear();
+			hash=e->namehash;
+		}
+		const ScoreRecord &r = recordAt(store,e->record);
+		std::string name(r.name,strnlen(r.name,SCORES_NAME));
+		size_t k;
+		for(k=0;k<names.size() && names[k].first!=name;k++);
+		if(k==names.size())
+			names.push_back(std::make_pair(name,0));
+		if(names[k].second++<keep)
+			kept.push_back(e->record);
+	}
+	std::sort(kept.begin(),kept.end());
+
+	std::string tmp = store.path+".tmp";
+	int fd = open(tmp.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+	ScoreLogHeader h;
+	Rng rng = rngStream(clockSeed(),0);
+	h.magic=SCORES_MAGIC;
+	h.version=SCORES_VERSION;
+	h.recordsize=sizeof(ScoreRecord);
+	h.logid=(uint32_t)nextRng(rng);
+	int ok = fd>=0 && writeAll(fd,&h,sizeof h);
+	std::vector<ScoreRecord> batch;
+	for(size_t k=0;ok && k<kept.size();k++){
+		batch.push_back(recordAt(store,kept[k]));
+		if(batch.size()==4096 || k+1==kept.size()){
+			ok=writeAll(fd,&batch[0],batch.size()*sizeof(ScoreRecord));
+			batch.clear();
+		}
+	}
+	if(fd>=0)
+		ok = fsync(fd)==0 && close(fd)==0 && ok;
+	if(!ok || rename(tmp.c_str(),store.path.c_str())<0){
+		fprintf(stderr,"Scores : cannot write %s\n",tmp.c_str());
+		return 0;
+	}
+	/* the new log has a new id, the old index no longer matches it */
+	std::string path = store.path;
+	closeScores(store);
+	return openScores(store,path.c_str());
+}
@@ -0,0 +1,93 @@
+#ifndef SCORES_H
+#define SCORES_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Persistent high scores.
+   The log, <path>, is a header and then fixed size records, only ever
+   appended to, each with the checksum of its own bytes: a record torn by
+   a crash is cut off when the log is next opened and a damaged one is
+   skipped. The index, <path>.idx, holds every record of the log up to
+   some point twice over as 12 byte entries, once sorted by score and once
+   by player then score; it is mmap'd, so a top-N or per-player query
+   reads N entries and N records and no more. Records appended after the
+   index was written are kept in the same two orders in memory, sorted in
+   by the first query after they arrive, until indexScores writes a new
+   index, which openScores does once that tail grows past SCORES_TAIL_MAX.
+   compactScores rewrites the log keeping only each player's best records,
+   which keeps every answer to a query for up to that many records exactly
+   as it was.
+   One process appends at a time; queries from others see what their
+   index and tail held when they opened. */
+
+#define SCORES_MAGIC 0x4c524353u	/* "SCRL" */
+#define SCORES_INDEX_MAGIC 0x49524353u	/* "SCRI" */
+#define SCORES_VERSION 1
+#define SCORES_NAME 24
+#define SCORES_TAIL_MAX 65536	/* unindexed records before open reindexes */
+#define SCORES_KEEP 100		/* per player, by default, when compacting */
+
+struct ScoreRecord{
+	uint32_t checksum;	/* FNV-1a of the rest of the record */
+	uint32_t levelhash;
+	int64_t time;		/* unix seconds at the end of the match */
+	uint64_t seed;
+	int32_t score;
+	int32_t opponent;	/* the other cannon's score */
+	int32_t ticks;
+	uint8_t side;
+	uint8_t control;
+	uint16_t reserved;
+	char name[SCORES_NAME];	/* zero padded, not always terminated */
+};
+
+struct ScoreEntry{
+	int32_t score;
+	uint32_t namehash;
+	uint32_t record;	/* number in the log */
+};
+
+struct ScoreStore{
+	int active;
+	int fd;			/* the log, open for appending */
+	std::string path;
+	uint32_t records;	/* in the log, damaged ones included */
+	uint32_t damaged;
+	/* the mapped index and the part of the log it covers */
+	void *indexmap;
+	size_t indexsize;
+	const ScoreEntry *byscore, *byplayer;
+	uint32_t indexed;	/* entries */
+	uint32_t covered;	/* log records the index covers */
+	void *logmap;
+	size_t logsize;
+	/* appended since */
+	std::vector<ScoreRecord> tail;
+	std::vector<ScoreEntry> tailbyscore, tailbyplayer;
+	size_t tailsorted;	/* entries in order, the rest wait for a query */
+};
+
+void fillScoreRecord (ScoreRecord &r, const char *name, int score, int opponent);
+
+/* Opens or creates the log, cutting off a torn last record, and maps or
+   rebuilds the index. Returns 0 and prints why on failure */
+int openScores (ScoreStore &store, const char *path);
+void closeScores (ScoreStore &store);
+/* Checksums and appends, one write for the lot */
+int appendScores (ScoreStore &store, ScoreRecord *records, size_t count);
+int appendScore (ScoreStore &store, ScoreRecord &record);
+/* Writes the index of the whole log and maps it */
+int indexScores (ScoreStore &store);
+/* Keeps the best keep records of every player, then reindexes */
+int compactScores (ScoreStore &store, int keep);
+
+/* Best first, ties by age */
+void topScores (ScoreStore &store, int n, std::vector<ScoreRecord> &out);
+void playerScores (ScoreStore &store, const char *name, int n, std::vector<ScoreRecord> &out);
+/* 1 + the records scoring more */
+uint32_t scoreRank (ScoreStore &store, int score);
+uint32_t scoreCount (ScoreStore &store);
+
+#endif
@@ -0,0 +1,736 @@
+#include <arpa/inet.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sim.h"
+#include "level.h"
+#include "remote.h"
+#include "scores.h"
+#include "profile.h"
+
+/* Dedicated match server, no GL.
+   The lobby, on the main thread, pairs the players that JOIN its UDP port
+   and hands each new match to the shard with the fewest. A shard is one
+   thread with its own UDP port, an epoll loop and a timerfd at
+   TICKS_PER_SECOND: on every timer expiry it ticks all of its matches
+   with the rules main() plays by and sends each player its state, and in
+   between it takes in the players' inputs. Matches never move between
+   shards and a shard touches only its own, so the shards share nothing
+   but the read only level. The job system is not started, its jobs run
+   inline on the shard that asks.
+   Every --report seconds the lobby prints, per shard, the tick time
+   quantiles, the cost of one match tick, the share of the tick period
+   spent ticking and the timer expiries the shard was too late for.
+   --bots N starts N matches played by the closed form aimers with nobody
+   attached, each restarting when it ends, to measure how many matches a
+   core holds. --scores adds both cannons of every finished match to a
+   high score log, bots included, so a night of bot matches fills it.
+
+   server [--level levels.bin] [--port 7000] [--shards N] [--bots N]
+          [--report 5] [--seconds S] [--scores file] */
+
+#define SERVER_PORT 7000
+#define SERVER_END_TICKS TICKS_PER_SECOND	/* END is repeated this long */
+#define SERVER_BATCH 64		/* datagrams per recvmmsg and sendmmsg */
+
+struct Player{
+	sockaddr_in addr;
+	uint32_t token;
+	uint32_t acked;
+	NetInput input;		/* latest received */
+	NetInput applied;	/* what the game has */
+	double heard;		/* 0 until the first INPUT */
+};
+
+struct Match{
+	uint32_t id;
+	int bots;
+	int started;
+	int endticks;
+	double created;
+	Game game;
+	Player players[2];
+	SpectatorFrame frames[REMOTE_HISTORY];
+};
+
+struct ShardStats{
+	Histogram tick;		/* one pass over every match */
+	Histogram match;	/* one match tick, state sent */
+	long ticks, missed, finished;
+	long in, out, outbytes;
+	uint64_t busy;		/* ns spent ticking */
+};
+
+struct Shard{
+	int index;
+	int sock, port;
+	int epoll, timer, wake;
+	std::thread thread;
+	std::mutex lock;	/* inbox, freed, stats, nmatches and stop */
+	std::vector<Match*> inbox;
+	std::vector<Match*> freed;
+	ShardStats stats;
+	int nmatches;
+	int stop;
+	/* the shard thread's own */
+	std::vector<Match*> matches;
+	std::unordered_map<uint32_t,Match*> byid;
+	std::vector<int> slots;
+	BitWriter writer;
+	/* datagrams of this tick not sent yet, one sendmmsg per SERVER_BATCH */
+	std::vector<uint8_t> outgoing;
+	std::vector<size_t> offsets;
+	std::vector<sockaddr_in> destinations;
+};
+
+/* A paired player, so a repeated JOIN gets its WELCOME again */
+struct Placement{
+	sockaddr_in addr;
+	uint32_t match;
+	int side;
+	int port;
+	uint64_t seed;
+	double when;
+};
+
+static Level level;
+static uint32_t levelhash;
+static GameAssets gameassets;
+static volatile sig_atomic_t stopping = 0;
+static ScoreStore scores;
+static std::mutex scoreslock;
+
+static void onSignal (int)
+{
+	stopping=1;
+}
+
+static int openUdp (int port)
+{
+	int sock = socket(AF_INET,SOCK_DGRAM,0);
+	if(sock<0)
+		return -1;
+	sockaddr_in local;
+	memset(&local,0,sizeof local);
+	local.sin_family=AF_INET;
+	local.sin_addr.s_addr=htonl(INADDR_ANY);
+	local.sin_port=htons(port);
+	if(bind(sock,(sockaddr*)&local,sizeof local)<0){
+		close(sock);
+		return -1;
+	}
+	fcntl(sock,F_SETFL,fcntl(sock,F_GETFL)|O_NONBLOCK);
+	return sock;
+}
+
+static void startMatch (Match &m, uint32_t id, uint64_t seed, int bots)
+{
+	m.id=id;
+	m.bots=bots;
+	m.started=bots;
+	m.endticks=0;
+	m.created=inputClock();
+	m.game=Game();
+	initGame(m.game,gameassets,&level,seed);
+	for(int c=0;c<2;c++){
+		m.game.cannons[c].control=bots ? CONTROL_AUTOAIM : CONTROL_HUMAN;
+		memset(&m.players[c],0,sizeof m.players[c]);
+		m.players[c].acked=SPECTATE_NONE;
+	}
+	for(int k=0;k<REMOTE_HISTORY;k++)
+		m.frames[k].tick=SPECTATE_NONE;
+}
+
+static void header (RemoteHeader &h, int type, const Match &m, int side)
+{
+	memset(&h,0,sizeof h);
+	h.magic=REMOTE_MAGIC;
+	h.type=type;
+	h.side=side;
+	h.match=m.id;
+	h.token=m.players[side].token;
+}
+
+static void flushDatagrams (Shard &s)
+{
+	size_t n = s.destinations.size();
+	if(!n)
+		return;
+	s.offsets.push_back(s.outgoing.size());
+	iovec iov[SERVER_BATCH];
+	mmsghdr msgs[SERVER_BATCH];
+	memset(msgs,0,n*sizeof(mmsghdr));
+	for(size_t k=0;k<n;k++){
+		iov[k].iov_base=&s.outgoing[s.offsets[k]];
+		iov[k].iov_len=s.offsets[k+1]-s.offsets[k];
+		msgs[k].msg_hdr.msg_iov=&iov[k];
+		msgs[k].msg_hdr.msg_iovlen=1;
+		msgs[k].msg_hdr.msg_name=&s.destinations[k];
+		msgs[k].msg_hdr.msg_namelen=sizeof(sockaddr_in);
+	}
+	/* a full socket buffer loses the rest, like any dropped datagram */
+	for(size_t sent=0;sent<n;){
+		int r = sendmmsg(s.sock,msgs+sent,n-sent,0);
+		if(r<=0)
+			break;
+		for(int k=0;k<r;k++){
+			s.stats.out++;
+			s.stats.outbytes+=iov[sent+k].iov_len;
+		}
+		sent+=r;
+	}
+	s.outgoing.clear();
+	s.offsets.clear();
+	s.destinations.clear();
+}
+
+static void queueDatagram (Shard &s, const sockaddr_in &to, const void *head, size_t headsize, const std::vector<uint8_t> *body)
+{
+	s.offsets.push_back(s.outgoing.size());
+	s.destinations.push_back(to);
+	const uint8_t *b = (const uint8_t*)head;
+	s.outgoing.insert(s.outgoing.end(),b,b+headsize);
+	if(body)
+		s.outgoing.insert(s.outgoing.end(),body->begin(),body->end());
+	if(s.destinations.size()==SERVER_BATCH)
+		flushDatagrams(s);
+}
+
+static void sendState (Shard &s, Match &m, const SpectatorFrame &frame)
+{
+	for(int c=0;c<2;c++){
+		Player &p = m.players[c];
+		if(!m.bots && !p.heard)
+			continue;
+		const SpectatorFrame *base = &emptySpectatorFrame();
+		uint32_t acked = m.bots ? frame.tick-1 : p.acked;
+		if(acked!=SPECTATE_NONE && frame.tick-acked<REMOTE_HISTORY
+			&& m.frames[acked&(REMOTE_HISTORY-1)].tick==acked)
+			base=&m.frames[acked&(REMOTE_HISTORY-1)];
+		clearBits(s.writer);
+		encodeFrame(s.writer,frame,*base);
+		flushBits(s.writer);
+		size_t size = sizeof(RemoteHeader)+sizeof(RemoteState)+s.writer.bytes.size();
+		/* too big for one datagram, the player keeps showing its last frame */
+		if(size>REMOTE_MAX_PACKET)
+			continue;
+		/* bots have nobody to send to, the state is encoded all the same */
+		if(m.bots){
+			s.stats.outbytes+=size;
+			continue;
+		}
+		uint8_t head[sizeof(RemoteHeader)+sizeof(RemoteState)];
+		RemoteHeader h;
+		header(h,REMOTE_STATE,m,c);
+		RemoteState st;
+		st.tick=frame.tick;
+		st.basetick=base->tick;
+		memcpy(head,&h,sizeof h);
+		memcpy(head+sizeof h,&st,sizeof st);
+		queueDatagram(s,p.addr,head,sizeof head,&s.writer.bytes);
+	}
+}
+
+static void sendEnd (Shard &s, Match &m)
+{
+	for(int c=0;c<2;c++){
+		if(!m.players[c].heard)
+			continue;
+		uint8_t packet[sizeof(RemoteHeader)+sizeof(RemoteEnd)];
+		RemoteHeader h;
+		header(h,REMOTE_END,m,c);
+		RemoteEnd e;
+		e.scores[0]=m.game.cannons[PLAYER].score;
+		e.scores[1]=m.game.cannons[ENEMY].score;
+		memcpy(packet,&h,sizeof h);
+		memcpy(packet+sizeof h,&e,sizeof e);
+		queueDatagram(s,m.players[c].addr,packet,sizeof packet,NULL);
+	}
+}
+
+static void recordMatch (const Game &game)
+{
+	if(!scores.active)
+		return;
+	ScoreRecord r[2];
+	for(int c=0;c<2;c++){
+		const char *name = game.cannons[c].control==CONTROL_AUTOAIM ? "autoaim" : c==PLAYER ? "player 1" : "player 2";
+		fillScoreRecord(r[c],name,game.cannons[c].score,game.cannons[!c].score);
+		r[c].levelhash=game.levelhash;
+		r[c].seed=game.seed;
+		r[c].ticks=game.ticks;
+		r[c].side=c;
+		r[c].control=game.cannons[c].control;
+	}
+	std::lock_guard<std::mutex> guard(scoreslock);
+	appendScores(scores,r,2);
+}
+
+/* One tick of a match, returns 0 once it is done with */
+static int tickMatch (Shard &s, Match &m, double now)
+{
+	if(m.bots && m.game.over){
+		recordMatch(m.game);
+		startMatch(m,m.id,m.game.seed+1,1);
+		s.stats.finished++;
+	}
+	if(!m.bots){
+		int heard = (m.players[0].heard>0)+(m.players[1].heard>0);
+		/* waits for both players, or plays on with whoever came */
+		if(!m.started && (heard==2 || (heard && now-m.created>REMOTE_TIMEOUT_SECONDS)))
+			m.started=1;
+		if(!m.started)
+			return now-m.created<=REMOTE_WAIT_SECONDS;
+		int quiet = 1;
+		for(int c=0;c<2;c++){
+			if(m.players[c].heard && now-m.players[c].heard<=REMOTE_TIMEOUT_SECONDS)
+				quiet=0;
+		}
+		if(quiet)
+			return 0;
+		if(m.game.over){
+			sendEnd(s,m);
+			return ++m.endticks<SERVER_END_TICKS;
+		}
+		for(int c=0;c<2;c++){
+			Player &p = m.players[c];
+			applyNetInput(m.game,c,p.applied,p.input,m.game.ticks);
+			p.applied=p.input;
+		}
+	}
+	tickGame(m.game,1.0f/TICKS_PER_SECOND);
+	if(!m.bots && m.game.over){
+		recordMatch(m.game);
+		s.stats.finished++;
+	}
+	SpectatorFrame &frame = m.frames[m.game.ticks&(REMOTE_HISTORY-1)];
+	captureFrame(frame,m.game,s.slots);
+	sendState(s,m,frame);
+	return 1;
+}
+
+static void receiveInputs (Shard &s)
+{
+	uint8_t packets[SERVER_BATCH][sizeof(RemoteHeader)+sizeof(RemoteInput)+1];
+	sockaddr_in from[SERVER_BATCH];
+	iovec iov[SERVER_BATCH];
+	mmsghdr msgs[SERVER_BATCH];
+	for(int k=0;k<SERVER_BATCH;k++){
+		iov[k].iov_base=packets[k];
+		iov[k].iov_len=sizeof packets[k];
+		memset(&msgs[k],0,sizeof msgs[k]);
+		msgs[k].msg_hdr.msg_iov=&iov[k];
+		msgs[k].msg_hdr.msg_iovlen=1;
+		msgs[k].msg_hdr.msg_name=&from[k];
+		msgs[k].msg_hdr.msg_namelen=sizeof from[k];
+	}
+	double now = inputClock();
+	int n;
+	while((n=recvmmsg(s.sock,msgs,SERVER_BATCH,0,NULL))>0){
+		for(int k=0;k<n;k++){
+			RemoteHeader h;
+			RemoteInput in;
+			msgs[k].msg_hdr.msg_namelen=sizeof from[k];
+			if(msgs[k].msg_len!=sizeof h+sizeof in)
+				continue;
+			memcpy(&h,packets[k],sizeof h);
+			memcpy(&in,packets[k]+sizeof h,sizeof in);
+			if(h.magic!=REMOTE_MAGIC || h.type!=REMOTE_INPUT || h.side>1)
+				continue;
+			std::unordered_map<uint32_t,Match*>::iterator it = s.byid.find(h.match);
+			if(it==s.byid.end())
+				continue;
+			Player &p = it->second->players[h.side];
+			if(p.token!=h.token)
+				continue;
+			s.stats.in++;
+			p.addr=from[k];
+			p.heard=now;
+			p.input=in.input;
+			/* a late datagram must not move the baseline back */
+			if(in.acked!=SPECTATE_NONE && (p.acked==SPECTATE_NONE || (int32_t)(in.acked-p.acked)>0))
+				p.acked=in.acked;
+		}
+		if(n<SERVER_BATCH)
+			break;
+	}
+}
+
+static void takeInbox (Shard &s)
+{
+	uint64_t count;
+	if(read(s.wake,&count,sizeof count)<0)
+		return;
+	std::lock_guard<std::mutex> guard(s.lock);
+	for(size_t k=0;k<s.inbox.size();k++){
+		s.matches.push_back(s.inbox[k]);
+		s.byid[s.inbox[k]->id]=s.inbox[k];
+	}
+	s.inbox.clear();
+}
+
+static void tickShard (Shard &s)
+{
+	uint64_t expiries;
+	if(read(s.timer,&expiries,sizeof expiries)<0)
+		return;
+	double now = inputClock();
+	uint64_t start = profileClock();
+	std::vector<Match*> done;
+	for(size_t k=0;k<s.matches.size();){
+		Match *m = s.matches[k];
+		uint64_t before = profileClock();
+		int live = tickMatch(s,*m,now);
+		addSample(s.stats.match,profileClock()-before);
+		if(live){
+			k++;
+			continue;
+		}
+		s.byid.erase(m->id);
+		s.matches[k]=s.matches.back();
+		s.matches.pop_back();
+		done.push_back(m);
+	}
+	flushDatagrams(s);
+	uint64_t spent = profileClock()-start;
+	std::lock_guard<std::mutex> guard(s.lock);
+	addSample(s.stats.tick,spent);
+	s.stats.ticks++;
+	/* a late shard drops the ticks it slept through, its matches run slow */
+	s.stats.missed+=expiries-1;
+	s.stats.busy+=spent;
+	s.nmatches=s.matches.size();
+	s.freed.insert(s.freed.end(),done.begin(),done.end());
+}
+
+static void runShard (Shard *shard)
+{
+	Shard &s = *shard;
+	char name[32];
+	snprintf(name,sizeof name,"shard %d",s.index);
+	traceThreadName(name);
+	epoll_event events[3];
+	while(1){
+		int n = epoll_wait(s.epoll,events,3,-1);
+		for(int k=0;k<n;k++){
+			int fd = events[k].data.fd;
+			if(fd==s.wake)
+				takeInbox(s);
+			else if(fd==s.sock)
+				receiveInputs(s);
+			else if(fd==s.timer)
+				tickShard(s);
+		}
+		std::lock_guard<std::mutex> guard(s.lock);
+		if(s.stop)
+			break;
+	}
+	for(size_t k=0;k<s.matches.size();k++)
+		delete s.matches[k];
+	s.matches.clear();
+}
+
+static int openShard (Shard &s, int index, int port)
+{
+	s.index=index;
+	s.port=port;
+	s.sock=openUdp(port);
+	if(s.sock<0){
+		fprintf(stderr,"Server : cannot bind port %d\n",port);
+		return 0;
+	}
+	s.epoll=epoll_create1(0);
+	s.wake=eventfd(0,EFD_NONBLOCK);
+	s.timer=timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK);
+	itimerspec period;
+	memset(&period,0,sizeof period);
+	period.it_interval.tv_nsec=1000000000/TICKS_PER_SECOND;
+	period.it_value=period.it_interval;
+	timerfd_settime(s.timer,0,&period,NULL);
+	int fds[3] = {s.sock, s.wake, s.timer};
+	for(int k=0;k<3;k++){
+		epoll_event e;
+		memset(&e,0,sizeof e);
+		e.events=EPOLLIN;
+		e.data.fd=fds[k];
+		epoll_ctl(s.epoll,EPOLL_CTL_ADD,fds[k],&e);
+	}
+	memset(&s.stats,0,sizeof s.stats);
+	s.nmatches=0;
+	s.stop=0;
+	clearBits(s.writer);
+	s.thread=std::thread(runShard,&s);
+	return 1;
+}
+
+static void wakeShard (Shard &s)
+{
+	uint64_t one = 1;
+	if(write(s.wake,&one,sizeof one)<0)
+		fprintf(stderr,"Server : cannot wake shard %d\n",s.index);
+}
+
+/* The shard with the fewest matches, counting the ones on their way */
+static Shard &pickShard (std::vector<Shard*> &shards)
+{
+	Shard *best = NULL;
+	int fewest = 0;
+	for(size_t k=0;k<shards.size();k++){
+		std::lock_guard<std::mutex> guard(shards[k]->lock);
+		int n = shards[k]->nmatches+shards[k]->inbox.size();
+		if(!best || n<fewest){
+			best=shards[k];
+			fewest=n;
+		}
+	}
+	return *best;
+}
+
+static Match *newMatch (Shard &s)
+{
+	std::lock_guard<std::mutex> guard(s.lock);
+	if(s.freed.empty())
+		return new Match;
+	Match *m = s.freed.back();
+	s.freed.pop_back();
+	return m;
+}
+
+static void handOver (Shard &s, Match *m)
+{
+	{
+		std::lock_guard<std::mutex> guard(s.lock);
+		s.inbox.push_back(m);
+	}
+	wakeShard(s);
+}
+
+static void sendWelcome (int sock, const Placement &p, uint32_t token)
+{
+	uint8_t packet[sizeof(RemoteHeader)+sizeof(RemoteWelcome)];
+	RemoteHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=REMOTE_MAGIC;
+	h.type=REMOTE_WELCOME;
+	h.side=p.side;
+	h.port=p.port;
+	h.match=p.match;
+	h.token=token;
+	RemoteWelcome w;
+	memset(&w,0,sizeof w);
+	w.seed=p.seed;
+	w.levelhash=levelhash;
+	memcpy(packet,&h,sizeof h);
+	memcpy(packet+sizeof h,&w,sizeof w);
+	sendto(sock,packet,sizeof packet,0,(const sockaddr*)&p.addr,sizeof p.addr);
+}
+
+static void report (std::vector<Shard*> &shards, double seconds)
+{
+	long matches = 0;
+	double load = 0;
+	for(size_t k=0;k<shards.size();k++){
+		Shard &s = *shards[k];
+		ShardStats st;
+		int n;
+		{
+			std::lock_guard<std::mutex> guard(s.lock);
+			st=s.stats;
+			n=s.nmatches;
+			memset(&s.stats,0,sizeof s.stats);
+		}
+		double share = seconds>0 ? st.busy*1e-9/seconds : 0;
+		printf("shard %d : %d matches, %.0f ticks/s, tick p50 %.3f p99 %.3f max %.3f ms, match tick p50 %.2f p99 %.2f us, load %.0f%%, %ld missed, %ld finished, %ld in %ld out, %.1f kB/s\n",
+			s.index,n,st.ticks/seconds,histogramQuantile(st.tick,.5)*1e-6,histogramQuantile(st.tick,.99)*1e-6,st.tick.max*1e-6,
+			histogramQuantile(st.match,.5)*1e-3,histogramQuantile(st.match,.99)*1e-3,share*100,st.missed,st.finished,st.in,st.out,st.outbytes/seconds/1000);
+		matches+=n;
+		load+=share;
+	}
+	/* what one core would hold at full load, at this mix of matches */
+	printf("server : %ld matches on %d shards, %.0f matches per core at full load\n",
+		matches,(int)shards.size(),load>0 ? matches/load : 0);
+	fflush(stdout);
+}
+
+int main (int argc, char** argv)
+{
+	const char *levelpath = "levels.bin";
+	int port = SERVER_PORT;
+	int nshards = std::thread::hardware_concurrency();
+	int bots = 0;
+	double every = 5;
+	double seconds = 0;
+	const char *scorespath = NULL;
+	for(int k=1;k+1<argc;k++){
+		if(strcmp(argv[k],"--level")==0)
+			levelpath = argv[k+1];
+		if(strcmp(argv[k],"--port")==0)
+			port = atoi(argv[k+1]);
+		if(strcmp(argv[k],"--shards")==0)
+			nshards = atoi(argv[k+1]);
+		if(strcmp(argv[k],"--bots")==0)
+			bots = atoi(argv[k+1]);
+		if(strcmp(argv[k],"--report")==0)
+			every = atof(argv[k+1]);
+		if(strcmp(argv[k],"--seconds")==0)
+			seconds = atof(argv[k+1]);
+		if(strcmp(argv[k],"--scores")==0)
+			scorespath = argv[k+1];
+	}
+	if(nshards<1)
+		nshards = 1;
+	if(!loadLevel(level,levelpath))
+		return 1;
+	levelhash=levelHash(level);
+	scores.active=0;
+	if(scorespath && !openScores(scores,scorespath))
+		return 1;
+	/* the server never draws, the meshes stay NULL */
+	memset(&gameassets,0,sizeof gameassets);
+
+	int lobby = openUdp(port);
+	if(lobby<0){
+		fprintf(stderr,"Server : cannot bind port %d\n",port);
+		return 1;
+	}
+	signal(SIGINT,onSignal);
+	signal(SIGTERM,onSignal);
+	traceThreadName("lobby");
+	std::vector<Shard*> shards;
+	for(int k=0;k<nshards;k++){
+		Shard *s = new Shard;
+		if(!openShard(*s,k,port+1+k))
+			return 1;
+		shards.push_back(s);
+	}
+	Rng rng = rngStream(clockSeed(),0);
+	uint32_t nextid = 1;
+	for(int k=0;k<bots;k++){
+		Shard &s = *shards[k%nshards];
+		Match *m = newMatch(s);
+		startMatch(*m,nextid++,nextRng(rng),1);
+		handOver(s,m);
+	}
+	printf("server : level %s, lobby on port %d, %d shards on ports %d-%d, %d bot matches\n",
+		levelpath,port,nshards,port+1,port+nshards,bots);
+	fflush(stdout);
+
+	int waiting = 0;
+	Placement pending;
+	memset(&pending,0,sizeof pending);
+	uint32_t pendingtoken = 0;
+	std::unordered_map<uint32_t,Placement> placed;	/* by token */
+	double started = inputClock();
+	double reported = started;
+	int ep = epoll_create1(0);
+	epoll_event e;
+	memset(&e,0,sizeof e);
+	e.events=EPOLLIN;
+	e.data.fd=lobby;
+	epoll_ctl(ep,EPOLL_CTL_ADD,lobby,&e);
+	while(!stopping){
+		epoll_event ready;
+		epoll_wait(ep,&ready,1,100);
+		double now = inputClock();
+		uint8_t packet[64];
+		sockaddr_in from;
+		socklen_t fromsize = sizeof from;
+		ssize_t size;
+		while((size=recvfrom(lobby,packet,sizeof packet,0,(sockaddr*)&from,&fromsize))>0){
+			fromsize=sizeof from;
+			RemoteHeader h;
+			if((size_t)size!=sizeof h)
+				continue;
+			memcpy(&h,packet,sizeof h);
+			if(h.magic!=REMOTE_MAGIC || h.type!=REMOTE_JOIN)
+				continue;
+			std::unordered_map<uint32_t,Placement>::iterator it = placed.find(h.token);
+			if(it!=placed.end()){
+				sendWelcome(lobby,it->second,h.token);
+				continue;
+			}
+			if(waiting && pendingtoken==h.token){
+				pending.when=now;
+				continue;
+			}
+			if(!waiting || now-pending.when>REMOTE_TIMEOUT_SECONDS){
+				waiting=1;
+				pendingtoken=h.token;
+				pending.addr=from;
+				pending.when=now;
+				continue;
+			}
+			/* two players, a match */
+			Shard &s = pickShard(shards);
+			Match *m = newMatch(s);
+			startMatch(*m,nextid++,nextRng(rng),0);
+			uint32_t tokens[2] = {pendingtoken, h.token};
+			sockaddr_in addrs[2] = {pending.addr, from};
+			for(int c=0;c<2;c++){
+				m->players[c].token=tokens[c];
+				Placement p;
+				p.addr=addrs[c];
+				p.match=m->id;
+				p.side=c;
+				p.port=s.port;
+				p.seed=m->game.seed;
+				p.when=now;
+				placed[tokens[c]]=p;
+				sendWelcome(lobby,p,tokens[c]);
+			}
+			handOver(s,m);
+			waiting=0;
+		}
+		for(std::unordered_map<uint32_t,Placement>::iterator it=placed.begin();it!=placed.end();){
+			if(now-it->second.when>REMOTE_TIMEOUT_SECONDS)
+				it=placed.erase(it);
+			else
+				++it;
+		}
+		if(every>0 && now-reported>=every){
+			report(shards,now-reported);
+			reported=now;
+		}
+		if(seconds>0 && now-started>=seconds)
+			break;
+	}
+
+	double now = inputClock();
+	if(now-reported>=1)
+		report(shards,now-reported);
+	for(size_t k=0;k<shards.size();k++){
+		Shard &s = *shards[k];
+		{
+			std::lock_guard<std::mutex> guard(s.lock);
+			s.stop=1;
+		}
+		wakeShard(s);
+		s.thread.join();
+		for(size_t j=0;j<s.freed.size();j++)
+			delete s.freed[j];
+		for(size_t j=0;j<s.inbox.size();j++)
+			delete s.inbox[j];
+		close(s.sock);
+		close(s.timer);
+		close(s.wake);
+		close(s.epoll);
+		delete &s;
+	}
+	closeScores(scores);
+	close(ep);
+	close(lobby);
+	unloadLevel(level);
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "telemetry.h"
+#include "sim.h"
+
+/* Summarises a shot telemetry file, for tuning stages and targets.
+
+   shotstats <file>          per stage and cannon: shots, the share that
+                             hit anything, mean launch angle and charge,
+                             mean flight and bounces; per stage and target
+                             class: hits and points
+   shotstats <file> --csv    every event, one line each */
+
+#define STATS_STAGES 4
+#define STATS_KINDS 16
+
+struct ShotStats{
+	long shots, landed, scored;
+	double angle, charge, flight, bounces;
+};
+
+struct KindStats{
+	long hits, points;
+};
+
+static const char *typeName (int type)
+{
+	switch(type){
+	case TELEMETRY_SHOT: return "shot";
+	case TELEMETRY_HIT: return "hit";
+	case TELEMETRY_END: return "end";
+	}
+	return "?";
+}
+
+static void printCsv (const std::vector<TelemetryEvent> &rows)
+{
+	printf("tick,type,cannon,stage,kind,angle,charge,flight,bounces,hits,points\n");
+	for(size_t k=0;k<rows.size();k++){
+		const TelemetryEvent &e = rows[k];
+		printf("%u,%s,%d,%d,",e.tick,typeName(e.type),e.cannon+1,e.stage+1);
+		if(e.kind==TELEMETRY_NO_KIND)
+			printf(",");
+		else
+			printf("%d,",e.kind);
+		printf("%.2f,%.2f,%u,%d,%d,%d\n",e.angle/100.0,e.charge/100.0,e.flight,e.bounces,e.hits,e.points);
+	}
+}
+
+static void printSummary (const std::vector<TelemetryEvent> &rows)
+{
+	ShotStats shots[STATS_STAGES][2];
+	KindStats kinds[STATS_STAGES][STATS_KINDS];
+	memset(shots,0,sizeof shots);
+	memset(kinds,0,sizeof kinds);
+	for(size_t k=0;k<rows.size();k++){
+		const TelemetryEvent &e = rows[k];
+		if(e.stage>=STATS_STAGES || e.cannon>1)
+			continue;
+		ShotStats &s = shots[e.stage][e.cannon];
+		if(e.type==TELEMETRY_SHOT){
+			s.shots++;
+			s.angle+=e.angle/100.0;
+			s.charge+=e.charge/100.0;
+		}
+		else if(e.type==TELEMETRY_END){
+			s.landed++;
+			s.scored+=e.hits>0;
+			s.flight+=e.flight;
+			s.bounces+=e.bounces;
+		}
+		else if(e.type==TELEMETRY_HIT && e.kind<STATS_KINDS){
+			kinds[e.stage][e.kind].hits++;
+			kinds[e.stage][e.kind].points+=e.points;
+		}
+	}
+	printf("stage player  shots   hit%%  angle charge  flight bounces\n");
+	for(int st=0;st<STATS_STAGES;st++){
+		for(int c=0;c<2;c++){
+			const ShotStats &s = shots[st][c];
+			if(!s.shots && !s.landed)
+				continue;
+			double n = s.shots ? s.shots : 1, m = s.landed ? s.landed : 1;
+			printf("%5d %6d %6ld %5.1f%% %6.1f %6.2f %6.1fs %7.2f\n",st+1,c+1,s.shots,100*s.scored/m,s.angle/n,
+				s.charge/n,s.flight/m/TICKS_PER_SECOND,s.bounces/m);
+		}
+	}
+	printf("stage target   hits points\n");
+	for(int st=0;st<STATS_STAGES;st++){
+		for(int k=0;k<STATS_KINDS;k++){
+			const KindStats &h = kinds[st][k];
+			if(h.hits)
+				printf("%5d %6d %6ld %6ld\n",st+1,k,h.hits,h.points);
+		}
+	}
+}
+
+int main (int argc, char** argv)
+{
+	if(argc<2){
+		fprintf(stderr,"usage: shotstats <file> [--csv]\n");
+		return 1;
+	}
+	TelemetryFileHeader header;
+	std::vector<TelemetryEvent> rows;
+	if(!readTelemetry(argv[1],header,rows)){
+		fprintf(stderr,"shotstats : %s is not a telemetry file\n",argv[1]);
+		return 1;
+	}
+	if(argc>2 && strcmp(argv[2],"--csv")==0){
+		printCsv(rows);
+		return 0;
+	}
+	printf("%s : %d events, seed %llu, level %08x\n",argv[1],(int)rows.size(),(unsigned long long)header.seed,header.levelhash);
+	printSummary(rows);
+	return 0;
+}
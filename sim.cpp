@@ -0,0 +1,752 @@
+#include <cmath>
+#include <cstring>
+
+#include "sim.h"
+#include "jobs.h"
+#include "ai.h"
+#include "telemetry.h"
+#include "arena.h"
+
+#define TARGET_GRAIN 256
+
+enum { HIT_NONE, HIT_PLAYER, HIT_ENEMY };
+
+/* Create an entity drawn with the given mesh, tags may add data components */
+static Entity createProp (World &world, unsigned int tags, VAO *vao, int layer, float x, float y)
+{
+	Entity e = createEntity(world,COMP_TRANSFORM|COMP_MESH|tags);
+	Transform *t = getTransform(world,e);
+	t->x=x;
+	t->y=y;
+	t->rotation=0;
+	RenderMesh *m = getMesh(world,e);
+	m->vao=vao;
+	m->layer=layer;
+	m->visible=1;
+	return e;
+}
+
+/* Create the seven segments of one HUD digit, (x,y) is its top right bar */
+static void createDigit (World &world, const GameAssets &assets, int display, int place, float x, float y)
+{
+	float pos[7][2] = {
+		{x,y}, {x,y-.2f}, {x-.1f,y-.3f}, {x-.2f,y-.2f},
+		{x-.2f,y}, {x-.1f,y+.1f}, {x-.1f,y-.1f}
+	};
+	for(int k=0;k<7;k++){
+		VAO *vao = (k==2 || k==5 || k==6) ? assets.segmenthorizontal : assets.segmentvertical;
+		Entity e = createProp(world,TAG_DIGIT|TAG_SCREEN|COMP_SEGMENT,vao,LAYER_HUD,pos[k][0],pos[k][1]);
+		Segment *seg = getSegment(world,e);
+		seg->display=display;
+		seg->place=place;
+		seg->segment=k;
+	}
+}
+
+static void initCannon (Game &game, const GameAssets &assets, int c, float x, float y, float rotation)
+{
+	Cannon &can = game.cannons[c];
+	can.rect = createProp(game.world,TAG_CANNON|TAG_SCREEN,assets.canonrect[c],LAYER_CANON,x,y);
+	getTransform(game.world,can.rect)->rotation=rotation;
+	can.base = createProp(game.world,TAG_CANNON|TAG_SCREEN,assets.canonbase[c],LAYER_CANONBASE,x,y);
+	can.bullet = createProp(game.world,TAG_PROJECTILE|TAG_SCREEN|COMP_VELOCITY|COMP_COLLIDER,assets.bullet[c],LAYER_BULLET,x,y);
+	getCollider(game.world,can.bullet)->radius=.2;
+	can.theta=0;
+	can.shootflag=0;
+	can.speedflag=0;
+	can.chargepress=0;
+	can.chargebase=0;
+	can.chargecapped=0;
+	can.upflag=0;
+	can.downflag=0;
+	can.dirupflag=0;
+	can.dirdownflag=0;
+	can.inflight=0;
+	can.launchtick=0;
+	can.launchangle=0;
+	can.launchcharge=0;
+	can.bounces=0;
+	can.hits=0;
+	can.score=0;
+	can.control=CONTROL_HUMAN;
+	can.plan.active=0;
+}
+
+void activateObstacles (Game &game, int stage)
+{
+	World &world = game.world;
+	const Level *level = game.level;
+	for(uint32_t k=0;k<level->header->nprops;k++){
+		if(!level->props[k].obstacle)
+			continue;
+		if(level->props[k].stage==stage)
+			queueTags(world,game.props[k],TAG_ACTIVE,0);
+		else
+			queueTags(world,game.props[k],0,TAG_ACTIVE);
+	}
+	flushWorld(world);
+}
+
+/* Make the obstacles of a stage solid and start its spawns */
+static void enterStage (Game &game, int stage)
+{
+	activateObstacles(game,stage);
+	startSpawnLevel(game.world,game.spawner,stage);
+}
+
+void initGame (Game &game, const GameAssets &assets, const Level *level, uint64_t seed)
+{
+	World &world = game.world;
+	game.level=level;
+	game.levelhash=levelHash(*level);
+	game.assets=&assets;
+	game.seed=seed;
+	game.profiler=NULL;
+	game.telemetry=NULL;
+	game.targetbatches=NULL;
+	game.ntargetbatches=0;
+	game.stage=0;
+	game.countdown=level->stages[0].seconds;
+	game.sitechange=0;
+	game.camerax=level->stages[0].originx;
+	game.scrollfrom=0;
+	game.scrollto=0;
+	game.scrollstart=0;
+	game.ticks=0;
+	game.over=0;
+
+	initCannon(game,assets,PLAYER,-9,-2,10);
+	Cannon &player = game.cannons[PLAYER];
+	player.velocity=.5;
+	player.side=-1;
+	player.minangle=10;
+	player.maxangle=80;
+	player.minclamp=10;
+	player.maxclamp=80;
+	player.resetvelocity=0;
+
+	initCannon(game,assets,ENEMY,9,-2,100);
+	Cannon &enemy = game.cannons[ENEMY];
+	enemy.velocity=2.5;
+	enemy.side=1;
+	enemy.minangle=100;
+	enemy.maxangle=170;
+	enemy.minclamp=101;
+	enemy.maxclamp=169;
+	enemy.resetvelocity=1.2;
+	Velocity *v = getVelocity(world,enemy.bullet);
+	v->vx=1;
+	v->vy=1;
+
+	const LevelHeader *h = level->header;
+	game.props.clear();
+	for(uint32_t k=0;k<h->nprops;k++){
+		const LevelProp &p = level->props[k];
+		VAO *vao = k<assets.nprops ? assets.props[k] : NULL;
+		float x = level->stages[p.stage].originx+p.x;
+		if(!p.obstacle){
+			game.props.push_back(createProp(world,TAG_BACKGROUND,vao,p.layer,x,p.y));
+			continue;
+		}
+		Entity e = createProp(world,TAG_OBSTACLE|COMP_COLLIDER,vao,p.layer,x,p.y);
+		Collider *col = getCollider(world,e);
+		col->radius=0;
+		col->halfw=p.length/2;
+		col->halfh=p.breadth/2;
+		game.props.push_back(e);
+	}
+
+	initSpawner(game.spawner,seed);
+	for(uint32_t k=0;k<h->ntargets;k++){
+		const LevelTarget &t = level->targets[k];
+		Shape shape;
+		shape.kind=t.kind;
+		shape.radius=t.radius;
+		shape.length=0;
+		shape.breadth=0;
+		shape.c1=t.c1;
+		shape.c2=t.c2;
+		shape.c3=t.c3;
+		addTargetClass(game.spawner,shape,k<assets.ntargets ? assets.targets[k] : NULL,LAYER_TARGET,t.points);
+	}
+	for(uint32_t k=0;k<h->nstages;k++){
+		SpawnRule &rule = game.spawner.rules[k];
+		rule=level->stages[k].spawn;
+		// spawn ranges are written relative to the stage
+		rule.a+=level->stages[k].originx;
+		if(rule.distribution!=SPAWN_UNIFORM_INT && rule.distribution!=SPAWN_UNIFORM)
+			continue;
+		rule.b+=level->stages[k].originx;
+	}
+	reserveTargets(world,game.spawner,50);
+
+	createDigit(world,assets,DISPLAY_SCORE,0,-7,3);
+	createDigit(world,assets,DISPLAY_SCORE,1,-8,3);
+	createDigit(world,assets,DISPLAY_ENEMYSCORE,0,8,3);
+	createDigit(world,assets,DISPLAY_ENEMYSCORE,1,7,3);
+	createDigit(world,assets,DISPLAY_COUNTDOWN,0,0,3);
+	createDigit(world,assets,DISPLAY_COUNTDOWN,1,-1,3);
+
+	enterStage(game,0);
+}
+
+/* Reports the shot of cannon c, if the match is recorded */
+static void shotEvent (Game &game, int c, int type, int kind, int points)
+{
+	if(!game.telemetry)
+		return;
+	const Cannon &can = game.cannons[c];
+	TelemetryEvent e;
+	e.tick=game.ticks;
+	e.type=type;
+	e.cannon=c;
+	e.stage=game.stage;
+	e.kind=kind;
+	e.bounces=can.bounces<255 ? can.bounces : 255;
+	e.hits=can.hits<255 ? can.hits : 255;
+	e.angle=lrintf(can.launchangle*100);
+	e.charge=lrintf(fminf(fmaxf(can.launchcharge,0),655)*100);
+	e.flight=game.ticks-can.launchtick<65535 ? game.ticks-can.launchtick : 65535;
+	e.points=points;
+	recordTelemetry(*game.telemetry,e);
+}
+
+/* The flight of the last shot is over */
+static void landShot (Game &game, int c)
+{
+	Cannon &can = game.cannons[c];
+	if(!can.inflight)
+		return;
+	shotEvent(game,c,TELEMETRY_END,TELEMETRY_NO_KIND,0);
+	can.inflight=0;
+}
+
+/* Launch the bullet of a cannon along its barrel with the current charge */
+void fire (Game &game, int c)
+{
+	Cannon &can = game.cannons[c];
+	landShot(game,c);
+	float rotation = getTransform(game.world,can.rect)->rotation;
+	can.theta = rotation*M_PI/180.0f;
+	Velocity *v = getVelocity(game.world,can.bullet);
+	v->vx =can.velocity*cos(can.theta);
+	v->vy =can.velocity*sin(can.theta);
+	can.inflight=1;
+	can.launchtick=game.ticks;
+	can.launchangle=rotation;
+	can.launchcharge=can.velocity;
+	can.bounces=0;
+	can.hits=0;
+	shotEvent(game,c,TELEMETRY_SHOT,TELEMETRY_NO_KIND,0);
+}
+
+int reload (Game &game, int c)
+{
+	Cannon &can = game.cannons[c];
+	Velocity *v = getVelocity(game.world,can.bullet);
+	if(v->vx==0)
+		return 0;
+	landShot(game,c);
+	Transform *base = getTransform(game.world,can.base);
+	Transform *b = getTransform(game.world,can.bullet);
+	b->x=base->x;
+	b->y=base->y;
+	v->vx=0;
+	v->vy=0;
+	v->t=0;
+	return 1;
+}
+
+void pressCharge (Game &game, int c, double time)
+{
+	Cannon &can = game.cannons[c];
+	if(reload(game,c)){
+		can.shootflag=0;
+		can.velocity=0;
+	}
+	can.speedflag=1;
+	can.chargepress=time;
+	can.chargebase=can.velocity;
+	can.chargecapped=0;
+}
+
+/* The charge grows with the time the button was held, unless the pulled
+   back bullet reached the edge first, then it stays where the ticks left it */
+void releaseCharge (Game &game, int c, double time)
+{
+	Cannon &can = game.cannons[c];
+	if(can.speedflag && !can.chargecapped && time>can.chargepress)
+		can.velocity = can.chargebase+CHARGE_PER_SECOND*(time-can.chargepress);
+	can.shootflag=1;
+	fire(game,c);
+	can.speedflag=0;
+}
+
+void applyInput (Game &game, const InputEvent &event)
+{
+	Cannon &can = game.cannons[event.cannon];
+	switch(event.type){
+		case INPUT_CHARGE:
+			if(event.value)
+				pressCharge(game,event.cannon,event.time);
+			else
+				releaseCharge(game,event.cannon,event.time);
+			break;
+		case INPUT_UP:
+			can.upflag=event.value;
+			break;
+		case INPUT_DOWN:
+			can.downflag=event.value;
+			break;
+		case INPUT_DIRUP:
+			can.dirupflag=event.value;
+			break;
+		case INPUT_DIRDOWN:
+			can.dirdownflag=event.value;
+			break;
+		case INPUT_AUTOAIM:
+			can.control = can.control==CONTROL_AUTOAIM ? CONTROL_HUMAN : CONTROL_AUTOAIM;
+			break;
+		default:
+			break;
+	}
+}
+
+void startScroll (Game &game, float to)
+{
+	game.scrollfrom=game.camerax;
+	game.scrollto=to;
+	game.scrollstart=game.ticks;
+}
+
+/* Stage transition. Only the camera moves, on a smoothstep over
+   SCROLL_TICKS, so the cost does not depend on the entity count */
+static void scrollLevel (Game &game)
+{
+	int elapsed = game.ticks-game.scrollstart;
+	if(elapsed<SCROLL_TICKS){
+		float p = (float)elapsed/SCROLL_TICKS;
+		game.camerax = game.scrollfrom+(game.scrollto-game.scrollfrom)*p*p*(3-2*p);
+		return;
+	}
+	game.camerax=game.scrollto;
+	game.sitechange=0;
+	enterStage(game,game.stage);
+}
+
+/* Snapshot the bullets and size the scratch for every live target
+   archetype, the caller holds an ArenaScope on the frame arena */
+static void prepareTargetBatches (Game &game)
+{
+	World &world = game.world;
+	Arena &frame = frameArena();
+	game.targetbatches=arenaArray<TargetBatch>(frame,world.archetypes.size());
+	game.ntargetbatches=0;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,COMP_TRANSFORM|COMP_VELOCITY|COMP_COLLIDER|COMP_SCORE|TAG_TARGET|TAG_ACTIVE))
+			continue;
+		TargetBatch &batch = game.targetbatches[game.ntargetbatches++];
+		batch.arch=&arch;
+		for(int c=0;c<2;c++){
+			// bullets live on the screen, targets in the world
+			batch.bullet[c]=*getTransform(world,game.cannons[c].bullet);
+			batch.bullet[c].x+=game.camerax;
+			batch.bulletradius[c]=getCollider(world,game.cannons[c].bullet)->radius;
+		}
+		batch.rows=(int)arch.entities.size();
+		batch.hits=arenaArray<unsigned char>(frame,batch.rows);
+		batch.dropped=arenaArray<unsigned char>(frame,batch.rows);
+		memset(batch.hits,HIT_NONE,batch.rows);
+		memset(batch.dropped,0,batch.rows);
+	}
+}
+
+/* Squared distance against the summed radii */
+static int bulletHits (const Transform &bullet, float bulletradius, const Transform &target, const Collider &targetcol)
+{
+	float reach = bulletradius+targetcol.radius;
+	float dx = bullet.x-target.x;
+	float dy = bullet.y-target.y;
+	return dx*dx+dy*dy <= reach*reach;
+}
+
+static void collideTargetJob (void *data, int begin, int end)
+{
+	TargetBatch *batch = (TargetBatch*)data;
+	Archetype &arch = *batch->arch;
+	for(int r=begin;r<end;r++){
+		if(bulletHits(batch->bullet[PLAYER],batch->bulletradius[PLAYER],arch.transforms[r],arch.colliders[r]))
+			batch->hits[r]=HIT_PLAYER;
+		else if(bulletHits(batch->bullet[ENEMY],batch->bulletradius[ENEMY],arch.transforms[r],arch.colliders[r]))
+			batch->hits[r]=HIT_ENEMY;
+	}
+}
+
+/* Targets rise and fall on y=-4+5t-t^2, hit ones are left to the resolve step */
+static void moveTargetJob (void *data, int begin, int end)
+{
+	TargetBatch *batch = (TargetBatch*)data;
+	Archetype &arch = *batch->arch;
+	for(int r=begin;r<end;r++){
+		if(batch->hits[r]!=HIT_NONE)
+			continue;
+		Velocity &v = arch.velocities[r];
+		v.t+=.05;
+		arch.transforms[r].y=-4+5*v.t + (-1)*v.t*v.t;
+		if(arch.transforms[r].y<=-6)
+			batch->dropped[r]=1;
+	}
+}
+
+static void collideTargetBatches (Game &game, JobCounter *collided)
+{
+	for(int k=0;k<game.ntargetbatches;k++)
+		parallelFor(collided,NULL,game.targetbatches[k].rows,TARGET_GRAIN,collideTargetJob,&game.targetbatches[k]);
+}
+
+/* A hit scores the target, bounces the bullet back by restitution and launches a replacement */
+static void resolveTargetHits (Game &game, float restitution)
+{
+	World &world = game.world;
+	for(int k=0;k<game.ntargetbatches;k++){
+		TargetBatch &batch = game.targetbatches[k];
+		Archetype &arch = *batch.arch;
+		for(int r=0;r<batch.rows;r++){
+			if(batch.hits[r]==HIT_NONE)
+				continue;
+			int c = batch.hits[r]==HIT_PLAYER ? PLAYER : ENEMY;
+			Cannon &shooter = game.cannons[c];
+			shooter.score+=arch.scores[r].points;
+			shooter.hits++;
+			shotEvent(game,c,TELEMETRY_HIT,arch.scores[r].kind,arch.scores[r].points);
+			getVelocity(world,shooter.bullet)->vx*=restitution;
+			arch.transforms[r].y=-5;
+			despawnTarget(world,game.spawner,arch.entities[r]);
+			requestSpawn(game.spawner,1);
+		}
+	}
+}
+
+/* Targets that dropped out of the field are replaced by fresh ones */
+static void respawnTargets (Game &game)
+{
+	for(int k=0;k<game.ntargetbatches;k++){
+		TargetBatch &batch = game.targetbatches[k];
+		Archetype &arch = *batch.arch;
+		for(int r=0;r<batch.rows;r++){
+			if(!batch.dropped[r])
+				continue;
+			despawnTarget(game.world,game.spawner,arch.entities[r]);
+			requestSpawn(game.spawner,1);
+		}
+	}
+}
+
+/* Collision only, used before the frame is drawn */
+static void collideTargets (Game &game, float restitution)
+{
+	ArenaScope scratch(frameArena());
+	JobCounter collided;
+	prepareTargetBatches(game);
+	collideTargetBatches(game,&collided);
+	waitJobs(&collided);
+	resolveTargetHits(game,restitution);
+	flushSpawner(game.world,game.spawner);
+	flushWorld(game.world);
+}
+
+/* Collision, then trajectories as jobs that depend on it. The calling
+   thread resolves the hits while the workers move the targets */
+static void updateTargets (Game &game, float restitution)
+{
+	ArenaScope scratch(frameArena());
+	JobCounter collided, moved;
+	prepareTargetBatches(game);
+	collideTargetBatches(game,&collided);
+	for(int k=0;k<game.ntargetbatches;k++)
+		parallelFor(&moved,&collided,game.targetbatches[k].rows,TARGET_GRAIN,moveTargetJob,&game.targetbatches[k]);
+	waitJobs(&collided);
+	resolveTargetHits(game,restitution);
+	waitJobs(&moved);
+	respawnTargets(game);
+	flushSpawner(game.world,game.spawner);
+	flushWorld(game.world);
+}
+
+/* Level 2 walls bounce bullets back */
+static void collideObstacles (Game &game)
+{
+	World &world = game.world;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,COMP_TRANSFORM|COMP_COLLIDER|TAG_OBSTACLE|TAG_ACTIVE))
+			continue;
+		for(size_t r=0;r<arch.entities.size();r++){
+			Transform &wall = arch.transforms[r];
+			Collider &col = arch.colliders[r];
+			for(int c=0;c<2;c++){
+				Transform *b = getTransform(world,game.cannons[c].bullet);
+				if(fabs(b->x+game.camerax-wall.x)<=col.halfw && b->y<=wall.y+col.halfh){
+					getVelocity(world,game.cannons[c].bullet)->vx*=-.8;
+					game.cannons[c].bounces++;
+				}
+			}
+		}
+	}
+}
+
+/* One step of a flying bullet, formerly shoot() and enemyshoot() */
+static void shoot (Game &game, int c)
+{
+	Cannon &can = game.cannons[c];
+	Transform *bullet = getTransform(game.world,can.bullet);
+	Velocity *v = getVelocity(game.world,can.bullet);
+	Transform *base = getTransform(game.world,can.base);
+	float sx = v->vx*v->t;
+	float sy = v->vy*v->t + (-5)*v->t*v->t;
+	bullet->x = bullet->x+sx;
+	bullet->y = bullet->y+sy;
+	if(bullet->x>=10 || bullet->y<=-4 || bullet->x<=-10){
+		v->t=0;can.velocity=can.resetvelocity;
+		can.shootflag=0;
+		bullet->x=base->x;
+		bullet->y=base->y;
+		landShot(game,c);
+	}
+	// bounce off the ground with the same launch velocity
+	if(bullet->y<=-3.5){
+		bullet->y=-3.5;
+		can.velocity=can.velocity*.9;
+		can.bounces++;
+		v->t=0.01;
+	}
+}
+
+struct StrayBatch{
+	Archetype *arch;
+	float camerax;
+};
+
+/* Projectiles without a cannon, only the stress mode makes them. They
+   fly like shoot() and bounce forever, leaving one side of the field
+   they come back on the other */
+static void flyStrayJob (void *data, int begin, int end)
+{
+	StrayBatch *batch = (StrayBatch*)data;
+	Archetype &arch = *batch->arch;
+	for(int r=begin;r<end;r++){
+		Transform &b = arch.transforms[r];
+		Velocity &v = arch.velocities[r];
+		b.x+=v.vx*v.t;
+		b.y+=v.vy*v.t + (-5)*v.t*v.t;
+		if(b.x>=batch->camerax+10)
+			b.x-=20;
+		else if(b.x<=batch->camerax-10)
+			b.x+=20;
+		if(b.y<=-3.5){
+			b.y=-3.5;
+			v.t=0.01;
+		}
+		v.t+=0.01;
+	}
+}
+
+static void flyStrays (Game &game)
+{
+	World &world = game.world;
+	ArenaScope scratch(frameArena());
+	StrayBatch *batches = arenaArray<StrayBatch>(scratch.arena,world.archetypes.size());
+	int nbatches = 0;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,COMP_TRANSFORM|COMP_VELOCITY|TAG_PROJECTILE,TAG_SCREEN) || arch.entities.empty())
+			continue;
+		StrayBatch &batch = batches[nbatches++];
+		batch.arch=&arch;
+		batch.camerax=game.camerax;
+	}
+	if(!nbatches)
+		return;
+	ProfileScope scope(game.profiler,PHASE_PROJECTILES);
+	JobCounter flown;
+	for(int k=0;k<nbatches;k++)
+		parallelFor(&flown,NULL,(int)batches[k].arch->entities.size(),TARGET_GRAIN,flyStrayJob,&batches[k]);
+	waitJobs(&flown);
+}
+
+int aimShot (Game &game, int c, float maxspeed, AimShot &shot)
+{
+	World &world = game.world;
+	ArenaScope scratch(frameArena());
+	int count = 0;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		if(archetypeMatches(world.archetypes[a],COMP_TRANSFORM|COMP_VELOCITY|TAG_TARGET|TAG_ACTIVE))
+			count+=(int)world.archetypes[a].entities.size();
+	}
+	float *aimx = arenaArray<float>(scratch.arena,count);
+	float *aimt = arenaArray<float>(scratch.arena,count);
+	int n = 0;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,COMP_TRANSFORM|COMP_VELOCITY|TAG_TARGET|TAG_ACTIVE))
+			continue;
+		for(size_t r=0;r<arch.entities.size();r++,n++){
+			aimx[n]=arch.transforms[r].x-game.camerax;
+			aimt[n]=arch.velocities[r].t;
+		}
+	}
+	Cannon &can = game.cannons[c];
+	Transform *base = getTransform(world,can.base);
+	AimLimits limits;
+	limits.minangle=can.minangle;
+	limits.maxangle=can.maxangle;
+	limits.maxspeed=maxspeed;
+	limits.maxframes=400;
+	return aimBatch(base->x,base->y,aimx,aimt,count,limits,shot)>=0;
+}
+
+/* Fire from the base with the given barrel angle and charge */
+static void launch (Game &game, int c, float angle, float charge)
+{
+	Cannon &can = game.cannons[c];
+	Transform *base = getTransform(game.world,can.base);
+	Transform *bullet = getTransform(game.world,can.bullet);
+	bullet->x=base->x;
+	bullet->y=base->y;
+	getVelocity(game.world,can.bullet)->t=0;
+	getTransform(game.world,can.rect)->rotation=angle;
+	can.velocity=charge;
+	fire(game,c);
+	can.shootflag=1;
+	can.speedflag=0;
+}
+
+void autoAim (Game &game, int c)
+{
+	if(game.cannons[c].shootflag==1)
+		return;
+	AimShot shot;
+	if(aimShot(game,c,AI_MAX_CHARGE,shot))
+		launch(game,c,shot.angle,shot.speed);
+}
+
+/* Play a planned turn: move, then aim and fire from the base */
+static void followPlan (Game &game, int c)
+{
+	Cannon &can = game.cannons[c];
+	if(!can.plan.active)
+		return;
+	if(can.plan.moveframes>0){
+		can.upflag = can.plan.dir>0;
+		can.downflag = can.plan.dir<0;
+		can.plan.moveframes--;
+		return;
+	}
+	can.upflag=0;
+	can.downflag=0;
+	can.plan.active=0;
+	AimShot shot;
+	if(can.plan.aim && aimShot(game,c,PLAN_MAX_CHARGE,shot))
+		launch(game,c,shot.angle,shot.speed);
+	else
+		launch(game,c,can.plan.angle,can.plan.charge);
+}
+
+/* Charge, movement, barrel rotation and bullet flight of one cannon */
+static void stepCannon (Game &game, int c)
+{
+	Cannon &can = game.cannons[c];
+	World &world = game.world;
+	if(can.control==CONTROL_AUTOAIM)
+		autoAim(game,c);
+	else if(can.control==CONTROL_PLAN)
+		followPlan(game,c);
+
+	Transform *bullet = getTransform(world,can.bullet);
+	Transform *canonbase = getTransform(world,can.base);
+	Transform *canonrect = getTransform(world,can.rect);
+	if(can.speedflag==1){
+		if(can.side*bullet->x<=9.9){
+			can.velocity = can.velocity + CHARGE_PER_SECOND/TICKS_PER_SECOND;
+			can.theta = canonrect->rotation*M_PI/180.0f;
+			bullet->x = bullet->x+-.05*cos(can.theta);
+			bullet->y = bullet->y+-.05*sin(can.theta);
+		}
+		else
+			can.chargecapped=1;
+	}
+	if(can.upflag==1){
+		bullet->y+=.1;
+		canonbase->y+=.1;
+		canonrect->y+=.1;
+	}
+	if(can.downflag==1){
+		bullet->y-=.1;
+		canonbase->y-=.1;
+		canonrect->y-=.1;
+	}
+	if(can.dirupflag==1){
+		canonrect->rotation+=2;
+		if(canonrect->rotation>=can.maxangle){
+			canonrect->rotation=can.maxclamp;
+		}
+	}
+	if(can.dirdownflag==1){
+		canonrect->rotation-=2;
+		if(canonrect->rotation<=can.minangle){
+			canonrect->rotation=can.minclamp;
+		}
+	}
+	if(can.shootflag==1){
+		ProfileScope scope(game.profiler,PHASE_PROJECTILES);
+		shoot(game,c);
+		getVelocity(world,can.bullet)->t+=0.01;
+	}
+}
+
+void beginTick (Game &game)
+{
+	if(game.sitechange==1){
+		ProfileScope scope(game.profiler,PHASE_SCROLL);
+		scrollLevel(game);
+	}
+	ProfileScope scope(game.profiler,PHASE_COLLISION);
+	collideTargets(game,-1);
+}
+
+void endTick (Game &game, float dt)
+{
+	{
+		ProfileScope scope(game.profiler,PHASE_COLLISION);
+		collideObstacles(game);
+	}
+	{
+		ProfileScope scope(game.profiler,PHASE_TARGETS);
+		tickSpawner(game.spawner,dt);
+		updateTargets(game,-.8);
+	}
+	stepCannon(game,PLAYER);
+	stepCannon(game,ENEMY);
+	flyStrays(game);
+
+	ProfileScope scope(game.profiler,PHASE_COUNTDOWN);
+	game.ticks++;
+	if(game.ticks%TICKS_PER_SECOND==0){
+		game.countdown--;
+		if(game.countdown==0 && game.stage+1>=(int)game.level->header->nstages)
+			game.over=1;
+		else if(game.countdown==0){
+			game.stage++;
+			game.sitechange=1;
+			game.countdown=game.level->stages[game.stage].seconds;
+			startScroll(game,game.level->stages[game.stage].originx);
+		}
+	}
+}
+
+void tickGame (Game &game, float dt)
+{
+	beginTick(game);
+	endTick(game,dt);
+}
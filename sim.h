@@ -0,0 +1,175 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "ecs.h"
+#include "spawner.h"
+#include "ai.h"
+#include "level.h"
+#include "input.h"
+#include "profile.h"
+
+struct Telemetry;
+
+/* Game rules without any GL or GLFW.
+   A Game holds the complete state of one match and is a plain value, so
+   planners, replays and servers can copy it and step the copy with the
+   exact rules main() plays by. */
+
+#define TICKS_PER_SECOND 60
+/* Charge gained per second of holding the button, .2 a tick */
+#define CHARGE_PER_SECOND (.2f*TICKS_PER_SECOND)
+
+/* The camera eases from one stage of the level to the next in SCROLL_TICKS */
+#define SCROLL_TICKS 40
+
+/* Autopilot charge cap, a held button reaches it in 30 frames */
+#define AI_MAX_CHARGE 6
+/* Charge cap of planned turns */
+#define PLAN_MAX_CHARGE 8
+
+/* Draw order of the render system */
+enum {
+	LAYER_LAND,
+	LAYER_SKY,
+	LAYER_SEA,
+	LAYER_TREEBASE,
+	LAYER_TREE,
+	LAYER_CANON,
+	LAYER_CANONBASE,
+	LAYER_BULLET,
+	LAYER_TARGET,
+	LAYER_OBSTACLE,
+	LAYER_HUD
+};
+
+/* HUD seven segment displays */
+enum {
+	DISPLAY_SCORE,
+	DISPLAY_ENEMYSCORE,
+	DISPLAY_COUNTDOWN
+};
+
+enum {
+	PLAYER,
+	ENEMY
+};
+
+/* Cannon controllers */
+enum {
+	CONTROL_HUMAN,
+	CONTROL_AUTOAIM,
+	CONTROL_PLAN
+};
+
+/* A planned turn: hold up/down for moveframes, then fire at angle with
+   charge, or with the aimShot() solution of that moment if aim is set */
+struct Plan{
+	int active;
+	int moveframes;
+	int dir;
+	int aim;
+	float angle;
+	float charge;
+};
+
+struct Cannon{
+	Entity rect, base, bullet;
+	float velocity;		/* charge */
+	float theta;
+	int shootflag;
+	int speedflag;		/* charging */
+	double chargepress;	/* input time of the press */
+	float chargebase;	/* charge when it was pressed */
+	int chargecapped;	/* the bullet was pulled back to the edge */
+	int upflag, downflag;
+	int dirupflag, dirdownflag;
+	int score;
+	int control;
+	Plan plan;
+	/* the shot in the air, for telemetry */
+	int inflight;
+	int launchtick;
+	float launchangle;	/* degrees */
+	float launchcharge;
+	int bounces, hits;
+	/* per side differences of the original player/enemy code */
+	float side;		/* -1 left cannon, +1 right cannon */
+	float minangle, maxangle;
+	float minclamp, maxclamp;
+	float resetvelocity;
+};
+
+/* Meshes the entities are drawn with, all NULL when running headless.
+   props and targets follow the records of the level file */
+struct GameAssets{
+	VAO *canonrect[2], *canonbase[2], *bullet[2];
+	VAO *segmentvertical, *segmenthorizontal;
+	VAO **props, **targets;	/* in the level arena */
+	uint32_t nprops, ntargets;
+};
+
+/* Scratch shared by the target jobs, one entry per row of an active
+   target archetype, in the frame arena for the length of the step */
+struct TargetBatch{
+	Archetype *arch;
+	Transform bullet[2];
+	float bulletradius[2];
+	int rows;
+	unsigned char *hits;
+	unsigned char *dropped;
+};
+
+struct Game{
+	World world;
+	Spawner spawner;
+	Cannon cannons[2];
+	const Level *level;	/* shared, read only */
+	uint32_t levelhash;
+	const GameAssets *assets;	/* shared, read only */
+	std::vector<Entity> props;	/* one per level prop */
+	uint64_t seed;
+	int stage;
+	int countdown;
+	int sitechange;	/* 1 while scrolling to the stage */
+	/* world x at the centre of the screen */
+	float camerax;
+	float scrollfrom, scrollto;
+	int scrollstart;
+	int ticks;
+	int over;
+	TargetBatch *targetbatches;	/* frame arena, only valid inside a tick */
+	int ntargetbatches;
+	Profiler *profiler;	/* NULL unless this match is profiled */
+	Telemetry *telemetry;	/* NULL unless this match's shots are recorded */
+};
+
+void initGame (Game &game, const GameAssets &assets, const Level *level, uint64_t seed);
+
+/* Cannon input */
+void fire (Game &game, int c);
+/* Put a bullet that is still flying back on its cannon, returns 1 if it did */
+int reload (Game &game, int c);
+void pressCharge (Game &game, int c, double time);
+void releaseCharge (Game &game, int c, double time);
+/* Applies one queued input event, at the start of a tick */
+void applyInput (Game &game, const InputEvent &event);
+
+/* Ease the camera to world x, used for the level transition */
+void startScroll (Game &game, float to);
+/* Make the obstacles of a stage solid, and only those */
+void activateObstacles (Game &game, int stage);
+
+/* The two halves of a tick, main() draws and polls input in between */
+void beginTick (Game &game);
+void endTick (Game &game, float dt);
+void tickGame (Game &game, float dt);
+
+/* Closed form shot of cannon c at the earliest reachable target, 0 if none */
+int aimShot (Game &game, int c, float maxspeed, AimShot &shot);
+/* Fires the aimShot() shot if there is one and the cannon is loaded */
+void autoAim (Game &game, int c);
+
+#endif
@@ -0,0 +1,449 @@
+#include <cstdio>
+#include <cstring>
+
+#include "snapshot.h"
+
+/* Everything of a Game that is neither a vector nor shared */
+struct SnapshotGame{
+	uint64_t seed;
+	int32_t stage, countdown, sitechange;
+	float camerax, scrollfrom, scrollto;
+	int32_t scrollstart, ticks, over;
+	Cannon cannons[2];
+	Rng spawnrng;
+	SpawnRule rules[MAX_SPAWN_LEVELS];
+	int32_t spawnlevel, nextclass, active, requested;
+	float accumulator;
+	uint32_t narchetypes, nclasses;
+};
+
+struct SnapshotMesh{
+	int32_t vao;		/* index into the GameAssets, -1 for none */
+	int32_t layer;
+	int32_t visible;
+};
+
+struct SnapshotClass{
+	Shape shape;
+	int32_t vao;
+	int32_t layer;
+	int32_t points;
+};
+
+/* Meshes are numbered canonrect, canonbase and bullet of each cannon,
+   the two segments, then the level's props and targets */
+#define MESH_FIXED 8
+
+static VAO *meshAt (const GameAssets &assets, int index)
+{
+	if(index<0)
+		return NULL;
+	if(index<2)
+		return assets.canonrect[index];
+	if(index<4)
+		return assets.canonbase[index-2];
+	if(index<6)
+		return assets.bullet[index-4];
+	if(index==6)
+		return assets.segmentvertical;
+	if(index==7)
+		return assets.segmenthorizontal;
+	index-=MESH_FIXED;
+	if(index<(int)assets.nprops)
+		return assets.props[index];
+	index-=assets.nprops;
+	return index<(int)assets.ntargets ? assets.targets[index] : NULL;
+}
+
+static int meshIndex (const GameAssets &assets, VAO *vao)
+{
+	if(!vao)
+		return -1;
+	int count = MESH_FIXED+assets.nprops+assets.ntargets;
+	for(int k=0;k<count;k++){
+		if(meshAt(assets,k)==vao)
+			return k;
+	}
+	return -1;
+}
+
+static void put (std::vector<uint8_t> &out, const void *p, size_t size)
+{
+	const uint8_t *b = (const uint8_t*)p;
+	out.insert(out.end(),b,b+size);
+}
+
+template <class T> static void putColumn (std::vector<uint8_t> &out, const std::vector<T> &column)
+{
+	uint32_t n = column.size();
+	put(out,&n,sizeof n);
+	if(n)
+		put(out,&column[0],n*sizeof(T));
+}
+
+struct SnapshotReader{
+	const uint8_t *p, *end;
+	int bad;
+};
+
+static void take (SnapshotReader &r, void *p, size_t size)
+{
+	if(r.bad || (size_t)(r.end-r.p)<size){
+		r.bad=1;
+		return;
+	}
+	memcpy(p,r.p,size);
+	r.p+=size;
+}
+
+template <class T> static void takeColumn (SnapshotReader &r, std::vector<T> &column)
+{
+	uint32_t n = 0;
+	take(r,&n,sizeof n);
+	if(r.bad || (size_t)(r.end-r.p)/sizeof(T)<n){
+		r.bad=1;
+		return;
+	}
+	column.resize(n);
+	if(n)
+		take(r,&column[0],n*sizeof(T));
+}
+
+/* Whether count records of size bytes can still follow, checked before
+   anything is sized by a count from the bytes */
+static int fits (const SnapshotReader &r, uint32_t count, size_t size)
+{
+	return !r.bad && count<=(size_t)(r.end-r.p)/size;
+}
+
+/* A column is as long as the entities or empty, by the mask */
+static int columnFits (const Archetype &arch, unsigned int bit, size_t size)
+{
+	return size==((arch.mask&bit) ? arch.entities.size() : 0);
+}
+
+/* The ECS indexes with every record and row, so a world that came from
+   damaged bytes must agree with itself before it is used */
+static int worldConsistent (const World &world)
+{
+	size_t rows = 0;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		const Archetype &arch = world.archetypes[a];
+		rows+=arch.entities.size();
+		if(!columnFits(arch,COMP_TRANSFORM,arch.transforms.size()) || !columnFits(arch,COMP_VELOCITY,arch.velocities.size())
+			|| !columnFits(arch,COMP_SHAPE,arch.shapes.size()) || !columnFits(arch,COMP_MESH,arch.meshes.size())
+			|| !columnFits(arch,COMP_COLLIDER,arch.colliders.size()) || !columnFits(arch,COMP_SCORE,arch.scores.size())
+			|| !columnFits(arch,COMP_SEGMENT,arch.segments.size()))
+			return 0;
+	}
+	/* every live record holds the row of its own entity, and there are
+	   as many as rows, so every row belongs to exactly one record */
+	for(size_t k=0;k<world.records.size();k++){
+		const EntityRecord &rec = world.records[k];
+		if(rec.generation>0xff)
+			return 0;
+		if(rec.archetype<0)
+			continue;
+		if((size_t)rec.archetype>=world.archetypes.size())
+			return 0;
+		const Archetype &arch = world.archetypes[rec.archetype];
+		if(rec.row<0 || (size_t)rec.row>=arch.entities.size()
+			|| arch.entities[rec.row]!=(k|rec.generation<<ENTITY_INDEX_BITS))
+			return 0;
+		if(rows--==0)
+			return 0;
+	}
+	if(rows)
+		return 0;
+	for(size_t k=0;k<world.freeindices.size();k++){
+		if(world.freeindices[k]>=world.records.size())
+			return 0;
+	}
+	/* only tags are queued, a queued component would strip a live row */
+	for(size_t k=0;k<world.pending.size();k++){
+		if((world.pending[k].add|world.pending[k].remove)&COMP_DATA_MASK)
+			return 0;
+	}
+	return 1;
+}
+
+/* Whether e is alive and has every bit of mask */
+static int entityHas (const World &world, Entity e, unsigned int mask)
+{
+	return (entityMask(world,e)&mask)==mask;
+}
+
+/* The tick reaches the cannons' entities and the spawner's dead targets
+   without looking, and the props by the level's prop index */
+static int handlesConsistent (const Game &game)
+{
+	const World &world = game.world;
+	unsigned int drawn = COMP_TRANSFORM|COMP_MESH;
+	for(int c=0;c<2;c++){
+		const Cannon &can = game.cannons[c];
+		if(!entityHas(world,can.rect,drawn) || !entityHas(world,can.base,drawn)
+			|| !entityHas(world,can.bullet,drawn|COMP_VELOCITY|COMP_COLLIDER))
+			return 0;
+	}
+	const std::vector<Entity> &freelist = game.spawner.freelist;
+	for(size_t k=0;k<freelist.size();k++){
+		if(!entityHas(world,freelist[k],drawn|COMP_VELOCITY|COMP_SHAPE|COMP_COLLIDER|COMP_SCORE|TAG_TARGET))
+			return 0;
+	}
+	return game.props.size()==game.level->header->nprops;
+}
+
+size_t saveSnapshot (std::vector<uint8_t> &out, const Game &game)
+{
+	const GameAssets &assets = *game.assets;
+	const World &world = game.world;
+	const Spawner &spawner = game.spawner;
+	out.clear();
+	SnapshotHeader h;
+	memset(&h,0,sizeof h);
+	put(out,&h,sizeof h);
+
+	SnapshotGame g;
+	memset(&g,0,sizeof g);
+	g.seed=game.seed;
+	g.stage=game.stage;
+	g.countdown=game.countdown;
+	g.sitechange=game.sitechange;
+	g.camerax=game.camerax;
+	g.scrollfrom=game.scrollfrom;
+	g.scrollto=game.scrollto;
+	g.scrollstart=game.scrollstart;
+	g.ticks=game.ticks;
+	g.over=game.over;
+	memcpy(g.cannons,game.cannons,sizeof g.cannons);
+	g.spawnrng=spawner.rng;
+	memcpy(g.rules,spawner.rules,sizeof g.rules);
+	g.spawnlevel=spawner.level;
+	g.nextclass=spawner.nextclass;
+	g.active=spawner.active;
+	g.requested=spawner.requested;
+	g.accumulator=spawner.accumulator;
+	g.narchetypes=world.archetypes.size();
+	g.nclasses=spawner.classes.size();
+	put(out,&g,sizeof g);
+	for(size_t k=0;k<spawner.classes.size();k++){
+		const TargetClass &c = spawner.classes[k];
+		SnapshotClass sc;
+		memset(&sc,0,sizeof sc);
+		sc.shape=c.shape;
+		sc.vao=meshIndex(assets,c.vao);
+		sc.layer=c.layer;
+		sc.points=c.points;
+		put(out,&sc,sizeof sc);
+	}
+	putColumn(out,spawner.freelist);
+	putColumn(out,game.props);
+
+	putColumn(out,world.records);
+	putColumn(out,world.freeindices);
+	putColumn(out,world.pending);
+	for(size_t a=0;a<world.archetypes.size();a++){
+		const Archetype &arch = world.archetypes[a];
+		put(out,&arch.mask,sizeof arch.mask);
+		putColumn(out,arch.entities);
+		putColumn(out,arch.transforms);
+		putColumn(out,arch.velocities);
+		putColumn(out,arch.shapes);
+		putColumn(out,arch.colliders);
+		putColumn(out,arch.scores);
+		putColumn(out,arch.segments);
+		/* rows of an archetype mostly share a mesh, look each up once */
+		uint32_t n = arch.meshes.size();
+		put(out,&n,sizeof n);
+		VAO *last = NULL;
+		int lastindex = -1;
+		for(uint32_t r=0;r<n;r++){
+			const RenderMesh &m = arch.meshes[r];
+			if(m.vao!=last || r==0){
+				last=m.vao;
+				lastindex=meshIndex(assets,m.vao);
+			}
+			SnapshotMesh sm;
+			sm.vao=lastindex;
+			sm.layer=m.layer;
+			sm.visible=m.visible;
+			put(out,&sm,sizeof sm);
+		}
+	}
+
+	h.magic=SNAPSHOT_MAGIC;
+	h.version=SNAPSHOT_VERSION;
+	h.size=out.size();
+	h.levelhash=game.levelhash;
+	h.ticks=game.ticks;
+	memcpy(&out[0],&h,sizeof h);
+	return out.size();
+}
+
+int restoreSnapshot (Game &game, const uint8_t *bytes, size_t size)
+{
+	SnapshotHeader h;
+	if(size<sizeof h)
+		return 0;
+	memcpy(&h,bytes,sizeof h);
+	if(h.magic!=SNAPSHOT_MAGIC || h.version!=SNAPSHOT_VERSION || h.size!=size || h.levelhash!=game.levelhash)
+		return 0;
+	const GameAssets &assets = *game.assets;
+	World &world = game.world;
+	Spawner &spawner = game.spawner;
+	SnapshotReader r;
+	r.p=bytes+sizeof h;
+	r.end=bytes+size;
+	r.bad=0;
+
+	SnapshotGame g;
+	take(r,&g,sizeof g);
+	/* the tick indexes the level's stages, the rules and the classes with these */
+	int nstages = game.level->header->nstages;
+	if(r.bad || g.stage<0 || g.stage>=nstages || g.spawnlevel<0 || g.spawnlevel>=nstages
+		|| g.nclasses<1 || g.nclasses>MAX_TARGET_CLASSES || g.nextclass<0 || (uint32_t)g.nextclass>=g.nclasses)
+		return 0;
+	game.seed=g.seed;
+	game.stage=g.stage;
+	game.countdown=g.countdown;
+	game.sitechange=g.sitechange;
+	game.camerax=g.camerax;
+	game.scrollfrom=g.scrollfrom;
+	game.scrollto=g.scrollto;
+	game.scrollstart=g.scrollstart;
+	game.ticks=g.ticks;
+	game.over=g.over;
+	memcpy(game.cannons,g.cannons,sizeof g.cannons);
+	spawner.rng=g.spawnrng;
+	memcpy(spawner.rules,g.rules,sizeof g.rules);
+	spawner.level=g.spawnlevel;
+	spawner.nextclass=g.nextclass;
+	spawner.active=g.active;
+	spawner.requested=g.requested;
+	spawner.accumulator=g.accumulator;
+	if(!fits(r,g.nclasses,sizeof(SnapshotClass)))
+		return 0;
+	spawner.classes.resize(g.nclasses);
+	for(uint32_t k=0;k<g.nclasses;k++){
+		SnapshotClass sc;
+		take(r,&sc,sizeof sc);
+		TargetClass &c = spawner.classes[k];
+		c.shape=sc.shape;
+		c.vao=meshAt(assets,sc.vao);
+		c.layer=sc.layer;
+		c.points=sc.points;
+	}
+	takeColumn(r,spawner.freelist);
+	takeColumn(r,game.props);
+
+	takeColumn(r,world.records);
+	takeColumn(r,world.freeindices);
+	takeColumn(r,world.pending);
+	/* an archetype is at least its mask and eight column lengths */
+	if(!fits(r,g.narchetypes,sizeof(unsigned int)+8*sizeof(uint32_t)))
+		return 0;
+	world.archetypes.resize(g.narchetypes);
+	for(uint32_t a=0;a<g.narchetypes && !r.bad;a++){
+		Archetype &arch = world.archetypes[a];
+		take(r,&arch.mask,sizeof arch.mask);
+		takeColumn(r,arch.entities);
+		takeColumn(r,arch.transforms);
+		takeColumn(r,arch.velocities);
+		takeColumn(r,arch.shapes);
+		takeColumn(r,arch.colliders);
+		takeColumn(r,arch.scores);
+		takeColumn(r,arch.segments);
+		uint32_t n = 0;
+		take(r,&n,sizeof n);
+		if(!fits(r,n,sizeof(SnapshotMesh))){
+			r.bad=1;
+			break;
+		}
+		arch.meshes.resize(n);
+		int lastindex = -2;
+		VAO *last = NULL;
+		for(uint32_t k=0;k<n;k++){
+			SnapshotMesh sm;
+			take(r,&sm,sizeof sm);
+			if(sm.vao!=lastindex){
+				lastindex=sm.vao;
+				last=meshAt(assets,sm.vao);
+			}
+			RenderMesh &m = arch.meshes[k];
+			m.vao=last;
+			m.layer=sm.layer;
+			m.visible=sm.visible;
+		}
+	}
+	/* scratch of the tick, rebuilt before use */
+	game.targetbatches=NULL;
+	game.ntargetbatches=0;
+	return !r.bad && worldConsistent(world) && handlesConsistent(game);
+}
+
+void clearSnapshotRing (SnapshotRing &ring)
+{
+	for(int k=0;k<SNAPSHOT_RING;k++)
+		ring.ticks[k]=-1;
+}
+
+void pushSnapshot (SnapshotRing &ring, const Game &game)
+{
+	int slot = game.ticks&(SNAPSHOT_RING-1);
+	saveSnapshot(ring.slots[slot],game);
+	ring.ticks[slot]=game.ticks;
+}
+
+int restoreSnapshotTick (SnapshotRing &ring, Game &game, int tick)
+{
+	int slot = tick&(SNAPSHOT_RING-1);
+	if(ring.ticks[slot]!=tick)
+		return 0;
+	return restoreSnapshot(game,&ring.slots[slot][0],ring.slots[slot].size());
+}
+
+/* FNV-1a */
+static uint32_t checksum (const uint8_t *bytes, size_t size)
+{
+	uint32_t h = 2166136261u;
+	for(size_t k=0;k<size;k++){
+		h^=bytes[k];
+		h*=16777619u;
+	}
+	return h;
+}
+
+int writeSnapshotFile (const char *path, const std::vector<uint8_t> &bytes)
+{
+	if(bytes.size()<sizeof(SnapshotHeader))
+		return 0;
+	SnapshotHeader h;
+	memcpy(&h,&bytes[0],sizeof h);
+	h.checksum=checksum(&bytes[sizeof h],bytes.size()-sizeof h);
+	char tmp[1024];
+	snprintf(tmp,sizeof tmp,"%s.tmp",path);
+	FILE *out = fopen(tmp,"wb");
+	if(!out)
+		return 0;
+	int ok = fwrite(&h,sizeof h,1,out)==1
+		&& fwrite(&bytes[sizeof h],1,bytes.size()-sizeof h,out)==bytes.size()-sizeof h;
+	ok = fclose(out)==0 && ok;
+	return ok && rename(tmp,path)==0;
+}
+
+int readSnapshotFile (const char *path, std::vector<uint8_t> &bytes)
+{
+	FILE *in = fopen(path,"rb");
+	if(!in)
+		return 0;
+	SnapshotHeader h;
+	int ok = fread(&h,sizeof h,1,in)==1 && h.magic==SNAPSHOT_MAGIC && h.size>=sizeof h;
+	if(ok){
+		bytes.resize(h.size);
+		memcpy(&bytes[0],&h,sizeof h);
+		ok = fread(&bytes[sizeof h],1,h.size-sizeof h,in)==h.size-sizeof h
+			&& checksum(&bytes[sizeof h],h.size-sizeof h)==h.checksum;
+	}
+	fclose(in);
+	return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+
+/* Flat game state snapshots.
+   saveSnapshot writes the whole match, every archetype column, the entity
+   records, the spawner and both cannons, into one byte buffer of counted
+   runs with no pointers in it: meshes are stored as their index in the
+   GameAssets and the level as its hash. The buffer can be copied, kept in
+   a ring, written to disk or handed to another thread and restored into
+   any Game made by initGame on the same level and assets. Restoring
+   assigns into the vectors the Game already has, so once a Game has held
+   a state of that size a restore is a run of memcpys that allocates
+   nothing. */
+
+#define SNAPSHOT_MAGIC 0x50414e53u	/* "SNAP" */
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_RING 16	/* power of two */
+
+struct SnapshotHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		/* header included */
+	uint32_t levelhash;
+	uint32_t checksum;	/* of the bytes after the header, only kept by files */
+	int32_t ticks;
+};
+
+/* The last SNAPSHOT_RING ticks, for rollback */
+struct SnapshotRing{
+	std::vector<uint8_t> slots[SNAPSHOT_RING];
+	int ticks[SNAPSHOT_RING];	/* -1 when empty */
+};
+
+/* Replaces out with the snapshot of game, returns its size */
+size_t saveSnapshot (std::vector<uint8_t> &out, const Game &game);
+/* Returns 0, leaving game untouched, if the header is not that of a
+   snapshot of game's level */
+int restoreSnapshot (Game &game, const uint8_t *bytes, size_t size);
+
+void clearSnapshotRing (SnapshotRing &ring);
+/* Saves game under its tick */
+void pushSnapshot (SnapshotRing &ring, const Game &game);
+/* Restores the snapshot taken at tick, 0 if it is no longer in the ring */
+int restoreSnapshotTick (SnapshotRing &ring, Game &game, int tick);
+
+/* Written to path.tmp and renamed over path, so a crash mid write
+   leaves the previous file whole */
+int writeSnapshotFile (const char *path, const std::vector<uint8_t> &bytes);
+/* Reads and checks the checksum */
+int readSnapshotFile (const char *path, std::vector<uint8_t> &bytes);
+
+#endif
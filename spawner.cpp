@@ -0,0 +1,129 @@
+#include "spawner.h"
+
+#define TARGET_MASK (COMP_TRANSFORM|COMP_MESH|COMP_VELOCITY|COMP_SHAPE|COMP_COLLIDER|COMP_SCORE|TAG_TARGET)
+
+void initSpawner (Spawner &spawner, uint64_t seed)
+{
+	spawner.rng=rngStream(seed,RNG_STREAM_SPAWN);
+	spawner.freelist.clear();
+	spawner.classes.clear();
+	for(int k=0;k<MAX_SPAWN_LEVELS;k++){
+		SpawnRule &rule = spawner.rules[k];
+		rule.initial=0;
+		rule.maxactive=1<<30;
+		rule.rate=0;
+		rule.distribution=SPAWN_UNIFORM_INT;
+		rule.a=0;
+		rule.b=0;
+		rule.y=-4;
+	}
+	spawner.level=0;
+	spawner.nextclass=0;
+	spawner.active=0;
+	spawner.requested=0;
+	spawner.accumulator=0;
+}
+
+void addTargetClass (Spawner &spawner, const Shape &shape, VAO *vao, int layer, int points)
+{
+	TargetClass c;
+	c.shape=shape;
+	c.vao=vao;
+	c.layer=layer;
+	c.points=points;
+	spawner.classes.push_back(c);
+}
+
+static Entity createTarget (World &world, Spawner &spawner)
+{
+	Entity e = createEntity(world,TARGET_MASK);
+	int kind = spawner.nextclass;
+	TargetClass &c = spawner.classes[kind];
+	spawner.nextclass=(spawner.nextclass+1)%spawner.classes.size();
+	*getShape(world,e)=c.shape;
+	getCollider(world,e)->radius=c.shape.radius;
+	getScore(world,e)->points=c.points;
+	getScore(world,e)->kind=kind;
+	RenderMesh *m = getMesh(world,e);
+	m->vao=c.vao;
+	m->layer=c.layer;
+	m->visible=1;
+	return e;
+}
+
+void reserveTargets (World &world, Spawner &spawner, int count)
+{
+	while((int)spawner.freelist.size()+spawner.active<count)
+		spawner.freelist.push_back(createTarget(world,spawner));
+}
+
+float spawnX (Rng &rng, const SpawnRule &rule)
+{
+	switch(rule.distribution){
+		case SPAWN_UNIFORM_INT:
+			return rule.a+(int)rngRange(rng,(int)rule.b-(int)rule.a+1);
+		case SPAWN_UNIFORM:
+			return rule.a+(rule.b-rule.a)*rngFloat(rng);
+		case SPAWN_NORMAL:
+			return rule.a+rule.b*rngNormal(rng);
+		default:
+			return rule.a;
+	}
+}
+
+void despawnTarget (World &world, Spawner &spawner, Entity e)
+{
+	queueTags(world,e,0,TAG_ACTIVE);
+	spawner.freelist.push_back(e);
+	spawner.active--;
+}
+
+void requestSpawn (Spawner &spawner, int count)
+{
+	spawner.requested+=count;
+}
+
+void tickSpawner (Spawner &spawner, float dt)
+{
+	spawner.accumulator+=dt*spawner.rules[spawner.level].rate;
+	while(spawner.accumulator>=1){
+		spawner.accumulator-=1;
+		spawner.requested++;
+	}
+}
+
+void flushSpawner (World &world, Spawner &spawner)
+{
+	const SpawnRule &rule = spawner.rules[spawner.level];
+	while(spawner.requested>0){
+		spawner.requested--;
+		if(spawner.active>=rule.maxactive)
+			continue;
+		Entity e;
+		if(spawner.freelist.empty())
+			e=createTarget(world,spawner);
+		else{
+			e=spawner.freelist.back();
+			spawner.freelist.pop_back();
+		}
+		Transform *t = getTransform(world,e);
+		t->x=spawnX(spawner.rng,rule);
+		t->y=rule.y;
+		t->rotation=0;
+		Velocity *v = getVelocity(world,e);
+		v->vx=0;
+		v->vy=0;
+		v->t=0;
+		queueTags(world,e,TAG_ACTIVE,0);
+		spawner.active++;
+	}
+}
+
+void startSpawnLevel (World &world, Spawner &spawner, int level)
+{
+	spawner.level=level;
+	spawner.accumulator=0;
+	requestSpawn(spawner,spawner.rules[level].initial);
+	flushSpawner(world,spawner);
+	flushWorld(world);
+}
@@ -0,0 +1,72 @@
+#ifndef SPAWNER_H
+#define SPAWNER_H
+
+#include <vector>
+
+#include "ecs.h"
+#include "rng.h"
+
+/* Target spawner.
+   Live targets are the rows of the TAG_TARGET|TAG_ACTIVE archetype, dead
+   ones wait on a free list, so spawning and despawning are O(1) and the
+   pool grows on demand instead of being capped at a fixed slot count. */
+
+#define MAX_TARGET_CLASSES 8
+#define MAX_SPAWN_LEVELS 4
+
+/* How spawn x positions are drawn */
+enum {
+	SPAWN_UNIFORM_INT,	/* integer in [a,b] */
+	SPAWN_UNIFORM,		/* real in [a,b) */
+	SPAWN_NORMAL		/* mean a, standard deviation b */
+};
+
+struct SpawnRule{
+	int initial;		/* targets alive when the level starts */
+	int maxactive;
+	float rate;		/* extra targets per second on top of replacements */
+	int distribution;
+	float a, b;
+	float y;		/* launch height */
+};
+
+/* Look of one target class, new targets cycle through the classes */
+struct TargetClass{
+	Shape shape;
+	VAO *vao;
+	int layer;
+	int points;
+};
+
+struct Spawner{
+	Rng rng;
+	std::vector<Entity> freelist;
+	std::vector<TargetClass> classes;
+	SpawnRule rules[MAX_SPAWN_LEVELS];
+	int level;
+	int nextclass;
+	int active;
+	int requested;
+	float accumulator;
+};
+
+void initSpawner (Spawner &spawner, uint64_t seed);
+void addTargetClass (Spawner &spawner, const Shape &shape, VAO *vao, int layer, int points);
+/* Grow the pool to at least count targets */
+void reserveTargets (World &world, Spawner &spawner, int count);
+/* Switch rules and spawn the initial targets of the level */
+void startSpawnLevel (World &world, Spawner &spawner, int level);
+
+/* Safe while a system iterates: the despawn is queued on the world and the
+   replacement is only created by flushSpawner */
+void despawnTarget (World &world, Spawner &spawner, Entity e);
+void requestSpawn (Spawner &spawner, int count);
+/* Adds the rate driven spawns for dt seconds */
+void tickSpawner (Spawner &spawner, float dt);
+/* Creates the requested targets; call outside of any archetype iteration,
+   before flushWorld */
+void flushSpawner (World &world, Spawner &spawner);
+
+float spawnX (Rng &rng, const SpawnRule &rule);
+
+#endif
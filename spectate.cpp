@@ -0,0 +1,667 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "spectate.h"
+
+#define SPECTATE_TARGET_MASK (COMP_TRANSFORM|COMP_VELOCITY|COMP_SHAPE|COMP_SCORE|TAG_TARGET|TAG_ACTIVE)
+
+enum {
+	TARGET_UPDATE,
+	TARGET_NEW,
+	TARGET_REMOVE
+};
+
+static int32_t quantize (float v, int scale)
+{
+	return (int32_t)lrintf(v*scale);
+}
+
+static void clearFrame (SpectatorFrame &frame)
+{
+	frame.tick=SPECTATE_NONE;
+	frame.camerax=0;
+	frame.stage=0;
+	frame.sitechange=0;
+	frame.countdown=0;
+	frame.scores[0]=frame.scores[1]=0;
+	memset(frame.cannons,0,sizeof frame.cannons);
+	frame.targets.clear();
+}
+
+/* The baseline of a spectator that has nothing yet */
+const SpectatorFrame &emptySpectatorFrame ()
+{
+	static SpectatorFrame empty;
+	static int made = 0;
+	if(!made){
+		clearFrame(empty);
+		made=1;
+	}
+	return empty;
+}
+
+void captureFrame (SpectatorFrame &frame, Game &game, std::vector<int> &slots)
+{
+	World &world = game.world;
+	frame.tick=game.ticks;
+	frame.camerax=quantize(game.camerax,SPECTATE_POS_SCALE);
+	frame.stage=game.stage;
+	frame.sitechange=game.sitechange;
+	frame.countdown=game.countdown;
+	for(int c=0;c<2;c++){
+		Cannon &can = game.cannons[c];
+		frame.scores[c]=can.score;
+		SpectatorCannon &sc = frame.cannons[c];
+		Transform *rect = getTransform(world,can.rect);
+		Transform *bullet = getTransform(world,can.bullet);
+		sc.y=quantize(rect->y,SPECTATE_POS_SCALE);
+		sc.rotation=quantize(rect->rotation,SPECTATE_ROT_SCALE);
+		sc.bulletx=quantize(bullet->x,SPECTATE_POS_SCALE);
+		sc.bullety=quantize(bullet->y,SPECTATE_POS_SCALE);
+	}
+
+	/* rows land in entity index order through slots, no sort needed */
+	slots.assign(world.records.size(),-1);
+	std::vector<SpectatorTarget> &rows = frame.targets;
+	rows.clear();
+	for(size_t a=0;a<world.archetypes.size();a++){
+		const Archetype &arch = world.archetypes[a];
+		if(!archetypeMatches(arch,SPECTATE_TARGET_MASK))
+			continue;
+		for(size_t r=0;r<arch.entities.size();r++){
+			SpectatorTarget t;
+			t.id=arch.entities[r]&ENTITY_INDEX_MASK;
+			/* spectators refuse ids past the cap, such a target goes unseen */
+			if(t.id>=SPECTATE_MAX_TARGETS)
+				continue;
+			t.kind=arch.scores[r].kind;
+			t.x=quantize(arch.transforms[r].x,SPECTATE_POS_SCALE);
+			t.t=quantize(arch.velocities[r].t,SPECTATE_T_SCALE);
+			slots[t.id]=rows.size();
+			rows.push_back(t);
+		}
+	}
+	std::vector<SpectatorTarget> sorted;
+	sorted.reserve(rows.size());
+	for(size_t id=0;id<slots.size();id++){
+		if(slots[id]>=0)
+			sorted.push_back(rows[slots[id]]);
+	}
+	rows.swap(sorted);
+}
+
+static void writeDelta (BitWriter &w, int32_t now, int32_t was)
+{
+	writeBits(w,now!=was,1);
+	if(now!=was)
+		writeSigned(w,now-was);
+}
+
+static int32_t readDelta (BitReader &r, int32_t was)
+{
+	return readBits(r,1) ? was+readSigned(r) : was;
+}
+
+static void writeTargetRecord (BitWriter &w, uint32_t id, int64_t &previd, int op)
+{
+	writeBits(w,1,1);
+	writeVar(w,(uint32_t)(id-previd-1));
+	writeBits(w,op,2);
+	previd=id;
+}
+
+void encodeFrame (BitWriter &w, const SpectatorFrame &frame, const SpectatorFrame &base)
+{
+	writeDelta(w,frame.camerax,base.camerax);
+	writeDelta(w,frame.stage,base.stage);
+	writeDelta(w,frame.sitechange,base.sitechange);
+	writeDelta(w,frame.countdown,base.countdown);
+	for(int c=0;c<2;c++){
+		writeDelta(w,frame.scores[c],base.scores[c]);
+		const SpectatorCannon &now = frame.cannons[c];
+		const SpectatorCannon &was = base.cannons[c];
+		writeDelta(w,now.y,was.y);
+		writeDelta(w,now.rotation,was.rotation);
+		writeDelta(w,now.bulletx,was.bulletx);
+		writeDelta(w,now.bullety,was.bullety);
+	}
+
+	/* a target in both is expected one step further per tick */
+	int32_t steps = base.tick==SPECTATE_NONE ? 0 : (int32_t)(frame.tick-base.tick);
+	const std::vector<SpectatorTarget> &now = frame.targets;
+	const std::vector<SpectatorTarget> &was = base.targets;
+	int64_t previd = -1;
+	size_t i = 0, j = 0;
+	while(i<now.size() || j<was.size()){
+		if(j>=was.size() || (i<now.size() && now[i].id<was[j].id)){
+			writeTargetRecord(w,now[i].id,previd,TARGET_NEW);
+			/* levels and snapshots hold at most MAX_TARGET_CLASSES classes */
+			writeBits(w,now[i].kind,3);
+			writeSigned(w,now[i].x);
+			writeSigned(w,now[i].t);
+			i++;
+		}
+		else if(i>=now.size() || was[j].id<now[i].id){
+			writeTargetRecord(w,was[j].id,previd,TARGET_REMOVE);
+			j++;
+		}
+		else{
+			const SpectatorTarget &a = now[i], &b = was[j];
+			if(a.kind!=b.kind){
+				writeTargetRecord(w,a.id,previd,TARGET_NEW);
+				writeBits(w,a.kind,3);
+				writeSigned(w,a.x);
+				writeSigned(w,a.t);
+			}
+			else if(a.x!=b.x || a.t!=b.t+steps){
+				writeTargetRecord(w,a.id,previd,TARGET_UPDATE);
+				writeDelta(w,a.x,b.x);
+				writeSigned(w,a.t-(b.t+steps));
+			}
+			i++;
+			j++;
+		}
+	}
+	writeBits(w,0,1);
+}
+
+int decodeFrame (BitReader &r, SpectatorFrame &frame, const SpectatorFrame &base)
+{
+	frame.camerax=readDelta(r,base.camerax);
+	frame.stage=readDelta(r,base.stage);
+	frame.sitechange=readDelta(r,base.sitechange);
+	frame.countdown=readDelta(r,base.countdown);
+	for(int c=0;c<2;c++){
+		frame.scores[c]=readDelta(r,base.scores[c]);
+		SpectatorCannon &now = frame.cannons[c];
+		const SpectatorCannon &was = base.cannons[c];
+		now.y=readDelta(r,was.y);
+		now.rotation=readDelta(r,was.rotation);
+		now.bulletx=readDelta(r,was.bulletx);
+		now.bullety=readDelta(r,was.bullety);
+	}
+
+	int32_t steps = base.tick==SPECTATE_NONE ? 0 : (int32_t)(frame.tick-base.tick);
+	const std::vector<SpectatorTarget> &was = base.targets;
+	std::vector<SpectatorTarget> &now = frame.targets;
+	now.clear();
+	size_t j = 0;
+	int64_t previd = -1;
+	while(readBits(r,1) && !r.overrun){
+		/* the mirror sizes its table by the ids */
+		int64_t next = previd+1+readVar(r);
+		if(next>=SPECTATE_MAX_TARGETS)
+			return 0;
+		uint32_t id = (uint32_t)next;
+		int op = readBits(r,2);
+		previd=id;
+		/* the ones without a record flew on as expected */
+		for(;j<was.size() && was[j].id<id;j++){
+			now.push_back(was[j]);
+			now.back().t+=steps;
+		}
+		int inbase = j<was.size() && was[j].id==id;
+		SpectatorTarget t;
+		t.id=id;
+		if(op==TARGET_NEW){
+			t.kind=readBits(r,3);
+			t.x=readSigned(r);
+			t.t=readSigned(r);
+			now.push_back(t);
+		}
+		else if(op==TARGET_UPDATE && inbase){
+			t.kind=was[j].kind;
+			t.x=readDelta(r,was[j].x);
+			t.t=was[j].t+steps+readSigned(r);
+			now.push_back(t);
+		}
+		else if(op!=TARGET_REMOVE || !inbase)
+			return 0;
+		if(inbase)
+			j++;
+	}
+	for(;j<was.size();j++){
+		now.push_back(was[j]);
+		now.back().t+=steps;
+	}
+	return !r.overrun;
+}
+
+/* Length prefixed messages */
+static void appendMessage (std::vector<char> &out, const void *head, size_t headsize, const std::vector<uint8_t> *body)
+{
+	uint32_t size = headsize+(body ? body->size() : 0);
+	const char *p = (const char*)&size;
+	out.insert(out.end(),p,p+4);
+	p=(const char*)head;
+	out.insert(out.end(),p,p+headsize);
+	if(body)
+		out.insert(out.end(),body->begin(),body->end());
+}
+
+/* Sends what the socket takes, returns 0 once the peer is gone */
+static int flushPending (int sock, std::vector<char> &pending)
+{
+	while(!pending.empty()){
+		ssize_t sent = send(sock,&pending[0],pending.size(),MSG_NOSIGNAL);
+		if(sent<0)
+			return errno==EAGAIN || errno==EWOULDBLOCK;
+		pending.erase(pending.begin(),pending.begin()+sent);
+	}
+	return 1;
+}
+
+/* Appends what arrived to in, returns 0 once the peer is gone */
+static int receiveBytes (int sock, std::vector<char> &in)
+{
+	char buffer[4096];
+	for(;;){
+		ssize_t size = recv(sock,buffer,sizeof buffer,0);
+		if(size>0){
+			in.insert(in.end(),buffer,buffer+size);
+			continue;
+		}
+		return size<0 && (errno==EAGAIN || errno==EWOULDBLOCK);
+	}
+}
+
+/* Takes the first complete message off in, 0 if there is none yet */
+static int nextMessage (std::vector<char> &in, std::vector<char> &message)
+{
+	if(in.size()<4)
+		return 0;
+	uint32_t size;
+	memcpy(&size,&in[0],4);
+	if(in.size()<4+size)
+		return 0;
+	message.assign(in.begin()+4,in.begin()+4+size);
+	in.erase(in.begin(),in.begin()+4+size);
+	return 1;
+}
+
+static int unixAddress (sockaddr_un &address, const char *path)
+{
+	memset(&address,0,sizeof address);
+	address.sun_family=AF_UNIX;
+	if(strlen(path)>=sizeof address.sun_path){
+		fprintf(stderr,"Spectate : socket path %s is too long\n",path);
+		return 0;
+	}
+	strcpy(address.sun_path,path);
+	return 1;
+}
+
+int openSpectators (Spectators &s, const char *path, uint32_t levelhash)
+{
+	s.active=0;
+	sockaddr_un address;
+	if(!unixAddress(address,path))
+		return 0;
+	s.listener=socket(AF_UNIX,SOCK_STREAM,0);
+	if(s.listener<0){
+		fprintf(stderr,"Spectate : cannot create a socket\n");
+		return 0;
+	}
+	unlink(path);
+	if(bind(s.listener,(sockaddr*)&address,sizeof address)<0 || listen(s.listener,16)<0){
+		fprintf(stderr,"Spectate : cannot listen on %s\n",path);
+		close(s.listener);
+		return 0;
+	}
+	fcntl(s.listener,F_SETFL,fcntl(s.listener,F_GETFL)|O_NONBLOCK);
+	s.path=path;
+	s.levelhash=levelhash;
+	s.clients.clear();
+	for(int k=0;k<SPECTATE_HISTORY;k++)
+		clearFrame(s.frames[k]);
+	clearBits(s.writer);
+	s.lasttick=SPECTATE_NONE;
+	memset(&s.stats,0,sizeof s.stats);
+	s.active=1;
+	return 1;
+}
+
+static void dropSpectator (Spectators &s, size_t k)
+{
+	Spectator &c = s.clients[k];
+	close(c.sock);
+	s.stats.bytes+=c.bytes;
+	s.stats.frames+=c.frames;
+	s.stats.full+=c.full;
+	s.stats.skipped+=c.skipped;
+	s.stats.seconds+=inputClock()-c.joined;
+	s.stats.spectators++;
+	s.clients.erase(s.clients.begin()+k);
+}
+
+static void acceptSpectators (Spectators &s)
+{
+	int sock;
+	while((sock=accept(s.listener,NULL,NULL))>=0){
+		fcntl(sock,F_SETFL,fcntl(sock,F_GETFL)|O_NONBLOCK);
+		Spectator c;
+		c.sock=sock;
+		c.acked=SPECTATE_NONE;
+		c.bytes=c.frames=c.full=c.skipped=0;
+		c.joined=inputClock();
+		uint8_t hello[9];
+		hello[0]=SPECTATE_HELLO;
+		uint32_t magic = SPECTATE_MAGIC;
+		memcpy(hello+1,&magic,4);
+		memcpy(hello+5,&s.levelhash,4);
+		appendMessage(c.pending,hello,sizeof hello,NULL);
+		s.clients.push_back(c);
+	}
+}
+
+/* Acks are the ticks of decoded frames, in order */
+static int readAcks (Spectator &c)
+{
+	if(!receiveBytes(c.sock,c.in))
+		return 0;
+	std::vector<char> message;
+	while(nextMessage(c.in,message)){
+		uint32_t tick;
+		if(message.size()!=4)
+			continue;
+		memcpy(&tick,&message[0],4);
+		if(c.acked==SPECTATE_NONE || (int32_t)(tick-c.acked)>0)
+			c.acked=tick;
+	}
+	return 1;
+}
+
+void broadcastSpectators (Spectators &s, Game &game)
+{
+	if(!s.active || (uint32_t)game.ticks==s.lasttick)
+		return;
+	s.lasttick=game.ticks;
+	acceptSpectators(s);
+	for(size_t k=0;k<s.clients.size();){
+		if(readAcks(s.clients[k]))
+			k++;
+		else
+			dropSpectator(s,k);
+	}
+	if(s.clients.empty())
+		return;
+
+	SpectatorFrame &frame = s.frames[game.ticks&(SPECTATE_HISTORY-1)];
+	captureFrame(frame,game,s.slots);
+	for(size_t k=0;k<s.clients.size();){
+		Spectator &c = s.clients[k];
+		if(c.pending.size()>SPECTATE_MAX_PENDING)
+			c.skipped++;
+		else{
+			const SpectatorFrame *base = &emptySpectatorFrame();
+			if(c.acked!=SPECTATE_NONE && frame.tick-c.acked<SPECTATE_HISTORY
+				&& s.frames[c.acked&(SPECTATE_HISTORY-1)].tick==c.acked)
+				base=&s.frames[c.acked&(SPECTATE_HISTORY-1)];
+			clearBits(s.writer);
+			encodeFrame(s.writer,frame,*base);
+			flushBits(s.writer);
+			uint8_t head[9];
+			head[0]=SPECTATE_FRAME;
+			memcpy(head+1,&frame.tick,4);
+			memcpy(head+5,&base->tick,4);
+			size_t before = c.pending.size();
+			appendMessage(c.pending,head,sizeof head,&s.writer.bytes);
+			c.bytes+=c.pending.size()-before;
+			c.frames++;
+			if(base->tick==SPECTATE_NONE)
+				c.full++;
+		}
+		if(flushPending(c.sock,c.pending))
+			k++;
+		else
+			dropSpectator(s,k);
+	}
+}
+
+void closeSpectators (Spectators &s)
+{
+	if(!s.active)
+		return;
+	while(!s.clients.empty())
+		dropSpectator(s,s.clients.size()-1);
+	close(s.listener);
+	unlink(s.path.c_str());
+	s.active=0;
+}
+
+void reportSpectators (const Spectators &s)
+{
+	if(!s.active)
+		return;
+	SpectateStats total = s.stats;
+	for(size_t k=0;k<s.clients.size();k++){
+		const Spectator &c = s.clients[k];
+		total.bytes+=c.bytes;
+		total.frames+=c.frames;
+		total.full+=c.full;
+		total.skipped+=c.skipped;
+		total.seconds+=inputClock()-c.joined;
+		total.spectators++;
+	}
+	printf("spectators : %d served, %ld frames (%ld full, %ld skipped), %.1f kB/s per spectator, %.0f bytes per frame\n",
+		total.spectators,total.frames,total.full,total.skipped,
+		total.seconds>0 ? total.bytes/total.seconds/1000 : 0,total.frames ? (double)total.bytes/total.frames : 0);
+}
+
+int connectSpectator (SpectatorClient &client, const char *path)
+{
+	client.active=0;
+	sockaddr_un address;
+	if(!unixAddress(address,path))
+		return 0;
+	client.sock=socket(AF_UNIX,SOCK_STREAM,0);
+	if(client.sock<0 || connect(client.sock,(sockaddr*)&address,sizeof address)<0){
+		fprintf(stderr,"Spectate : no game at %s\n",path);
+		if(client.sock>=0)
+			close(client.sock);
+		return 0;
+	}
+	fcntl(client.sock,F_SETFL,fcntl(client.sock,F_GETFL)|O_NONBLOCK);
+	initSpectatorView(client);
+	client.active=1;
+	return 1;
+}
+
+void initSpectatorView (SpectatorClient &client)
+{
+	client.levelhash=0;
+	client.latest=SPECTATE_NONE;
+	client.in.clear();
+	for(int k=0;k<SPECTATE_HISTORY;k++)
+		clearFrame(client.frames[k]);
+	client.targets.clear();
+	client.mirrored=0;
+	client.shownstage=-1;
+	client.shown.clear();
+	client.bytes=client.decoded=client.dropped=0;
+	client.joined=inputClock();
+}
+
+int storeSpectatorFrame (SpectatorClient &client, uint32_t tick, uint32_t basetick, const uint8_t *bits, size_t size)
+{
+	const SpectatorFrame *base = &emptySpectatorFrame();
+	if(basetick!=SPECTATE_NONE){
+		base=&client.frames[basetick&(SPECTATE_HISTORY-1)];
+		if(base->tick!=basetick)
+			return 0;
+	}
+	/* a late datagram must not overwrite a newer frame */
+	if(client.latest!=SPECTATE_NONE && (int32_t)(tick-client.latest)<=0)
+		return 0;
+	SpectatorFrame &frame = client.frames[tick&(SPECTATE_HISTORY-1)];
+	BitReader r;
+	startBits(r,bits,size);
+	frame.tick=tick;
+	if(!decodeFrame(r,frame,*base)){
+		frame.tick=SPECTATE_NONE;
+		return 0;
+	}
+	client.latest=tick;
+	return 1;
+}
+
+static int readFrame (SpectatorClient &client, const std::vector<char> &message)
+{
+	if(message.size()<9)
+		return 0;
+	uint32_t tick, basetick;
+	memcpy(&tick,&message[1],4);
+	memcpy(&basetick,&message[5],4);
+	if(!storeSpectatorFrame(client,tick,basetick,(const uint8_t*)&message[9],message.size()-9))
+		return 0;
+	std::vector<char> ack;
+	appendMessage(ack,&tick,4,NULL);
+	send(client.sock,&ack[0],ack.size(),MSG_NOSIGNAL);
+	return 1;
+}
+
+int pollSpectator (SpectatorClient &client)
+{
+	if(!client.active)
+		return -1;
+	int open = receiveBytes(client.sock,client.in);
+	int decoded = 0;
+	std::vector<char> message;
+	while(nextMessage(client.in,message)){
+		client.bytes+=4+message.size();
+		if(message.empty())
+			continue;
+		if(message[0]==SPECTATE_HELLO && message.size()==9){
+			uint32_t magic;
+			memcpy(&magic,&message[1],4);
+			memcpy(&client.levelhash,&message[5],4);
+			if(magic!=SPECTATE_MAGIC){
+				fprintf(stderr,"Spectate : not a game on the other end\n");
+				return -1;
+			}
+		}
+		else if(message[0]==SPECTATE_FRAME){
+			if(readFrame(client,message)){
+				decoded++;
+				client.decoded++;
+			}
+			else
+				client.dropped++;
+		}
+	}
+	return open ? decoded : -1;
+}
+
+/* The game's own targets would fly by its own rules, put them away and
+   show the broadcast ones instead */
+static void putAwayTargets (Game &game)
+{
+	World &world = game.world;
+	std::vector<Entity> live;
+	for(size_t a=0;a<world.archetypes.size();a++){
+		const Archetype &arch = world.archetypes[a];
+		if(archetypeMatches(arch,SPECTATE_TARGET_MASK))
+			live.insert(live.end(),arch.entities.begin(),arch.entities.end());
+	}
+	for(size_t k=0;k<live.size();k++)
+		despawnTarget(world,game.spawner,live[k]);
+	flushWorld(world);
+}
+
+static void placeTarget (Game &game, Entity e, const SpectatorTarget &t)
+{
+	Transform *tr = getTransform(game.world,e);
+	float flight = (float)t.t/SPECTATE_T_SCALE;
+	tr->x=(float)t.x/SPECTATE_POS_SCALE;
+	tr->y=-4+5*flight + (-1)*flight*flight;
+	tr->rotation=0;
+}
+
+void mirrorSpectator (SpectatorClient &client, Game &game)
+{
+	if(client.latest==SPECTATE_NONE)
+		return;
+	World &world = game.world;
+	const SpectatorFrame &f = client.frames[client.latest&(SPECTATE_HISTORY-1)];
+	if(!client.mirrored){
+		putAwayTargets(game);
+		client.mirrored=1;
+	}
+	game.ticks=f.tick;
+	game.camerax=(float)f.camerax/SPECTATE_POS_SCALE;
+	game.stage=f.stage;
+	game.sitechange=f.sitechange;
+	game.countdown=f.countdown;
+	/* the obstacles of the next stage come up once the scroll is done */
+	int obstaclestage = f.sitechange && f.stage>0 ? f.stage-1 : f.stage;
+	if(obstaclestage!=client.shownstage){
+		activateObstacles(game,obstaclestage);
+		client.shownstage=obstaclestage;
+	}
+	for(int c=0;c<2;c++){
+		Cannon &can = game.cannons[c];
+		const SpectatorCannon &sc = f.cannons[c];
+		can.score=f.scores[c];
+		Transform *rect = getTransform(world,can.rect);
+		rect->y=(float)sc.y/SPECTATE_POS_SCALE;
+		rect->rotation=(float)sc.rotation/SPECTATE_ROT_SCALE;
+		getTransform(world,can.base)->y=rect->y;
+		Transform *bullet = getTransform(world,can.bullet);
+		bullet->x=(float)sc.bulletx/SPECTATE_POS_SCALE;
+		bullet->y=(float)sc.bullety/SPECTATE_POS_SCALE;
+	}
+
+	/* walk last time's ids and this frame's together */
+	std::vector<uint32_t> ids;
+	ids.reserve(f.targets.size());
+	size_t j = 0;
+	for(size_t i=0;i<f.targets.size();i++){
+		const SpectatorTarget &t = f.targets[i];
+		for(;j<client.shown.size() && client.shown[j]<t.id;j++){
+			destroyEntity(world,client.targets[client.shown[j]]);
+			client.targets[client.shown[j]]=NULL_ENTITY;
+		}
+		if(j<client.shown.size() && client.shown[j]==t.id)
+			j++;
+		if(t.id>=client.targets.size())
+			client.targets.resize(t.id+1,NULL_ENTITY);
+		Entity &e = client.targets[t.id];
+		if(e==NULL_ENTITY){
+			e=createEntity(world,COMP_TRANSFORM|COMP_MESH|TAG_TARGET|TAG_ACTIVE);
+			const TargetClass &c = game.spawner.classes[t.kind<game.spawner.classes.size() ? t.kind : 0];
+			RenderMesh *m = getMesh(world,e);
+			m->vao=c.vao;
+			m->layer=c.layer;
+			m->visible=1;
+		}
+		placeTarget(game,e,t);
+		ids.push_back(t.id);
+	}
+	for(;j<client.shown.size();j++){
+		destroyEntity(world,client.targets[client.shown[j]]);
+		client.targets[client.shown[j]]=NULL_ENTITY;
+	}
+	client.shown.swap(ids);
+}
+
+void closeSpectator (SpectatorClient &client)
+{
+	if(client.active)
+		close(client.sock);
+	client.active=0;
+}
+
+void reportSpectator (const SpectatorClient &client)
+{
+	if(!client.joined)
+		return;
+	double seconds = inputClock()-client.joined;
+	printf("spectate : %ld frames decoded, %ld dropped, %.1f kB/s\n",client.decoded,client.dropped,
+		seconds>0 ? client.bytes/seconds/1000 : 0);
+}
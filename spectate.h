@@ -0,0 +1,136 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "bits.h"
+
+/* Spectator broadcast over a local Unix socket.
+   After every tick the game quantizes what a viewer needs, the camera,
+   stage, countdown, scores, both cannons and their bullets and every live
+   target, into a SpectatorFrame. Each spectator is sent that frame as a
+   bit packed delta against the last frame it acknowledged, or against an
+   empty one when that frame has left the history. Targets are coded by
+   entity index and only when they differ from where the baseline says
+   they should be: a target rises on y=-4+5t-t^2 with t stepping once a
+   tick, so one that flew on untouched costs nothing and the bandwidth
+   follows the hits and spawns, not the target count.
+
+   Messages both ways are a 4 byte length and the payload. The server
+   opens with a hello carrying the level hash, then sends frames; a
+   spectator answers each frame it decoded with its tick. */
+
+#define SPECTATE_MAGIC 0x31455053u	/* "SPE1" */
+#define SPECTATE_HISTORY 64	/* frames kept for baselines, power of two */
+#define SPECTATE_MAX_PENDING (1<<20)	/* bytes queued to a slow spectator before frames are skipped */
+#define SPECTATE_NONE 0xffffffffu	/* no baseline, or no frame yet */
+#define SPECTATE_MAX_TARGETS (1<<20)	/* target ids are below, frames with others are refused */
+
+/* Fixed point steps of the quantized fields */
+#define SPECTATE_POS_SCALE 256		/* 1/256 world unit */
+#define SPECTATE_ROT_SCALE 16		/* 1/16 degree */
+#define SPECTATE_T_SCALE 20		/* one target step, .05 */
+
+enum {
+	SPECTATE_HELLO,
+	SPECTATE_FRAME
+};
+
+struct SpectatorTarget{
+	uint32_t id;		/* entity index */
+	uint8_t kind;		/* spawner target class */
+	int32_t x;
+	int32_t t;
+};
+
+struct SpectatorCannon{
+	int32_t y, rotation;
+	int32_t bulletx, bullety;
+};
+
+struct SpectatorFrame{
+	uint32_t tick;		/* SPECTATE_NONE for the empty baseline */
+	int32_t camerax;
+	int32_t stage, sitechange, countdown;
+	int32_t scores[2];
+	SpectatorCannon cannons[2];
+	std::vector<SpectatorTarget> targets;	/* sorted by id */
+};
+
+struct Spectator{
+	int sock;
+	uint32_t acked;
+	std::vector<char> pending;	/* bytes the socket did not take yet */
+	std::vector<char> in;
+	long bytes, frames, full, skipped;
+	double joined;
+};
+
+struct SpectateStats{
+	long bytes, frames, full, skipped;
+	double seconds;		/* summed over spectators */
+	int spectators;
+};
+
+struct Spectators{
+	int active;
+	int listener;
+	std::string path;
+	uint32_t levelhash;
+	std::vector<Spectator> clients;
+	SpectatorFrame frames[SPECTATE_HISTORY];
+	std::vector<int> slots;		/* scratch, target row by entity index */
+	BitWriter writer;
+	uint32_t lasttick;	/* tick of the last broadcast */
+	SpectateStats stats;
+};
+
+struct SpectatorClient{
+	int active;
+	int sock;
+	uint32_t levelhash;
+	uint32_t latest;	/* tick of the newest decoded frame */
+	std::vector<char> in;
+	SpectatorFrame frames[SPECTATE_HISTORY];
+	std::vector<Entity> targets;	/* mirror entity by server entity index */
+	int mirrored;		/* the game's own targets are put away */
+	int shownstage;	/* stage whose obstacles are active */
+	std::vector<uint32_t> shown;	/* ids mirrored last time */
+	long bytes, decoded, dropped;
+	double joined;
+};
+
+/* Game side. Returns 0 and prints why when the socket cannot be made */
+int openSpectators (Spectators &s, const char *path, uint32_t levelhash);
+/* Accepts newcomers, then sends this tick's frame to everyone */
+void broadcastSpectators (Spectators &s, Game &game);
+void closeSpectators (Spectators &s);
+void reportSpectators (const Spectators &s);
+
+void captureFrame (SpectatorFrame &frame, Game &game, std::vector<int> &slots);
+/* The baseline of a viewer that has nothing yet */
+const SpectatorFrame &emptySpectatorFrame ();
+/* Appends the delta of frame against base */
+void encodeFrame (BitWriter &w, const SpectatorFrame &frame, const SpectatorFrame &base);
+/* Returns 0 on a malformed frame */
+int decodeFrame (BitReader &r, SpectatorFrame &frame, const SpectatorFrame &base);
+
+/* Spectator side */
+int connectSpectator (SpectatorClient &client, const char *path);
+/* Reads and decodes everything that arrived. Returns the frames decoded,
+   -1 once the game has closed the socket */
+int pollSpectator (SpectatorClient &client);
+/* Shows the newest frame in game, a Game made by initGame on the same level */
+void mirrorSpectator (SpectatorClient &client, Game &game);
+void closeSpectator (SpectatorClient &client);
+/* For other transports of the same frames: an empty view, and decoding
+   one frame against the view's copy of basetick. Returns 0 if the frame
+   is malformed, older than the newest or its baseline is gone */
+void initSpectatorView (SpectatorClient &client);
+int storeSpectatorFrame (SpectatorClient &client, uint32_t tick, uint32_t basetick, const uint8_t *bits, size_t size);
+void reportSpectator (const SpectatorClient &client);
+
+#endif
@@ -0,0 +1,136 @@
+#include <cstdio>
+#include <cstring>
+
+#include "stream.h"
+#include "profile.h"
+#include "trace.h"
+
+int meshStage (const Level &level, int mesh)
+{
+	int k = mesh-MESH_PROPS;
+	if(k<0 || k>=(int)level.header->nprops)
+		return 0;
+	int stage = level.props[k].stage;
+	return stage>0 && stage<(int)level.header->nstages ? stage : 0;
+}
+
+/* The lowest queued stage, -1 if none. Called under the lock */
+static int queuedStage (AssetStream &s)
+{
+	for(uint32_t k=0;k<s.level->header->nstages;k++){
+		if(s.stages[k].state.load()==STREAM_QUEUED)
+			return (int)k;
+	}
+	return -1;
+}
+
+/* Reading the vertices out of the map is what pages them in */
+void copyStage (const AssetStream &s, int stage, MeshVertex *dest)
+{
+	TraceScope trace("copyStage");
+	const MeshBlob &blob = *s.blob;
+	uint32_t at = 0;
+	for(uint32_t m=0;m<blob.header->nmeshes;m++){
+		if(meshStage(*s.level,m)!=stage)
+			continue;
+		const MeshRange &r = blob.meshes[m];
+		memcpy(dest+at,blob.vertices+r.first,r.count*sizeof(MeshVertex));
+		at+=r.count;
+	}
+}
+
+static void runLoader (AssetStream *stream)
+{
+	AssetStream &s = *stream;
+	traceThreadName("assets");
+	std::unique_lock<std::mutex> guard(s.lock);
+	while(!s.stop){
+		int stage = queuedStage(s);
+		if(stage<0){
+			s.wake.wait(guard);
+			continue;
+		}
+		guard.unlock();
+		copyStage(s,stage,s.stages[stage].dest);
+		guard.lock();
+		s.stages[stage].loaded=profileClock();
+		s.stages[stage].state.store(STREAM_LOADED);
+		s.wake.notify_all();
+	}
+}
+
+void startAssetStream (AssetStream &s, const Level &level, const MeshBlob &blob)
+{
+	s.level=&level;
+	s.blob=&blob;
+	s.stop=0;
+	s.startupvertices=0;
+	for(int k=0;k<MAX_LEVEL_STAGES;k++){
+		StreamStage &st = s.stages[k];
+		st.state.store(STREAM_WAITING);
+		st.nvertices=0;
+		st.dest=NULL;
+		st.buffer=st.vertexarray=0;
+		st.queued=st.loaded=0;
+		st.waited=0;
+	}
+	for(uint32_t m=0;m<blob.header->nmeshes;m++)
+		s.stages[meshStage(level,m)].nvertices+=blob.meshes[m].count;
+	s.stages[0].state.store(STREAM_RESIDENT);
+	s.startupvertices=s.stages[0].nvertices;
+	s.thread=std::thread(runLoader,&s);
+	s.active=1;
+}
+
+void queueStage (AssetStream &s, int stage, MeshVertex *dest)
+{
+	std::lock_guard<std::mutex> guard(s.lock);
+	StreamStage &st = s.stages[stage];
+	st.dest=dest;
+	st.queued=profileClock();
+	st.state.store(STREAM_QUEUED);
+	s.wake.notify_all();
+}
+
+int stageLoaded (AssetStream &s, int stage, int wait)
+{
+	StreamStage &st = s.stages[stage];
+	if(st.state.load()>=STREAM_LOADED)
+		return 1;
+	if(!wait || st.state.load()==STREAM_WAITING)
+		return 0;
+	TraceScope trace("waitStage");
+	std::unique_lock<std::mutex> guard(s.lock);
+	while(st.state.load()<STREAM_LOADED)
+		s.wake.wait(guard);
+	st.waited=1;
+	return 1;
+}
+
+void stopAssetStream (AssetStream &s)
+{
+	if(!s.active)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(s.lock);
+		s.stop=1;
+		s.wake.notify_all();
+	}
+	s.thread.join();
+	s.active=0;
+}
+
+void reportAssetStream (const AssetStream &s)
+{
+	if(!s.startupvertices)
+		return;
+	printf("assets : %llu vertices at startup",(unsigned long long)s.startupvertices);
+	for(uint32_t k=1;k<s.level->header->nstages;k++){
+		const StreamStage &st = s.stages[k];
+		if(st.state.load()==STREAM_WAITING)
+			continue;
+		printf(", stage %u %u streamed in %.2f ms%s",k+1,st.nvertices,
+			st.loaded>st.queued ? (st.loaded-st.queued)/1e6 : 0.0,st.waited ? " (waited for)" : "");
+	}
+	printf("\n");
+}
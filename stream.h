@@ -0,0 +1,67 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "level.h"
+#include "mesh.h"
+
+/* Background loading of the later stages' meshes.
+   At startup the game uploads only what stage 0 draws: the cannons, the
+   HUD segments, the target palette and the props of the first stage. The
+   props of each later stage belong to that stage; while the stage before
+   it plays, the render thread maps a buffer for them and a loader thread
+   copies their vertices into it from the mapped assets.bin, which is when
+   the pages are read from disk. The render thread then only unmaps the
+   buffer and points the meshes at it. A stage needed before its loader
+   finished is waited for, the only way a transition can still hitch. The
+   loader never calls GL. */
+
+enum {
+	STREAM_WAITING,		/* not asked for yet */
+	STREAM_QUEUED,		/* buffer mapped, the loader has it */
+	STREAM_LOADED,		/* vertices in the buffer, not unmapped yet */
+	STREAM_RESIDENT		/* drawable */
+};
+
+struct StreamStage{
+	std::atomic<int> state;
+	uint32_t nvertices;	/* of its props */
+	MeshVertex *dest;	/* the mapped buffer while queued */
+	unsigned int buffer, vertexarray;	/* the render thread's GL names */
+	uint64_t queued, loaded;	/* profileClock */
+	int waited;		/* the render thread needed it first */
+};
+
+struct AssetStream{
+	int active;
+	const Level *level;
+	const MeshBlob *blob;
+	StreamStage stages[MAX_LEVEL_STAGES];
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;	/* the loader on a queued stage, the render thread on a loaded one */
+	int stop;
+	uint64_t startupvertices;
+};
+
+/* Which stage's buffer holds a mesh of the MESH_* order, 0 for all but props */
+int meshStage (const Level &level, int mesh);
+
+/* Marks stage 0 resident and starts the loader. blob stays mapped until
+   stopAssetStream */
+void startAssetStream (AssetStream &s, const Level &level, const MeshBlob &blob);
+/* What the loader does, for a render thread that could not map a buffer */
+void copyStage (const AssetStream &s, int stage, MeshVertex *dest);
+/* Hands the loader a stage and the mapped buffer of nvertices to fill */
+void queueStage (AssetStream &s, int stage, MeshVertex *dest);
+/* 1 once the loader filled the stage, waits for it if wait is set */
+int stageLoaded (AssetStream &s, int stage, int wait);
+void stopAssetStream (AssetStream &s);
+void reportAssetStream (const AssetStream &s);
+
+#endif
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstring>
+
+#include "stress.h"
+#include "rng.h"
+
+int stressKinds (const char *letters)
+{
+	int kinds = 0;
+	if(strchr(letters,'t'))
+		kinds|=STRESS_TARGETS;
+	if(strchr(letters,'p'))
+		kinds|=STRESS_PROJECTILES;
+	if(strchr(letters,'o'))
+		kinds|=STRESS_OBSTACLES;
+	return kinds;
+}
+
+static Entity createStressProp (World &world, unsigned int mask, VAO *vao, int layer, float x, float y)
+{
+	Entity e = createEntity(world,COMP_TRANSFORM|COMP_MESH|COMP_COLLIDER|mask);
+	Transform *t = getTransform(world,e);
+	t->x=x;
+	t->y=y;
+	t->rotation=0;
+	RenderMesh *m = getMesh(world,e);
+	m->vao=vao;
+	m->layer=layer;
+	m->visible=1;
+	return e;
+}
+
+void populateStress (Game &game, const GameAssets &assets, int count, int kinds, uint64_t seed)
+{
+	World &world = game.world;
+	Rng rng = rngStream(seed,RNG_STREAM_STRESS);
+	float left = game.camerax-10;
+
+	if(kinds&STRESS_TARGETS){
+		/* the spawner keeps count of them up across the whole field */
+		SpawnRule &rule = game.spawner.rules[game.spawner.level];
+		rule.initial=count;
+		rule.maxactive=count;
+		rule.distribution=SPAWN_UNIFORM;
+		rule.a=left+1;
+		rule.b=left+19;
+		reserveTargets(world,game.spawner,count);
+		requestSpawn(game.spawner,count-game.spawner.active);
+		flushSpawner(world,game.spawner);
+		flushWorld(world);
+	}
+	if(kinds&STRESS_PROJECTILES){
+		for(int k=0;k<count;k++){
+			Entity e = createStressProp(world,TAG_PROJECTILE|COMP_VELOCITY,assets.bullet[k&1],LAYER_BULLET,
+				left+20*rngFloat(rng),-3.5f+6*rngFloat(rng));
+			getCollider(world,e)->radius=.2;
+			Velocity *v = getVelocity(world,e);
+			v->vx=-3+6*rngFloat(rng);
+			v->vy=4*rngFloat(rng);
+			v->t=.5f*rngFloat(rng);
+		}
+	}
+	if(kinds&STRESS_OBSTACLES){
+		for(int k=0;k<count;k++){
+			Entity e = createStressProp(world,TAG_OBSTACLE|TAG_ACTIVE,assets.segmentvertical,LAYER_OBSTACLE,
+				left+20*rngFloat(rng),-3.5f+2.5f*rngFloat(rng));
+			Collider *col = getCollider(world,e);
+			col->radius=0;
+			col->halfw=.025;
+			col->halfh=.1;
+		}
+	}
+}
+
+static double perFrame (const Histogram &h, int frames)
+{
+	return frames ? h.sum/1e6/frames : 0;
+}
+
+void measureStress (StressStep &step, const Game &game, const Profiler &profiler, int frames, long drawcalls)
+{
+	step.entities=0;
+	for(size_t a=0;a<game.world.archetypes.size();a++)
+		step.entities+=game.world.archetypes[a].entities.size();
+	step.frames=frames;
+	const Histogram &frame = profiler.phases[PHASE_FRAME];
+	step.framep50=histogramQuantile(frame,.5)/1e6;
+	step.framep99=histogramQuantile(frame,.99)/1e6;
+	step.framemax=frame.max/1e6;
+	step.drawcalls=frames ? (double)drawcalls/frames : 0;
+	step.collision=perFrame(profiler.phases[PHASE_COLLISION],frames);
+	step.targets=perFrame(profiler.phases[PHASE_TARGETS],frames);
+	step.projectiles=perFrame(profiler.phases[PHASE_PROJECTILES],frames);
+}
+
+void printStressHeader ()
+{
+	printf("count,entities,frames,frame_p50_ms,frame_p99_ms,frame_max_ms,draw_calls,collision_ms,targets_ms,projectiles_ms\n");
+}
+
+void printStressStep (const StressStep &step)
+{
+	printf("%d,%d,%d,%.3f,%.3f,%.3f,%.0f,%.3f,%.3f,%.3f\n",step.count,step.entities,step.frames,
+		step.framep50,step.framep99,step.framemax,step.drawcalls,step.collision,step.targets,step.projectiles);
+	fflush(stdout);
+}
@@ -0,0 +1,45 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "sim.h"
+
+/* Stress scenarios.
+   Fills the field of the current stage with count targets, projectiles
+   and obstacles on top of the match. Targets are the spawner's, so they
+   fly, collide and respawn as usual; projectiles have no cannon and
+   bounce around the field forever; obstacles are small pegs the cannon
+   bullets bounce off. The game steps every one of them with its own
+   systems. */
+
+#define STRESS_FRAMES 120	/* frames per step of a sweep */
+#define STRESS_SECONDS 10	/* a step ends early after this long, at STRESS_MIN_FRAMES */
+#define STRESS_MIN_FRAMES 5
+
+enum {
+	STRESS_TARGETS = 1<<0,
+	STRESS_PROJECTILES = 1<<1,
+	STRESS_OBSTACLES = 1<<2
+};
+
+/* kinds is an OR of STRESS_*, parsed from letters t, p, o */
+int stressKinds (const char *letters);
+void populateStress (Game &game, const GameAssets &assets, int count, int kinds, uint64_t seed);
+
+/* One row of the sweep, times in milliseconds */
+struct StressStep{
+	int count;
+	int entities;
+	int frames;
+	double framep50, framep99, framemax;
+	double drawcalls;	/* per frame */
+	double collision;	/* per frame, target and obstacle tests */
+	double targets;		/* per frame, target motion and respawns */
+	double projectiles;	/* per frame */
+};
+
+/* Fills the row from the profiler of the step's frames */
+void measureStress (StressStep &step, const Game &game, const Profiler &profiler, int frames, long drawcalls);
+void printStressHeader ();
+void printStressStep (const StressStep &step);
+
+#endif
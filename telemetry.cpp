@@ -0,0 +1,158 @@
+#include <cstring>
+#include <chrono>
+
+#include "telemetry.h"
+#include "trace.h"
+
+/* Appends one column of the rows, field by field */
+#define PUT_COLUMN(field) \
+	for(size_t k=0;k<t.rows.size();k++){ \
+		const uint8_t *p = (const uint8_t*)&t.rows[k].field; \
+		t.columns.insert(t.columns.end(),p,p+sizeof t.rows[k].field); \
+	}
+
+#define TAKE_COLUMN(field) \
+	for(size_t k=from;k<rows.size() && ok;k++){ \
+		ok = fread(&rows[k].field,sizeof rows[k].field,1,in)==1; \
+	}
+
+static void writeBlock (Telemetry &t)
+{
+	if(t.rows.empty())
+		return;
+	t.columns.clear();
+	TelemetryBlockHeader h;
+	h.magic=TELEMETRY_BLOCK_MAGIC;
+	h.rows=t.rows.size();
+	const uint8_t *p = (const uint8_t*)&h;
+	t.columns.insert(t.columns.end(),p,p+sizeof h);
+	PUT_COLUMN(tick)
+	PUT_COLUMN(type)
+	PUT_COLUMN(cannon)
+	PUT_COLUMN(stage)
+	PUT_COLUMN(kind)
+	PUT_COLUMN(bounces)
+	PUT_COLUMN(hits)
+	PUT_COLUMN(angle)
+	PUT_COLUMN(charge)
+	PUT_COLUMN(flight)
+	PUT_COLUMN(points)
+	if(fwrite(&t.columns[0],1,t.columns.size(),t.out)!=t.columns.size() || fflush(t.out)!=0)
+		t.failed=1;
+	t.written+=t.rows.size();
+	t.blocks++;
+	t.bytes+=t.columns.size();
+	t.rows.clear();
+}
+
+/* Moves everything in the ring to the block being built */
+static void drain (Telemetry &t)
+{
+	uint32_t tail = t.tail.load(std::memory_order_relaxed);
+	uint32_t head = t.head.load(std::memory_order_acquire);
+	for(;tail!=head;tail++){
+		t.rows.push_back(t.ring[tail&(TELEMETRY_RING-1)]);
+		if(t.rows.size()==TELEMETRY_BLOCK){
+			/* free the slots before the disk write */
+			t.tail.store(tail+1,std::memory_order_release);
+			writeBlock(t);
+		}
+	}
+	t.tail.store(tail,std::memory_order_release);
+}
+
+static void runWriter (Telemetry *telemetry)
+{
+	Telemetry &t = *telemetry;
+	traceThreadName("telemetry");
+	while(!t.stop.load(std::memory_order_acquire)){
+		drain(t);
+		std::this_thread::sleep_for(std::chrono::milliseconds(TELEMETRY_FLUSH_MS));
+	}
+	drain(t);
+	writeBlock(t);
+}
+
+int startTelemetry (Telemetry &t, const char *path, uint32_t levelhash, uint64_t seed)
+{
+	t.active=0;
+	t.out=fopen(path,"wb");
+	if(!t.out){
+		fprintf(stderr,"Telemetry : cannot write %s\n",path);
+		return 0;
+	}
+	TelemetryFileHeader h;
+	memset(&h,0,sizeof h);
+	h.magic=TELEMETRY_MAGIC;
+	h.version=TELEMETRY_VERSION;
+	h.levelhash=levelhash;
+	h.seed=seed;
+	fwrite(&h,sizeof h,1,t.out);
+	t.head.store(0);
+	t.tail.store(0);
+	t.stop.store(0);
+	t.dropped=0;
+	t.rows.clear();
+	t.rows.reserve(TELEMETRY_BLOCK);
+	t.written=t.blocks=0;
+	t.bytes=sizeof h;
+	t.failed=0;
+	t.thread=std::thread(runWriter,&t);
+	t.active=1;
+	return 1;
+}
+
+void stopTelemetry (Telemetry &t)
+{
+	if(!t.active)
+		return;
+	t.stop.store(1,std::memory_order_release);
+	t.thread.join();
+	if(fclose(t.out)!=0)
+		t.failed=1;
+	t.active=0;
+}
+
+void reportTelemetry (const Telemetry &t)
+{
+	if(!t.blocks && !t.dropped)
+		return;
+	printf("telemetry : %ld events in %ld blocks, %.1f bytes per event, %u dropped%s\n",t.written,t.blocks,
+		t.written ? (double)t.bytes/t.written : 0,t.dropped,t.failed ? ", the file is incomplete" : "");
+}
+
+int readTelemetry (const char *path, TelemetryFileHeader &header, std::vector<TelemetryEvent> &rows)
+{
+	rows.clear();
+	FILE *in = fopen(path,"rb");
+	if(!in)
+		return 0;
+	if(fread(&header,sizeof header,1,in)!=1 || header.magic!=TELEMETRY_MAGIC || header.version!=TELEMETRY_VERSION){
+		fclose(in);
+		return 0;
+	}
+	TelemetryBlockHeader h;
+	/* a writer never flushes more than a block's worth, more is damage */
+	while(fread(&h,sizeof h,1,in)==1 && h.magic==TELEMETRY_BLOCK_MAGIC && h.rows<=TELEMETRY_BLOCK){
+		size_t from = rows.size();
+		rows.resize(from+h.rows);
+		int ok = 1;
+		TAKE_COLUMN(tick)
+		TAKE_COLUMN(type)
+		TAKE_COLUMN(cannon)
+		TAKE_COLUMN(stage)
+		TAKE_COLUMN(kind)
+		TAKE_COLUMN(bounces)
+		TAKE_COLUMN(hits)
+		TAKE_COLUMN(angle)
+		TAKE_COLUMN(charge)
+		TAKE_COLUMN(flight)
+		TAKE_COLUMN(points)
+		if(!ok){
+			rows.resize(from);
+			break;
+		}
+	}
+	fclose(in);
+	return 1;
+}
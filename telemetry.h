@@ -0,0 +1,104 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/* Per shot telemetry.
+   The simulation reports every shot as it leaves the barrel, every
+   target it hits and the end of its flight, each with the launch angle
+   and charge, the ticks in flight, the bounces and hits so far and the
+   stage. recordTelemetry copies the event into a single producer single
+   consumer ring and returns; it takes no lock and makes no system call,
+   and when the ring is full the event is counted as dropped rather than
+   waited for. A writer thread drains the ring every TELEMETRY_FLUSH_MS
+   and writes blocks of TELEMETRY_BLOCK rows to the file column by
+   column, each column in the narrowest type that holds it.
+
+   File: a TelemetryFileHeader, then blocks of a TelemetryBlockHeader
+   followed by the columns in the order of TelemetryEvent, tick first. */
+
+#define TELEMETRY_MAGIC 0x314d4c54u	/* "TLM1" */
+#define TELEMETRY_BLOCK_MAGIC 0x4b4c4254u	/* "TBLK" */
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_RING 8192	/* events, power of two */
+#define TELEMETRY_BLOCK 4096	/* rows per block */
+#define TELEMETRY_FLUSH_MS 50
+
+enum {
+	TELEMETRY_SHOT,		/* left the barrel */
+	TELEMETRY_HIT,		/* hit a target, kind and points are set */
+	TELEMETRY_END		/* left the field or was pulled back */
+};
+
+#define TELEMETRY_NO_KIND 0xff
+
+struct TelemetryEvent{
+	uint32_t tick;
+	uint8_t type;
+	uint8_t cannon;
+	uint8_t stage;
+	uint8_t kind;		/* spawner target class hit */
+	uint8_t bounces;
+	uint8_t hits;
+	int16_t angle;		/* launch angle, hundredths of a degree */
+	uint16_t charge;	/* launch charge, hundredths */
+	uint16_t flight;	/* ticks since the launch */
+	int16_t points;
+};
+
+struct TelemetryFileHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t levelhash;
+	uint32_t reserved;
+	uint64_t seed;
+};
+
+struct TelemetryBlockHeader{
+	uint32_t magic;
+	uint32_t rows;
+};
+
+struct Telemetry{
+	int active;
+	TelemetryEvent ring[TELEMETRY_RING];
+	std::atomic<uint32_t> head;	/* next slot the game writes */
+	std::atomic<uint32_t> tail;	/* next slot the writer reads */
+	std::atomic<int> stop;
+	uint32_t dropped;	/* the game's, ring full */
+	/* the writer's */
+	std::thread thread;
+	FILE *out;
+	std::vector<TelemetryEvent> rows;
+	std::vector<uint8_t> columns;
+	long written, blocks, bytes;
+	int failed;
+};
+
+/* Creates the file and starts the writer. Returns 0 and prints why if
+   the file cannot be written */
+int startTelemetry (Telemetry &t, const char *path, uint32_t levelhash, uint64_t seed);
+/* Drains what is left, writes the last block and joins the writer */
+void stopTelemetry (Telemetry &t);
+void reportTelemetry (const Telemetry &t);
+
+static inline void recordTelemetry (Telemetry &t, const TelemetryEvent &e)
+{
+	uint32_t head = t.head.load(std::memory_order_relaxed);
+	if(head-t.tail.load(std::memory_order_acquire)>=TELEMETRY_RING){
+		t.dropped++;
+		return;
+	}
+	t.ring[head&(TELEMETRY_RING-1)]=e;
+	t.head.store(head+1,std::memory_order_release);
+}
+
+/* Reads a whole file back into rows. Returns 0 if it is not a telemetry
+   file; a block cut short by a crash ends the rows */
+int readTelemetry (const char *path, TelemetryFileHeader &header, std::vector<TelemetryEvent> &rows);
+
+#endif
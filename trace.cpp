@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+struct TraceRing{
+	TraceEvent events[TRACE_RING_SIZE];
+	std::atomic<unsigned int> head;	/* owned by the writer */
+	std::atomic<unsigned int> tail;	/* owned by the recording thread */
+	std::atomic<unsigned int> dropped;
+	int tid;
+	char name[32];
+	TraceRing() : head(0), tail(0), dropped(0) {}
+};
+
+std::atomic<int> tracing(0);
+
+/* Rings are never freed, a thread may still hold its own after the trace stops */
+static std::mutex ringlock;
+static std::vector<TraceRing*> rings;
+static thread_local TraceRing *ownring = NULL;
+
+static FILE *out = NULL;
+static std::thread writer;
+static std::atomic<int> writing(0);
+static uint64_t origin;
+static int written;
+
+static uint64_t traceClock ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static TraceRing *threadRing ()
+{
+	if(!ownring){
+		TraceRing *ring = new TraceRing;
+		std::lock_guard<std::mutex> guard(ringlock);
+		ring->tid=rings.size();
+		snprintf(ring->name,sizeof ring->name,"thread %d",ring->tid);
+		rings.push_back(ring);
+		ownring=ring;
+	}
+	return ownring;
+}
+
+void traceThreadName (const char *name)
+{
+	TraceRing *ring = threadRing();
+	snprintf(ring->name,sizeof ring->name,"%s",name);
+}
+
+void traceEvent (const char *name, char phase)
+{
+	TraceRing *ring = threadRing();
+	unsigned int tail = ring->tail.load(std::memory_order_relaxed);
+	if(tail-ring->head.load(std::memory_order_acquire)>=TRACE_RING_SIZE){
+		ring->dropped.store(ring->dropped.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+		return;
+	}
+	TraceEvent &event = ring->events[tail&(TRACE_RING_SIZE-1)];
+	event.name=name;
+	event.ns=traceClock();
+	event.phase=phase;
+	ring->tail.store(tail+1,std::memory_order_release);
+}
+
+static void writeRecord (const char *record)
+{
+	fprintf(out,"%s\n%s",written ? "," : "",record);
+	written++;
+}
+
+static void drainRings ()
+{
+	std::vector<TraceRing*> snapshot;
+	{
+		std::lock_guard<std::mutex> guard(ringlock);
+		snapshot=rings;
+	}
+	char record[256];
+	for(size_t k=0;k<snapshot.size();k++){
+		TraceRing *ring = snapshot[k];
+		unsigned int head = ring->head.load(std::memory_order_relaxed);
+		unsigned int tail = ring->tail.load(std::memory_order_acquire);
+		for(;head!=tail;head++){
+			const TraceEvent &event = ring->events[head&(TRACE_RING_SIZE-1)];
+			/* events from before the trace started are skipped */
+			if(event.ns>=origin){
+				snprintf(record,sizeof record,"{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+					event.name,event.phase,(event.ns-origin)/1e3,ring->tid);
+				writeRecord(record);
+			}
+		}
+		ring->head.store(head,std::memory_order_release);
+	}
+}
+
+static void writerLoop ()
+{
+	traceThreadName("trace writer");
+	while(writing.load()){
+		std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_FLUSH_MS));
+		drainRings();
+	}
+}
+
+int startTrace (const char *path)
+{
+	if(out)
+		return 1;
+	out=fopen(path,"w");
+	if(!out)
+		return 0;
+	fprintf(out,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	written=0;
+	origin=traceClock();
+	writing.store(1);
+	writer=std::thread(writerLoop);
+	tracing.store(1);
+	return 1;
+}
+
+void stopTrace ()
+{
+	if(!out)
+		return;
+	tracing.store(0);
+	writing.store(0);
+	writer.join();
+	drainRings();
+	char record[256];
+	unsigned int dropped = 0;
+	std::lock_guard<std::mutex> guard(ringlock);
+	for(size_t k=0;k<rings.size();k++){
+		snprintf(record,sizeof record,"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			rings[k]->tid,rings[k]->name);
+		writeRecord(record);
+		dropped+=rings[k]->dropped.load();
+	}
+	fprintf(out,"\n]}\n");
+	fclose(out);
+	out=NULL;
+	if(dropped)
+		fprintf(stderr,"Trace : %u events dropped, the rings filled between flushes\n",dropped);
+}
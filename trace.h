@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/* Chrome trace-event export (chrome://tracing, ui.perfetto.dev).
+   Every thread that records gets its own single producer ring; a writer
+   thread drains the rings into the JSON file every few milliseconds, so
+   recording is two relaxed loads and a store. Names must be string
+   literals, only the pointer is kept. A ring that fills up between two
+   drains drops events and counts them. */
+
+#define TRACE_RING_SIZE 8192	/* events, power of two */
+#define TRACE_FLUSH_MS 10
+
+struct TraceEvent{
+	const char *name;
+	uint64_t ns;
+	char phase;		/* 'B' or 'E' */
+};
+
+extern std::atomic<int> tracing;
+
+/* Returns 0 if the file cannot be opened */
+int startTrace (const char *path);
+/* Drains what is left and closes the file */
+void stopTrace ();
+/* Names the calling thread in the trace, copied */
+void traceThreadName (const char *name);
+void traceEvent (const char *name, char phase);
+
+static inline void traceBegin (const char *name)
+{
+	if(tracing.load(std::memory_order_relaxed))
+		traceEvent(name,'B');
+}
+
+static inline void traceEnd (const char *name)
+{
+	if(tracing.load(std::memory_order_relaxed))
+		traceEvent(name,'E');
+}
+
+struct TraceScope{
+	const char *name;
+	TraceScope (const char *n) : name(n) { traceBegin(name); }
+	~TraceScope () { traceEnd(name); }
+};
+
+#endif